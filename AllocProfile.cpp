@@ -0,0 +1,175 @@
+/**********************************
+ * FILE NAME: AllocProfile.cpp
+ *
+ * DESCRIPTION: Allocation profiler definition
+ **********************************/
+
+#include "AllocProfile.h"
+
+#include <atomic>
+
+const char *const AllocProfile::scopeNames[ALLOC_SCOPES] = { "unscoped", "mp1.gossip", "mp1.message", "kv.client",
+		"kv.message", "kv.ring", "kv.stabilization", "network" };
+
+/*
+ * ALLOC_COUNT builds the same interposer without the scopes of the Application,
+ * for Microbench, which only reads allocations().
+ */
+#if defined(ALLOC_PROFILE) || defined(ALLOC_COUNT)
+
+#ifdef ALLOC_PROFILE
+const bool AllocProfile::enabled = true;
+#else
+const bool AllocProfile::enabled = false;
+#endif
+
+/*
+ * Counters are constant initialized, so allocations made before main are counted
+ * too. The LogWriter thread allocates concurrently, hence the atomics.
+ */
+static atomic<uint64_t> scopeAllocations[ALLOC_SCOPES];
+static atomic<uint64_t> scopeBytes[ALLOC_SCOPES];
+static atomic<uint64_t> scopeOperations[ALLOC_SCOPES];
+static thread_local int currentScope = ALLOC_UNSCOPED;
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+/**
+ * FUNCTION NAME: charge
+ *
+ * DESCRIPTION: Count an allocation of size bytes against the current scope
+ */
+static inline void charge(size_t size) {
+	scopeAllocations[currentScope].fetch_add(1, memory_order_relaxed);
+	scopeBytes[currentScope].fetch_add(size, memory_order_relaxed);
+}
+
+extern "C" void *malloc(size_t size) throw() {
+	charge(size);
+	return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) throw() {
+	charge(count * size);
+	return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) throw() {
+	charge(size);
+	return __libc_realloc(ptr, size);
+}
+
+/**
+ * FUNCTION NAME: enter
+ *
+ * DESCRIPTION: Make scope the current one and count an operation of it
+ *
+ * RETURNS:
+ * the scope to go back to
+ */
+int AllocProfile::enter(int scope) {
+	scopeOperations[scope].fetch_add(1, memory_order_relaxed);
+	int previous = currentScope;
+	currentScope = scope;
+	return previous;
+}
+
+/**
+ * FUNCTION NAME: leave
+ *
+ * DESCRIPTION: Go back to the scope enter returned
+ */
+void AllocProfile::leave(int previous) {
+	currentScope = previous;
+}
+
+/**
+ * FUNCTION NAME: allocations
+ *
+ * DESCRIPTION: Allocations of every scope so far
+ */
+uint64_t AllocProfile::allocations() {
+	uint64_t total = 0;
+	for ( int i = 0; i < ALLOC_SCOPES; i++ ) {
+		total += scopeAllocations[i].load(memory_order_relaxed);
+	}
+	return total;
+}
+
+/**
+ * FUNCTION NAME: perOp
+ *
+ * DESCRIPTION: count per operation, 0 without operations
+ */
+static double perOp(uint64_t count, uint64_t operations) {
+	return operations > 0 ? (double)count / operations : 0.0;
+}
+
+/**
+ * FUNCTION NAME: writeReport
+ *
+ * DESCRIPTION: Write the allocations and bytes of each scope, in total and per
+ * 				operation, then per KV operation and per gossip round including
+ * 				the messages they cause
+ *
+ * RETURNS:
+ * SUCCESS or FAILURE
+ */
+int AllocProfile::writeReport(const char *path) {
+	uint64_t allocations[ALLOC_SCOPES], bytes[ALLOC_SCOPES], operations[ALLOC_SCOPES];
+	for ( int i = 0; i < ALLOC_SCOPES; i++ ) {
+		allocations[i] = scopeAllocations[i].load(memory_order_relaxed);
+		bytes[i] = scopeBytes[i].load(memory_order_relaxed);
+		operations[i] = scopeOperations[i].load(memory_order_relaxed);
+	}
+	FILE *fp = fopen(path, "w");
+	if ( NULL == fp ) {
+		printf("Unable to open %s\n", path);
+		return FAILURE;
+	}
+
+	fprintf(fp, "%-18s %12s %14s %16s %12s %12s\n", "scope", "operations", "allocations", "bytes", "allocs/op", "bytes/op");
+	for ( int i = 0; i < ALLOC_SCOPES; i++ ) {
+		fprintf(fp, "%-18s %12llu %14llu %16llu %12.2f %12.1f\n", scopeNames[i], (unsigned long long)operations[i],
+				(unsigned long long)allocations[i], (unsigned long long)bytes[i], perOp(allocations[i], operations[i]),
+				perOp(bytes[i], operations[i]));
+	}
+
+	// a KV operation is its client call plus the requests and replies it causes
+	uint64_t kvOps = operations[ALLOC_KV_CLIENT];
+	uint64_t kvAllocations = allocations[ALLOC_KV_CLIENT] + allocations[ALLOC_KV_MESSAGE];
+	uint64_t kvBytes = bytes[ALLOC_KV_CLIENT] + bytes[ALLOC_KV_MESSAGE];
+	// a gossip round is a node's nodeLoopOps plus the membership messages it takes in
+	uint64_t rounds = operations[ALLOC_GOSSIP];
+	uint64_t gossipAllocations = allocations[ALLOC_GOSSIP] + allocations[ALLOC_MP1_MESSAGE];
+	uint64_t gossipBytes = bytes[ALLOC_GOSSIP] + bytes[ALLOC_MP1_MESSAGE];
+	fprintf(fp, "\nper KV operation   %12.2f allocations %12.1f bytes over %llu operations\n", perOp(kvAllocations, kvOps),
+			perOp(kvBytes, kvOps), (unsigned long long)kvOps);
+	fprintf(fp, "per gossip round   %12.2f allocations %12.1f bytes over %llu rounds\n", perOp(gossipAllocations, rounds),
+			perOp(gossipBytes, rounds), (unsigned long long)rounds);
+	fprintf(fp, "\nnetwork receive loops are not included in either\n");
+	fclose(fp);
+	return SUCCESS;
+}
+
+#else
+
+const bool AllocProfile::enabled = false;
+
+int AllocProfile::enter(int scope) {
+	return ALLOC_UNSCOPED;
+}
+
+void AllocProfile::leave(int previous) {}
+
+uint64_t AllocProfile::allocations() {
+	return 0;
+}
+
+int AllocProfile::writeReport(const char *path) {
+	return FAILURE;
+}
+
+#endif
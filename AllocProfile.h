@@ -0,0 +1,78 @@
+/**********************************
+ * FILE NAME: AllocProfile.h
+ *
+ * DESCRIPTION: Header file of the allocation profiler. Build with
+ * 		make clean && make PROFFLAGS=-DALLOC_PROFILE
+ * to count every heap allocation by the subsystem scope it happens in;
+ * the Application then writes alloc.log. Without ALLOC_PROFILE the scopes
+ * compile to nothing. Microbench links a copy built with ALLOC_COUNT, which
+ * counts allocations but has no scopes.
+ **********************************/
+
+#ifndef ALLOCPROFILE_H_
+#define ALLOCPROFILE_H_
+
+#include "stdincludes.h"
+
+#include <stdint.h>
+
+/*
+ * Macros
+ */
+#define ALLOC_PROFILE_LOG "alloc.log"
+
+#define ALLOC_CONCAT2(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT2(a, b)
+#ifdef ALLOC_PROFILE
+// count one operation of scope and charge it the allocations of the rest of the enclosing block
+#define ALLOC_SCOPE(scope) AllocScope ALLOC_CONCAT(allocScope, __LINE__)(scope)
+#else
+#define ALLOC_SCOPE(scope)
+#endif
+
+// what allocations are charged to; the innermost scope wins
+enum allocSCOPE {
+	ALLOC_UNSCOPED,
+	ALLOC_GOSSIP,			// MP1Node::nodeLoopOps, one gossip round of a node
+	ALLOC_MP1_MESSAGE,		// MP1Node::recvCallBack, one membership message
+	ALLOC_KV_CLIENT,		// MP2Node::client*, one KV operation sent to its replicas
+	ALLOC_KV_MESSAGE,		// one KV request or reply handled by MP2Node::checkMessages
+	ALLOC_KV_RING,			// MP2Node::updateRing
+	ALLOC_KV_STABILIZATION,	// MP2Node::stabilizationProtocol
+	ALLOC_NETWORK,			// EmulNet::ENrecv, one receive loop of a node
+	ALLOC_SCOPES
+};
+
+/**
+ * CLASS NAME: AllocProfile
+ *
+ * DESCRIPTION: Allocation counts and bytes per allocSCOPE. The profiling build
+ * 				interposes malloc, calloc and realloc, which operator new
+ * 				allocates through as well.
+ */
+class AllocProfile {
+public:
+	static const bool enabled;
+	static const char *const scopeNames[ALLOC_SCOPES];
+	static int enter(int scope);
+	static void leave(int previous);
+	static uint64_t allocations();
+	static int writeReport(const char *path);
+};
+
+/**
+ * CLASS NAME: AllocScope
+ *
+ * DESCRIPTION: Charges the allocations of its lifetime to a scope
+ */
+class AllocScope {
+private:
+	int previous;
+public:
+	AllocScope(int scope): previous(AllocProfile::enter(scope)) {}
+	~AllocScope() {
+		AllocProfile::leave(previous);
+	}
+};
+
+#endif /* ALLOCPROFILE_H_ */
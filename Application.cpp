@@ -47,11 +47,21 @@ int main(int argc, char *argv[]) {
 Application::Application(char *infile) {
 	int i;
 	par = new Params();
-	srand (time(NULL));
 	par->setparams(infile);
+	rng.seed(par->SEED, "app", 0);
+	cout<<"Seed: "<<par->SEED<<endl;
+	if ( par->TRACE ) {
+		Trace::startSpans(&par->globaltime);
+	}
+	if ( par->METRICS_INTERVAL > 0 ) {
+		Metrics::open(METRICS_FILE_LOCATION);
+	}
 	log = new Log(par);
-	en = new EmulNet(par);
-	en1 = new EmulNet(par);
+	workload = NULL;
+	en = new EmulNet(par, "mp1.net");
+	en1 = new EmulNet(par, "mp2.net");
+	en->ENsetProtocol("membership", MP1Node::messageTypeNames, DUMMYLASTMSGTYPE, MP1Node::classifyMessage);
+	en1->ENsetProtocol("kv", MP2Node::messageTypeNames, HANDOFF + 1, MP2Node::classifyMessage);
 	mp1 = (MP1Node **) malloc(par->EN_GPSZ * sizeof(MP1Node *));
 	mp2 = (MP2Node **) malloc(par->EN_GPSZ * sizeof(MP2Node *));
 
@@ -71,12 +81,18 @@ Application::Application(char *infile) {
 		log->LOG(&(mp2[i]->getMemberNode()->addr), "APP MP2");
 		delete addressOfMemberNode;
 	}
+	if ( WORKLOAD_TEST == par->CRUDTEST ) {
+		workload = new Workload(par, mp2, INSERT_TIME, TOTAL_RUNNING_TIME);
+	}
+	// rerun with "SEED: <seed>" to reproduce this run
+	log->LOG(&(mp1[0]->getMemberNode()->addr), "SEED %llu", par->SEED);
 }
 
 /**
  * Destructor
  */
 Application::~Application() {
+	delete workload;
 	delete log;
 	delete en;
 	delete en1;
@@ -100,10 +116,12 @@ int Application::run()
 	int timeWhenAllNodesHaveJoined = 0;
 	// boolean indicating if all nodes have joined
 	bool allNodesJoined = false;
-	srand(time(NULL));
 
 	// As time runs along
 	for( par->globaltime = 0; par->globaltime < TOTAL_RUNNING_TIME; ++par->globaltime ) {
+		// node ids start at 1, so the ticks get a track of their own
+		TRACE_SCOPE("tick", "simulation", 0);
+
 		// Run the membership protocol
 		mp1Run();
 
@@ -118,16 +136,39 @@ int Application::run()
 		}
 		// Fail some nodes
 		//fail();
+
+		if ( par->METRICS_INTERVAL > 0 && par->getcurrtime() % par->METRICS_INTERVAL == 0 ) {
+			Metrics::snapshot(par->getcurrtime());
+		}
 	}
 
 	// Clean up
 	en->ENcleanup();
 	en1->ENcleanup();
+	writeLatencyReport();
+	if ( NULL != workload ) {
+		workload->writeReport(WORKLOAD_REPORT);
+	}
+	vector<const Traffic *> traffic;
+	traffic.push_back(&en->ENtraffic());
+	traffic.push_back(&en1->ENtraffic());
+	Traffic::writeReport(traffic);
+	if ( AllocProfile::enabled ) {
+		AllocProfile::writeReport(ALLOC_PROFILE_LOG);
+	}
 
 	for(i=0;i<=par->EN_GPSZ-1;i++) {
 		 mp1[i]->finishUpThisNode();
 	}
 
+	if ( par->TRACE ) {
+		Trace::writeChromeTrace(TRACE_FILE_LOCATION);
+	}
+	if ( par->METRICS_INTERVAL > 0 ) {
+		Metrics::snapshot(par->getcurrtime());
+		Metrics::close();
+	}
+
 	return SUCCESS;
 }
 
@@ -171,11 +212,9 @@ void Application::mp1Run() {
 		else if( par->getcurrtime() > (int)(par->STEP_RATE*i) && !(mp1[i]->getMemberNode()->bFailed) ) {
 			// handle messages and send heartbeats
 			mp1[i]->nodeLoop();
-			#ifdef DEBUGLOG
 			if( (i == 0) && (par->globaltime % 500 == 0) ) {
-				log->LOG(&mp1[i]->getMemberNode()->addr, "@@time=%d", par->getcurrtime());
+				LOG_IF(LOG_LEVEL_DEBUG, LOG_MEMBERSHIP, log->LOG(&mp1[i]->getMemberNode()->addr, "@@time=%d", par->getcurrtime()));
 			}
-			#endif
 		}
 
 	}
@@ -221,10 +260,17 @@ void Application::mp2Run() {
 	/**
 	 * Insert a set of test key value pairs into the system
 	 */
-	if ( par->getcurrtime() == INSERT_TIME ) {
+	if ( par->getcurrtime() == INSERT_TIME && WORKLOAD_TEST != par->CRUDTEST ) {
 		insertTestKVPairs();
 	}
 
+	/**
+	 * Or drive the store with the configured workload
+	 */
+	if ( NULL != workload ) {
+		workload->tick(par->getcurrtime());
+	}
+
 	/**
 	 * Test CRUD operations
 	 */
@@ -342,18 +388,14 @@ void Application::fail() {
 	}
 
 	if( par->SINGLE_FAILURE && par->getcurrtime() == 100 ) {
-		removed = (rand() % par->EN_GPSZ);
-		#ifdef DEBUGLOG
-		log->LOG(&mp1[removed]->getMemberNode()->addr, "Node failed at time=%d", par->getcurrtime());
-		#endif
+		removed = rng.below(par->EN_GPSZ);
+		LOG_IF(LOG_LEVEL_INFO, LOG_MEMBERSHIP, log->LOG(&mp1[removed]->getMemberNode()->addr, "Node failed at time=%d", par->getcurrtime()));
 		mp1[removed]->getMemberNode()->bFailed = true;
 	}
 	else if( par->getcurrtime() == 100 ) {
-		removed = rand() % par->EN_GPSZ/2;
+		removed = rng.below(par->EN_GPSZ)/2;
 		for ( i = removed; i < removed + par->EN_GPSZ/2; i++ ) {
-			#ifdef DEBUGLOG
-			log->LOG(&mp1[i]->getMemberNode()->addr, "Node failed at time = %d", par->getcurrtime());
-			#endif
+			LOG_IF(LOG_LEVEL_INFO, LOG_MEMBERSHIP, log->LOG(&mp1[i]->getMemberNode()->addr, "Node failed at time = %d", par->getcurrtime()));
 			mp1[i]->getMemberNode()->bFailed = true;
 		}
 	}
@@ -387,7 +429,7 @@ Address Application::getjoinaddr(void){
 int Application::findARandomNodeThatIsAlive() {
 	int number;
 	do {
-		number = (rand()%par->EN_GPSZ);
+		number = rng.below(par->EN_GPSZ);
 	}while (mp2[number]->getMemberNode()->bFailed);
 	return number;
 }
@@ -398,7 +440,6 @@ int Application::findARandomNodeThatIsAlive() {
  * DESCRIPTION: Init NUMBER_OF_INSERTS test KV pairs in the map
  */
 void Application::initTestKVPairs() {
-	srand(time(NULL));
 	int i;
 	string key;
 	key.clear();
@@ -406,9 +447,9 @@ void Application::initTestKVPairs() {
 	int alphanumLen = sizeof(alphanum) - 1;
 	while ( testKVPairs.size() != NUMBER_OF_INSERTS ) {
 		for ( i = 0; i < KEY_LENGTH; i++ ) {
-			key.push_back(alphanum[rand()%alphanumLen]);
+			key.push_back(alphanum[rng.below(alphanumLen)]);
 		}
-		string value = "value" + to_string(rand()%NUMBER_OF_INSERTS);
+		string value = "value" + to_string(rng.below(NUMBER_OF_INSERTS));
 		testKVPairs[key] = value;
 		key.clear();
 	}
@@ -962,3 +1003,44 @@ void Application::updateTest() {
 	/** end of test 5 **/
 
 }
+
+/**
+ * FUNCTION NAME: writeLatencyReport
+ *
+ * DESCRIPTION: Write the latency, in ticks, of the client operations to latency.log:
+ * 				one line per operation type and coordinator, then the histograms
+ * 				of all coordinators merged
+ */
+void Application::writeLatencyReport() {
+	static const char *names[] = { "create", "read", "update", "delete" };
+	FILE *fp = fopen(LATENCY_LOG, "w");
+	if ( NULL == fp ) {
+		printf("Unable to open %s\n", LATENCY_LOG);
+		return;
+	}
+
+	fprintf(fp, "seed %llu\n\n", par->SEED);
+	fprintf(fp, "%-7s %-10s %8s %6s %6s %6s %6s %6s %8s %8s\n", "op", "node", "count", "min", "p50", "p99", "p999", "max", "mean", "timeouts");
+	for ( int type = CREATE; type <= DELETE; type++ ) {
+		Histogram cluster;
+		unsigned long clusterTimeouts = 0;
+		for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+			const Histogram& h = mp2[i]->getLatency((MessageType)type);
+			unsigned long timeouts = mp2[i]->getTimeouts((MessageType)type);
+			cluster.merge(h);
+			clusterTimeouts += timeouts;
+			if ( 0 == h.count() && 0 == timeouts ) {
+				continue;
+			}
+			fprintf(fp, "%-7s %-10s %8lu %6lu %6lu %6lu %6lu %6lu %8.2f %8lu\n", names[type],
+					mp2[i]->getMemberNode()->addr.getAddress().c_str(), (unsigned long)h.count(), (unsigned long)h.min(),
+					(unsigned long)h.percentile(50), (unsigned long)h.percentile(99), (unsigned long)h.percentile(99.9),
+					(unsigned long)h.max(), h.mean(), timeouts);
+		}
+		fprintf(fp, "%-7s %-10s %8lu %6lu %6lu %6lu %6lu %6lu %8.2f %8lu\n", names[type], "all",
+				(unsigned long)cluster.count(), (unsigned long)cluster.min(), (unsigned long)cluster.percentile(50),
+				(unsigned long)cluster.percentile(99), (unsigned long)cluster.percentile(99.9), (unsigned long)cluster.max(),
+				cluster.mean(), clusterTimeouts);
+	}
+	fclose(fp);
+}
@@ -17,6 +17,8 @@
 #include "MP2Node.h"
 #include "Node.h"
 #include "common.h"
+#include "Random.h"
+#include "Workload.h"
 
 /**
  * global variables
@@ -40,6 +42,7 @@ static const char alphanum[] =
 #define RF 3
 #define NUMBER_OF_INSERTS 100
 #define KEY_LENGTH 5
+#define LATENCY_LOG "latency.log"
 
 /**
  * CLASS NAME: Application
@@ -58,6 +61,10 @@ private:
 	MP2Node **mp2;
 	Params *par;
 	map<string, string> testKVPairs;
+	// picks the failed nodes, the test keys and the clients
+	Random rng;
+	// drives the KV store when CRUD_TEST is WORKLOAD
+	Workload *workload;
 public:
 	Application(char *);
 	virtual ~Application();
@@ -72,6 +79,7 @@ public:
 	void deleteTest();
 	void readTest();
 	void updateTest();
+	void writeLatencyReport();
 };
 
 #endif /* _APPLICATION_H__ */
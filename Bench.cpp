@@ -0,0 +1,471 @@
+/**********************************
+ * FILE NAME: Bench.cpp
+ *
+ * DESCRIPTION: Scale benchmark. Runs the Application under the workload generator
+ * 				for every combination of cluster size, record count, drop probability
+ * 				and failed nodes of a matrix conf, one process per run, and writes
+ * 				wall and CPU time per tick, peak RSS, messages per node and KV
+ * 				latency of each run as a CSV table. A run is repeated BENCH_REPEAT
+ * 				times and keeps its fastest times; runs are seeded, so the other
+ * 				metrics do not change between repetitions. With a baseline table,
+ * 				every metric that got worse by more than the tolerance is reported
+ * 				as a regression. Only the metrics that do not depend on the machine
+ * 				are compared (messages per node, throughput, latency in ticks and
+ * 				failures): wall and CPU time and peak RSS are only reported, as they
+ * 				differ between the machine the baseline was taken on and this one.
+ * 				The runs write their logs to the current directory, as the
+ * 				Application does.
+ *
+ * RUN PROCEDURE:
+ * $ ./Bench testcases/bench.conf bench.csv [testcases/bench_baseline.csv]
+ **********************************/
+
+#include "Application.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <math.h>
+#include <chrono>
+
+/*
+ * Macros
+ */
+#define BENCH_RUN_CONF "bench_run.conf"
+#define BENCH_TRAFFIC_CSV "traffic.csv"
+
+enum benchMETRIC { MS_PER_TICK, CPU_MS_PER_TICK, PEAK_RSS_KB, MP1_MSGS_PER_NODE, MP2_MSGS_PER_NODE, KV_OPS_PER_TICK, KV_P50, KV_P99, KV_MEAN,
+	KV_FAIL_PCT, BENCH_METRICS };
+
+static const char *metricNames[BENCH_METRICS] = { "ms_per_tick", "cpu_ms_per_tick", "peak_rss_kb", "mp1_msgs_per_node", "mp2_msgs_per_node",
+		"kv_ops_per_tick", "kv_p50", "kv_p99", "kv_mean", "kv_fail_pct" };
+// +1 when a higher value is worse, -1 when a lower one is, 0 when it is not compared
+static const int metricWorse[BENCH_METRICS] = { 0, 0, 0, 1, 1, -1, 0, 1, 0, 1 };
+// changes smaller than this are noise, whatever the tolerance says
+static const double metricSlack[BENCH_METRICS] = { 0, 0, 0, 1, 1, 0.5, 0, 1, 0, 1 };
+
+/**
+ * STRUCT NAME: BenchPoint
+ *
+ * DESCRIPTION: One run of the matrix and what it measured
+ */
+struct BenchPoint {
+	int nodes;
+	int records;
+	double dropProb;
+	int failNodes;
+	double values[BENCH_METRICS];
+	BenchPoint(): nodes(0), records(0), dropProb(0), failNodes(0) {
+		for ( int i = 0; i < BENCH_METRICS; i++ ) {
+			values[i] = NAN;
+		}
+	}
+	bool sameRun(const BenchPoint& other) const {
+		return nodes == other.nodes && records == other.records && fabs(dropProb - other.dropProb) < 1e-9
+				&& failNodes == other.failNodes;
+	}
+};
+
+/**
+ * STRUCT NAME: BenchMatrix
+ *
+ * DESCRIPTION: The values swept, and the conf lines every run shares
+ */
+struct BenchMatrix {
+	vector<int> nodes;
+	vector<int> records;
+	vector<double> dropProbs;
+	vector<int> failNodes;
+	double tolerance;
+	int repeat;
+	vector<string> common;
+	BenchMatrix(): tolerance(20), repeat(1) {}
+};
+
+/**
+ * FUNCTION NAME: readMatrix
+ *
+ * DESCRIPTION: Read a matrix conf: "BENCH_<NAME>: <value> <value> ..." lines give the
+ * 				values swept, every other line is copied to the conf of each run
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+static bool readMatrix(const char *path, BenchMatrix& matrix) {
+	FILE *fp = fopen(path, "r");
+	if ( NULL == fp ) {
+		return false;
+	}
+	char line[1024];
+	while ( fgets(line, sizeof(line), fp) ) {
+		line[strcspn(line, "\r\n")] = '\0';
+		char *colon = strchr(line, ':');
+		if ( 0 != strncmp(line, "BENCH_", 6) || NULL == colon ) {
+			if ( line[0] != '\0' && line[0] != '#' ) {
+				matrix.common.push_back(line);
+			}
+			continue;
+		}
+		*colon = '\0';
+		string name = line;
+		for ( char *value = strtok(colon + 1, " \t,"); NULL != value; value = strtok(NULL, " \t,") ) {
+			if ( "BENCH_NODES" == name ) {
+				matrix.nodes.push_back(atoi(value));
+			}
+			else if ( "BENCH_RECORDS" == name ) {
+				matrix.records.push_back(atoi(value));
+			}
+			else if ( "BENCH_DROP_PROB" == name ) {
+				matrix.dropProbs.push_back(atof(value));
+			}
+			else if ( "BENCH_FAIL_NODES" == name ) {
+				matrix.failNodes.push_back(atoi(value));
+			}
+			else if ( "BENCH_TOLERANCE" == name ) {
+				matrix.tolerance = atof(value);
+			}
+			else if ( "BENCH_REPEAT" == name ) {
+				matrix.repeat = max(atoi(value), 1);
+			}
+			else {
+				fprintf(stderr, "Unknown matrix key %s\n", name.c_str());
+			}
+		}
+	}
+	fclose(fp);
+	return !matrix.nodes.empty() && !matrix.records.empty() && !matrix.dropProbs.empty() && !matrix.failNodes.empty();
+}
+
+/**
+ * FUNCTION NAME: writeRunConf
+ *
+ * DESCRIPTION: Conf of the Application run of point
+ */
+static bool writeRunConf(const BenchMatrix& matrix, const BenchPoint& point) {
+	FILE *fp = fopen(BENCH_RUN_CONF, "w");
+	if ( NULL == fp ) {
+		return false;
+	}
+	for ( size_t i = 0; i < matrix.common.size(); i++ ) {
+		fprintf(fp, "%s\n", matrix.common[i].c_str());
+	}
+	// later lines win, so the point overrides the common lines
+	fprintf(fp, "CRUD_TEST: WORKLOAD\n");
+	fprintf(fp, "MAX_NNB: %d\n", point.nodes);
+	fprintf(fp, "WORKLOAD_RECORDS: %d\n", point.records);
+	fprintf(fp, "DROP_MSG: %d\n", point.dropProb > 0 ? 1 : 0);
+	fprintf(fp, "MSG_DROP_PROB: %g\n", point.dropProb);
+	fprintf(fp, "WORKLOAD_FAIL_NODES: %d\n", point.failNodes);
+	fclose(fp);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: runApplication
+ *
+ * DESCRIPTION: Run the Application on the run conf, with its output thrown away
+ *
+ * RETURNS:
+ * true if it exited with SUCCESS; its wall and CPU time in seconds and cpuSeconds,
+ * its peak RSS in rssKB
+ */
+static bool runApplication(double& seconds, double& cpuSeconds, long& rssKB) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	pid_t pid = fork();
+	if ( pid < 0 ) {
+		return false;
+	}
+	if ( 0 == pid ) {
+		int devnull = open("/dev/null", O_WRONLY);
+		dup2(devnull, STDOUT_FILENO);
+		dup2(devnull, STDERR_FILENO);
+		execl("./Application", "./Application", BENCH_RUN_CONF, (char *)NULL);
+		_exit(127);
+	}
+	int status;
+	struct rusage usage;
+	if ( wait4(pid, &status, 0, &usage) != pid ) {
+		return false;
+	}
+	seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	cpuSeconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+	// kilobytes on Linux
+	rssKB = usage.ru_maxrss;
+	return WIFEXITED(status) && SUCCESS == WEXITSTATUS(status);
+}
+
+/**
+ * FUNCTION NAME: readTraffic
+ *
+ * DESCRIPTION: Messages sent by each protocol over the run, from the traffic CSV
+ */
+static bool readTraffic(double& membership, double& kv) {
+	FILE *fp = fopen(BENCH_TRAFFIC_CSV, "r");
+	if ( NULL == fp ) {
+		return false;
+	}
+	membership = kv = 0;
+	char line[256];
+	// time,protocol,type,sent,sent_bytes,received,received_bytes
+	while ( fgets(line, sizeof(line), fp) ) {
+		char protocol[64];
+		long sent;
+		if ( sscanf(line, "%*d,%63[^,],%*[^,],%ld", protocol, &sent) != 2 ) {
+			continue;
+		}
+		if ( 0 == strcmp(protocol, "membership") ) {
+			membership += sent;
+		}
+		else if ( 0 == strcmp(protocol, "kv") ) {
+			kv += sent;
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: readWorkload
+ *
+ * DESCRIPTION: Throughput, latency and failure rate of the run phase, from the
+ * 				workload report. p50 and p99 are the worst over the operation types,
+ * 				the mean is over every completed operation.
+ */
+static bool readWorkload(BenchPoint& point) {
+	FILE *fp = fopen(WORKLOAD_REPORT, "r");
+	if ( NULL == fp ) {
+		return false;
+	}
+	double issued = 0, failed = 0, completed = 0, latencySum = 0, p50 = 0, p99 = 0, opsPerTick = NAN;
+	char line[512];
+	while ( fgets(line, sizeof(line), fp) ) {
+		char op[32];
+		unsigned long long n, done, failures, timeouts, lp50, lp99;
+		double mean;
+		if ( sscanf(line, "run throughput %lf", &opsPerTick) == 1 ) {
+			continue;
+		}
+		// phase op issued completed failed timeouts fail% p50 p99 p999 max mean
+		if ( sscanf(line, "run %31s %llu %llu %llu %llu %*f%% %llu %llu %*u %*u %lf", op, &n, &done, &failures, &timeouts, &lp50,
+				&lp99, &mean) != 8 ) {
+			continue;
+		}
+		issued += n;
+		failed += failures + timeouts;
+		completed += done;
+		latencySum += mean * done;
+		p50 = max(p50, (double)lp50);
+		p99 = max(p99, (double)lp99);
+	}
+	fclose(fp);
+	point.values[KV_OPS_PER_TICK] = opsPerTick;
+	point.values[KV_P50] = p50;
+	point.values[KV_P99] = p99;
+	point.values[KV_MEAN] = completed > 0 ? latencySum / completed : 0;
+	point.values[KV_FAIL_PCT] = issued > 0 ? 100.0 * failed / issued : 0;
+	return !isnan(opsPerTick);
+}
+
+/**
+ * FUNCTION NAME: measure
+ *
+ * DESCRIPTION: Run point matrix.repeat times and fill in its metrics
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+static bool measure(const BenchMatrix& matrix, BenchPoint& point) {
+	double seconds, cpuSeconds, membership, kv;
+	long rssKB;
+	if ( !writeRunConf(matrix, point) ) {
+		return false;
+	}
+	for ( int i = 0; i < matrix.repeat; i++ ) {
+		if ( !runApplication(seconds, cpuSeconds, rssKB) ) {
+			return false;
+		}
+		point.values[MS_PER_TICK] = i > 0 ? min(point.values[MS_PER_TICK], 1000.0 * seconds / TOTAL_RUNNING_TIME)
+				: 1000.0 * seconds / TOTAL_RUNNING_TIME;
+		point.values[CPU_MS_PER_TICK] = i > 0 ? min(point.values[CPU_MS_PER_TICK], 1000.0 * cpuSeconds / TOTAL_RUNNING_TIME)
+				: 1000.0 * cpuSeconds / TOTAL_RUNNING_TIME;
+		point.values[PEAK_RSS_KB] = i > 0 ? max(point.values[PEAK_RSS_KB], (double)rssKB) : rssKB;
+	}
+	if ( !readTraffic(membership, kv) ) {
+		return false;
+	}
+	point.values[MP1_MSGS_PER_NODE] = membership / point.nodes;
+	point.values[MP2_MSGS_PER_NODE] = kv / point.nodes;
+	return readWorkload(point);
+}
+
+/**
+ * FUNCTION NAME: writeTable
+ *
+ * DESCRIPTION: Write points as CSV to fp
+ */
+static void writeTable(FILE *fp, const vector<BenchPoint>& points) {
+	fprintf(fp, "nodes,records,drop_prob,fail_nodes");
+	for ( int m = 0; m < BENCH_METRICS; m++ ) {
+		fprintf(fp, ",%s", metricNames[m]);
+	}
+	fprintf(fp, "\n");
+	for ( size_t i = 0; i < points.size(); i++ ) {
+		const BenchPoint& p = points[i];
+		fprintf(fp, "%d,%d,%g,%d", p.nodes, p.records, p.dropProb, p.failNodes);
+		for ( int m = 0; m < BENCH_METRICS; m++ ) {
+			fprintf(fp, ",%.3f", p.values[m]);
+		}
+		fprintf(fp, "\n");
+	}
+}
+
+/**
+ * FUNCTION NAME: readTable
+ *
+ * DESCRIPTION: Read a CSV table written by writeTable
+ */
+static bool readTable(const char *path, vector<BenchPoint>& points) {
+	FILE *fp = fopen(path, "r");
+	if ( NULL == fp ) {
+		return false;
+	}
+	char line[1024];
+	// header
+	if ( !fgets(line, sizeof(line), fp) ) {
+		fclose(fp);
+		return false;
+	}
+	while ( fgets(line, sizeof(line), fp) ) {
+		BenchPoint p;
+		int used;
+		if ( sscanf(line, "%d,%d,%lf,%d%n", &p.nodes, &p.records, &p.dropProb, &p.failNodes, &used) != 4 ) {
+			continue;
+		}
+		char *field = line + used;
+		for ( int m = 0; m < BENCH_METRICS && ',' == *field; m++ ) {
+			p.values[m] = strtod(field + 1, &field);
+		}
+		points.push_back(p);
+	}
+	fclose(fp);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: compare
+ *
+ * DESCRIPTION: Print every metric of points that is worse than in baseline by more
+ * 				than tolerance percent
+ *
+ * RETURNS:
+ * the number of regressions
+ */
+static int compare(const vector<BenchPoint>& points, const vector<BenchPoint>& baseline, double tolerance) {
+	int regressions = 0;
+	for ( size_t i = 0; i < points.size(); i++ ) {
+		const BenchPoint& p = points[i];
+		const BenchPoint *base = NULL;
+		for ( size_t j = 0; j < baseline.size() && NULL == base; j++ ) {
+			if ( baseline[j].sameRun(p) ) {
+				base = &baseline[j];
+			}
+		}
+		if ( NULL == base ) {
+			printf("no baseline for nodes=%d records=%d drop=%g fail=%d\n", p.nodes, p.records, p.dropProb, p.failNodes);
+			continue;
+		}
+		for ( int m = 0; m < BENCH_METRICS; m++ ) {
+			double was = base->values[m], now = p.values[m];
+			if ( 0 == metricWorse[m] || isnan(was) ) {
+				continue;
+			}
+			double worse = metricWorse[m] * (now - was);
+			if ( isnan(now) || (worse > metricSlack[m] && worse > fabs(was) * tolerance / 100) ) {
+				printf("REGRESSION nodes=%d records=%d drop=%g fail=%d: %s %.3f -> %.3f (%+.1f%%)\n", p.nodes, p.records,
+						p.dropProb, p.failNodes, metricNames[m], was, now, was != 0 ? 100 * (now - was) / fabs(was) : 0.0);
+				regressions++;
+			}
+		}
+	}
+	return regressions;
+}
+
+/**********************************
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: main function. Run the matrix, write the table, compare it to the baseline
+ **********************************/
+int main(int argc, char *argv[]) {
+	if ( argc != 3 && argc != 4 ) {
+		fprintf(stderr, "Usage: %s <matrix .conf> <results .csv> [baseline .csv]\n", argv[0]);
+		return FAILURE;
+	}
+	BenchMatrix matrix;
+	if ( !readMatrix(argv[1], matrix) ) {
+		fprintf(stderr, "Unable to read matrix %s: it needs BENCH_NODES, BENCH_RECORDS, BENCH_DROP_PROB and BENCH_FAIL_NODES\n",
+				argv[1]);
+		return FAILURE;
+	}
+	vector<BenchPoint> baseline;
+	if ( argc == 4 && !readTable(argv[3], baseline) ) {
+		fprintf(stderr, "Unable to read baseline %s\n", argv[3]);
+		return FAILURE;
+	}
+
+	vector<BenchPoint> points;
+	int failedRuns = 0;
+	printf("%6s %8s %6s %5s", "nodes", "records", "drop", "fail");
+	for ( int m = 0; m < BENCH_METRICS; m++ ) {
+		printf(" %*s", (int)max(strlen(metricNames[m]), (size_t)8), metricNames[m]);
+	}
+	printf("\n");
+	for ( size_t n = 0; n < matrix.nodes.size(); n++ ) {
+		for ( size_t r = 0; r < matrix.records.size(); r++ ) {
+			for ( size_t d = 0; d < matrix.dropProbs.size(); d++ ) {
+				for ( size_t f = 0; f < matrix.failNodes.size(); f++ ) {
+					BenchPoint p;
+					p.nodes = matrix.nodes[n];
+					p.records = matrix.records[r];
+					p.dropProb = matrix.dropProbs[d];
+					p.failNodes = matrix.failNodes[f];
+					if ( p.nodes < 1 || p.nodes > MAX_NODES || p.failNodes >= p.nodes ) {
+						fprintf(stderr, "Skipping %d nodes with %d failed: EmulNet takes 1 to %d nodes\n", p.nodes, p.failNodes,
+								MAX_NODES);
+						continue;
+					}
+					if ( !measure(matrix, p) ) {
+						failedRuns++;
+					}
+					printf("%6d %8d %6g %5d", p.nodes, p.records, p.dropProb, p.failNodes);
+					for ( int m = 0; m < BENCH_METRICS; m++ ) {
+						printf(" %*.3f", (int)max(strlen(metricNames[m]), (size_t)8), p.values[m]);
+					}
+					printf("\n");
+					fflush(stdout);
+					points.push_back(p);
+				}
+			}
+		}
+	}
+
+	FILE *fp = fopen(argv[2], "w");
+	if ( NULL == fp ) {
+		fprintf(stderr, "Unable to open %s\n", argv[2]);
+		return FAILURE;
+	}
+	writeTable(fp, points);
+	fclose(fp);
+	printf("%zu runs written to %s\n", points.size(), argv[2]);
+	if ( failedRuns > 0 ) {
+		printf("%d runs failed\n", failedRuns);
+	}
+
+	int regressions = 0;
+	if ( !baseline.empty() ) {
+		regressions = compare(points, baseline, matrix.tolerance);
+		printf("%d regressions against %s, tolerance %g%%\n", regressions, argv[3], matrix.tolerance);
+	}
+	return failedRuns > 0 || regressions > 0 ? FAILURE : SUCCESS;
+}
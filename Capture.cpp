@@ -0,0 +1,94 @@
+/**********************************
+ * FILE NAME: Capture.cpp
+ *
+ * DESCRIPTION: EmulNet traffic capture definition
+ **********************************/
+
+#include "Capture.h"
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Start a capture of the traffic of protocol at path
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool Capture::open(const string& path, const string& protocol, int nodes) {
+	if ( !writer.open(path.c_str()) ) {
+		printf("Unable to open capture file %s\n", path.c_str());
+		return false;
+	}
+	CaptureHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+	header.version = CAPTURE_VERSION;
+	header.nodes = nodes;
+	strncpy(header.protocol, protocol.c_str(), CAPTURE_PROTOCOL_LEN - 1);
+	writer.write((const char *)&header, sizeof(header));
+	return true;
+}
+
+/**
+ * FUNCTION NAME: isOpen
+ *
+ * DESCRIPTION: Whether messages are being captured
+ */
+bool Capture::isOpen() {
+	return writer.isOpen();
+}
+
+/**
+ * FUNCTION NAME: record
+ *
+ * DESCRIPTION: Append a message delivered from node from to node to at time
+ */
+void Capture::record(int time, int from, int to, const char *data, int size) {
+	assert(from <= UINT16_MAX && to <= UINT16_MAX);
+	CaptureRecord r;
+	r.time = time;
+	r.from = from;
+	r.to = to;
+	r.size = size;
+	writer.write((const char *)&r, sizeof(r));
+	writer.write(data, size);
+}
+
+/**
+ * FUNCTION NAME: close
+ *
+ * DESCRIPTION: Finish the capture
+ */
+void Capture::close() {
+	writer.close();
+}
+
+/**
+ * FUNCTION NAME: load
+ *
+ * DESCRIPTION: Read the capture at path: its header, and every record with its
+ * 				payload into records
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool Capture::load(const char *path, CaptureHeader& header, vector<char>& records) {
+	FILE *fp = fopen(path, "rb");
+	if ( NULL == fp ) {
+		return false;
+	}
+	bool ok = fread(&header, sizeof(header), 1, fp) == 1
+			&& 0 == memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic))
+			&& CAPTURE_VERSION == header.version;
+	header.protocol[CAPTURE_PROTOCOL_LEN - 1] = '\0';
+	records.clear();
+	char buffer[65536];
+	size_t n;
+	while ( ok && (n = fread(buffer, 1, sizeof(buffer), fp)) > 0 ) {
+		records.insert(records.end(), buffer, buffer + n);
+	}
+	fclose(fp);
+	return ok;
+}
@@ -0,0 +1,68 @@
+/**********************************
+ * FILE NAME: Capture.h
+ *
+ * DESCRIPTION: Header file of the EmulNet traffic capture
+ **********************************/
+
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include "stdincludes.h"
+#include "LogWriter.h"
+
+#include <stdint.h>
+
+/*
+ * Macros
+ */
+// the capture of an EmulNet is written to <network name> CAPTURE_SUFFIX
+#define CAPTURE_SUFFIX ".cap"
+#define CAPTURE_MAGIC "KVCAPT\1"
+#define CAPTURE_VERSION 1
+#define CAPTURE_PROTOCOL_LEN 16
+
+/**
+ * STRUCT NAME: CaptureHeader
+ *
+ * DESCRIPTION: Start of a capture file
+ */
+struct CaptureHeader {
+	char magic[8];
+	uint32_t version;
+	// number of nodes of the captured run
+	uint32_t nodes;
+	// Traffic protocol name of the network, NUL padded
+	char protocol[CAPTURE_PROTOCOL_LEN];
+};
+
+/**
+ * STRUCT NAME: CaptureRecord
+ *
+ * DESCRIPTION: One delivered message, followed by its size payload bytes
+ */
+struct CaptureRecord {
+	uint32_t time;
+	uint16_t from;
+	uint16_t to;
+	uint32_t size;
+};
+
+/**
+ * CLASS NAME: Capture
+ *
+ * DESCRIPTION: Binary trace of every message an EmulNet delivers, in delivery
+ * 				order, written off the simulation thread through a LogWriter.
+ * 				The Replay tool feeds a capture back into a single node.
+ */
+class Capture {
+private:
+	LogWriter writer;
+public:
+	bool open(const string& path, const string& protocol, int nodes);
+	bool isOpen();
+	void record(int time, int from, int to, const char *data, int size);
+	void close();
+	static bool load(const char *path, CaptureHeader& header, vector<char>& records);
+};
+
+#endif /* CAPTURE_H_ */
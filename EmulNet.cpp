@@ -5,18 +5,35 @@
  **********************************/
 
 #include "EmulNet.h"
+#include "Log.h"
 
 /**
  * Constructor
+ *
+ * DESCRIPTION: name prefixes the metrics of this network
  */
-EmulNet::EmulNet(Params *p)
+EmulNet::EmulNet(Params *p, const string& name)
 {
 	//trace.funcEntry("EmulNet::EmulNet");
 	int i,j;
 	par = p;
+	this->name = name;
 	emulnet.setNextId(1);
 	emulnet.settCurrBuffSize(0);
 	enInited=0;
+	sentCounter = Metrics::counter(name + ".sent");
+	receivedCounter = Metrics::counter(name + ".received");
+	droppedBufferFull = Metrics::counter(name + ".dropped.buffer_full");
+	droppedOversize = Metrics::counter(name + ".dropped.oversize");
+	droppedRandom = Metrics::counter(name + ".dropped.random");
+	droppedLinkFault = Metrics::counter(name + ".dropped.link_fault");
+	bufferedGauge = Metrics::gauge(name + ".buffered");
+	delayTicks = Metrics::counter(name + ".delay_ticks");
+	faults.configure(p);
+	rngs.resize(MAX_NODES + 1);
+	for ( i = 0; i <= MAX_NODES; i++ ) {
+		rngs[i].seed(par->SEED, name.c_str(), i);
+	}
 	for ( i = 0; i < MAX_NODES; i++ ) {
 		for ( j = 0; j < MAX_TIME; j++ ) {
 			sent_msgs[i][j] = 0;
@@ -32,6 +49,7 @@ EmulNet::EmulNet(Params *p)
 EmulNet::EmulNet(EmulNet &anotherEmulNet) {
 	int i, j;
 	this->par = anotherEmulNet.par;
+	this->name = anotherEmulNet.name;
 	this->enInited = anotherEmulNet.enInited;
 	for ( i = 0; i < MAX_NODES; i++ ) {
 		for ( j = 0; j < MAX_TIME; j++ ) {
@@ -40,6 +58,18 @@ EmulNet::EmulNet(EmulNet &anotherEmulNet) {
 		}
 	}
 	this->emulnet = anotherEmulNet.emulnet;
+	this->sentCounter = anotherEmulNet.sentCounter;
+	this->receivedCounter = anotherEmulNet.receivedCounter;
+	this->droppedBufferFull = anotherEmulNet.droppedBufferFull;
+	this->droppedOversize = anotherEmulNet.droppedOversize;
+	this->droppedRandom = anotherEmulNet.droppedRandom;
+	this->droppedLinkFault = anotherEmulNet.droppedLinkFault;
+	this->bufferedGauge = anotherEmulNet.bufferedGauge;
+	this->delayTicks = anotherEmulNet.delayTicks;
+	this->traffic = anotherEmulNet.traffic;
+	this->linkBusyUntil = anotherEmulNet.linkBusyUntil;
+	this->faults = anotherEmulNet.faults;
+	this->rngs = anotherEmulNet.rngs;
 }
 
 /**
@@ -48,6 +78,7 @@ EmulNet::EmulNet(EmulNet &anotherEmulNet) {
 EmulNet& EmulNet::operator =(EmulNet &anotherEmulNet) {
 	int i, j;
 	this->par = anotherEmulNet.par;
+	this->name = anotherEmulNet.name;
 	this->enInited = anotherEmulNet.enInited;
 	for ( i = 0; i < MAX_NODES; i++ ) {
 		for ( j = 0; j < MAX_TIME; j++ ) {
@@ -56,6 +87,18 @@ EmulNet& EmulNet::operator =(EmulNet &anotherEmulNet) {
 		}
 	}
 	this->emulnet = anotherEmulNet.emulnet;
+	this->sentCounter = anotherEmulNet.sentCounter;
+	this->receivedCounter = anotherEmulNet.receivedCounter;
+	this->droppedBufferFull = anotherEmulNet.droppedBufferFull;
+	this->droppedOversize = anotherEmulNet.droppedOversize;
+	this->droppedRandom = anotherEmulNet.droppedRandom;
+	this->droppedLinkFault = anotherEmulNet.droppedLinkFault;
+	this->bufferedGauge = anotherEmulNet.bufferedGauge;
+	this->delayTicks = anotherEmulNet.delayTicks;
+	this->traffic = anotherEmulNet.traffic;
+	this->linkBusyUntil = anotherEmulNet.linkBusyUntil;
+	this->faults = anotherEmulNet.faults;
+	this->rngs = anotherEmulNet.rngs;
 	return *this;
 }
 
@@ -76,20 +119,82 @@ void *EmulNet::ENinit(Address *myaddr, short port) {
 	return myaddr;
 }
 
+/**
+ * FUNCTION NAME: sampleDelay
+ *
+ * DESCRIPTION: Latency of one message under NET_DELAY_MODEL, in ticks
+ */
+double EmulNet::sampleDelay(Random &rng) {
+	switch ( par->NET_DELAY_MODEL ) {
+		case UNIFORM_DELAY:
+			return par->NET_DELAY + rng.uniform() * (par->NET_DELAY_MAX - par->NET_DELAY);
+		case LOGNORMAL_DELAY: {
+			// Box-Muller; 1 - uniform() is in (0, 1] so the log is finite
+			double z = sqrt(-2.0 * log(1.0 - rng.uniform())) * cos(2.0 * M_PI * rng.uniform());
+			return par->NET_DELAY * exp(par->NET_DELAY_SIGMA * z);
+		}
+		default:
+			return par->NET_DELAY;
+	}
+}
+
+/**
+ * FUNCTION NAME: deliveryTime
+ *
+ * DESCRIPTION: Tick at which a message of size bytes sent now from src reaches dst.
+ * 				With NET_BANDWIDTH set, each link sends its messages one after the
+ * 				other, so a message also waits for the bytes queued ahead of it on
+ * 				its link beyond what the link carries this tick.
+ */
+int EmulNet::deliveryTime(int src, int dst, int size) {
+	int now = par->getcurrtime();
+	Random &rng = rngs[src];
+	double latency = sampleDelay(rng);
+	if ( par->NET_JITTER > 0 ) {
+		latency += rng.uniform() * par->NET_JITTER;
+	}
+	if ( par->NET_BANDWIDTH > 0 ) {
+		double &busyUntil = linkBusyUntil[make_pair(src, dst)];
+		busyUntil = max(busyUntil, (double)now) + (double)(size + sizeof(en_msg)) / par->NET_BANDWIDTH;
+		latency += max(0.0, busyUntil - now - 1);
+	}
+	return now + max(0, (int)(latency + 0.5));
+}
+
 /**
  * FUNCTION NAME: ENsend
  *
- * DESCRIPTION: EmulNet send function
+ * DESCRIPTION: EmulNet send function. The message is queued at its destination
+ * 				until its delivery tick.
  *
  * RETURNS:
  * size
  */
 int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
 	en_msg *em;
-	static char temp[2048];
-	int sendmsg = rand() % 100;
+	int src = *(int *)(myaddr->addr);
+	int dst = *(int *)(toaddr->addr);
+	int time = par->getcurrtime();
 
-	if( (emulnet.currbuffsize >= ENBUFFSIZE) || (size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE) || (par->dropmsg && sendmsg < (int) (par->MSG_DROP_PROB * 100)) ) {
+	assert(src <= MAX_NODES);
+	assert(dst <= MAX_NODES);
+	assert(time < MAX_TIME);
+
+	if ( emulnet.currbuffsize >= ENBUFFSIZE ) {
+		droppedBufferFull->add();
+		return 0;
+	}
+	if ( size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE ) {
+		droppedOversize->add();
+		return 0;
+	}
+	if ( par->dropmsg && (int)rngs[src].below(100) < (int) (par->MSG_DROP_PROB * 100) ) {
+		droppedRandom->add();
+		return 0;
+	}
+	const LinkState &link = faults.at(time, src, dst);
+	if ( link.drop >= 1 || (link.drop > 0 && rngs[src].uniform() < link.drop) ) {
+		droppedLinkFault->add();
 		return 0;
 	}
 
@@ -100,19 +205,18 @@ int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
 	memcpy(&(em->to.addr), &(toaddr->addr), sizeof(em->from.addr));
 	memcpy(em + 1, data, size);
 
-	emulnet.buff[emulnet.currbuffsize++] = em;
-
-	int src = *(int *)(myaddr->addr);
-	int time = par->getcurrtime();
-
-	assert(src <= MAX_NODES);
-	assert(time < MAX_TIME);
+	en_queued q;
+	q.deliverAt = deliveryTime(src, dst, size) + link.delay;
+	q.seq = emulnet.nextseq++;
+	q.msg = em;
+	emulnet.inbox[dst].push(q);
+	emulnet.currbuffsize++;
+	delayTicks->add(q.deliverAt - time);
 
 	sent_msgs[src][time]++;
-
-	#ifdef DEBUGLOG
-		sprintf(temp, "Sending 4+%d B msg type %d to %d.%d.%d.%d:%d ", size-4, *(int *)data, toaddr->addr[0], toaddr->addr[1], toaddr->addr[2], toaddr->addr[3], *(short *)&toaddr->addr[4]);
-	#endif
+	sentCounter->add();
+	traffic.sent(src, time, data, size);
+	bufferedGauge->set(emulnet.currbuffsize);
 
 	return size;
 }
@@ -120,59 +224,63 @@ int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
 /**
  * FUNCTION NAME: ENsend
  *
- * DESCRIPTION: EmulNet send function
+ * DESCRIPTION: EmulNet send function for serialized strings
  *
  * RETURNS:
  * size
  */
-int EmulNet::ENsend(Address *myaddr, Address *toaddr, string data) {
-	char * str = (char *) malloc(data.length() * sizeof(char));
-	memcpy(str, data.c_str(), data.size());
-	int ret = this->ENsend(myaddr, toaddr, str, (data.length() * sizeof(char)));
-	free(str);
-	return ret;
+int EmulNet::ENsend(Address *myaddr, Address *toaddr, const string& data) {
+	// the buffer is only read, the copy into the queued message is the only one
+	return this->ENsend(myaddr, toaddr, const_cast<char *>(data.data()), (int)data.size());
 }
 
 /**
  * FUNCTION NAME: ENrecv
  *
- * DESCRIPTION: EmulNet receive function
+ * DESCRIPTION: EmulNet receive function. Hands over the messages to this node
+ * 				whose delivery tick has come, in delivery order.
  *
  * RETURN:
  * 0
  */
 int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue){
+	TRACE_SCOPE("ENrecv", "network", *(int *)myaddr->addr);
+	ALLOC_SCOPE(ALLOC_NETWORK);
 	// times is always assumed to be 1
-	int i;
 	char* tmp;
 	int sz;
 	en_msg *emsg;
+	int dst = *(int *)(myaddr->addr);
+	int time = par->getcurrtime();
 
-	for( i = emulnet.currbuffsize - 1; i >= 0; i-- ) {
-		emsg = emulnet.buff[i];
-
-		if ( 0 == strcmp(emsg->to.addr, myaddr->addr) ) {
-			sz = emsg->size;
-			tmp = (char *) malloc(sz * sizeof(char));
-			memcpy(tmp, (char *)(emsg+1), sz);
+	assert(dst <= MAX_NODES);
+	assert(time < MAX_TIME);
 
-			emulnet.buff[i] = emulnet.buff[emulnet.currbuffsize-1];
-			emulnet.currbuffsize--;
+	en_inbox &inbox = emulnet.inbox[dst];
+	while ( !inbox.empty() && inbox.top().deliverAt <= time ) {
+		emsg = inbox.top().msg;
+		inbox.pop();
+		emulnet.currbuffsize--;
 
-			(*enq)(queue, (char *)tmp, sz);
+		sz = emsg->size;
+		tmp = (char *) malloc(sz * sizeof(char));
+		memcpy(tmp, (char *)(emsg+1), sz);
 
-			free(emsg);
+		(*enq)(queue, (char *)tmp, sz);
 
-			int dst = *(int *)(myaddr->addr);
-			int time = par->getcurrtime();
+		if ( capture.isOpen() ) {
+			capture.record(time, *(int *)(emsg->from.addr), dst, tmp, sz);
+		}
 
-			assert(dst <= MAX_NODES);
-			assert(time < MAX_TIME);
+		free(emsg);
 
-			recv_msgs[dst][time]++;
-		}
+		recv_msgs[dst][time]++;
+		receivedCounter->add();
+		traffic.received(dst, time, tmp, sz);
 	}
 
+	bufferedGauge->set(emulnet.currbuffsize);
+
 	return 0;
 }
 
@@ -188,9 +296,13 @@ int EmulNet::ENcleanup() {
 
 	FILE* file = fopen("msgcount.log", "w+");
 
-	while(emulnet.currbuffsize > 0) {
-		free(emulnet.buff[--emulnet.currbuffsize]);
+	for ( i = 0; i < (int)emulnet.inbox.size(); i++ ) {
+		while ( !emulnet.inbox[i].empty() ) {
+			free(emulnet.inbox[i].top().msg);
+			emulnet.inbox[i].pop();
+		}
 	}
+	emulnet.currbuffsize = 0;
 
 	for ( i = 1; i <= par->EN_GPSZ; i++ ) {
 		fprintf(file, "node %3d ", i);
@@ -216,5 +328,29 @@ int EmulNet::ENcleanup() {
 	}
 
 	fclose(file);
+	capture.close();
 	return 0;
 }
+
+/**
+ * FUNCTION NAME: ENsetProtocol
+ *
+ * DESCRIPTION: Tell the traffic accounting which protocol runs over this network
+ * 				and how to tell its message types apart. With CAPTURE set, this
+ * 				also starts the capture of the network.
+ */
+void EmulNet::ENsetProtocol(const string& protocol, const char *const *typeNames, int typeCount, MessageClassifier classify) {
+	traffic.setProtocol(protocol, typeNames, typeCount, classify);
+	if ( par->CAPTURE ) {
+		capture.open(name + CAPTURE_SUFFIX, protocol, par->EN_GPSZ);
+	}
+}
+
+/**
+ * FUNCTION NAME: ENtraffic
+ *
+ * DESCRIPTION: Traffic carried by this network so far
+ */
+const Traffic& EmulNet::ENtraffic() {
+	return traffic;
+}
@@ -14,6 +14,13 @@
 #include "stdincludes.h"
 #include "Params.h"
 #include "Member.h"
+#include "Trace.h"
+#include "AllocProfile.h"
+#include "Metrics.h"
+#include "Traffic.h"
+#include "LinkFaults.h"
+#include "Random.h"
+#include "Capture.h"
 
 using namespace std;
 
@@ -29,6 +36,25 @@ typedef struct en_msg {
 	Address to;
 }en_msg;
 
+/**
+ * Struct Name: en_queued
+ *
+ * DESCRIPTION: A message waiting in the inbox of its destination until its
+ * 				delivery tick. seq keeps messages due at the same tick in the
+ * 				order they were sent.
+ */
+typedef struct en_queued {
+	int deliverAt;
+	unsigned long seq;
+	en_msg *msg;
+	bool operator > (const en_queued &other) const {
+		return deliverAt != other.deliverAt ? deliverAt > other.deliverAt : seq > other.seq;
+	}
+}en_queued;
+
+// min-heap of the messages to one node, earliest delivery tick on top
+typedef priority_queue<en_queued, vector<en_queued>, greater<en_queued> > en_inbox;
+
 /**
  * Class Name: EM
  */
@@ -37,17 +63,16 @@ public:
 	int nextid;
 	int currbuffsize;
 	int firsteltindex;
-	en_msg* buff[ENBUFFSIZE];
-	EM() {}
+	unsigned long nextseq;
+	// inbox[id] holds the messages in flight to node id
+	vector<en_inbox> inbox;
+	EM(): nextseq(0), inbox(MAX_NODES + 1) {}
 	EM& operator = (EM &anotherEM) {
 		this->nextid = anotherEM.getNextId();
 		this->currbuffsize = anotherEM.getCurrBuffSize();
 		this->firsteltindex = anotherEM.getFirstEltIndex();
-		int i = this->currbuffsize;
-		while (i > 0) {
-			this->buff[i] = anotherEM.buff[i];
-			i--;
-		}
+		this->nextseq = anotherEM.nextseq;
+		this->inbox = anotherEM.inbox;
 		return *this;
 	}
 	int getNextId() {
@@ -80,20 +105,41 @@ class EmulNet
 { 	
 private:
 	Params* par;
+	string name;
 	int sent_msgs[MAX_NODES + 1][MAX_TIME];
 	int recv_msgs[MAX_NODES + 1][MAX_TIME];
 	int enInited;
 	EM emulnet;
+	// metrics
+	Counter *sentCounter;
+	Counter *receivedCounter;
+	Counter *droppedBufferFull;
+	Counter *droppedOversize;
+	Counter *droppedRandom;
+	Counter *droppedLinkFault;
+	Gauge *bufferedGauge;
+	Counter *delayTicks;
+	Traffic traffic;
+	// tick each link (src, dst) finishes transmitting its queued bytes, if bandwidth is capped
+	map<pair<int, int>, double> linkBusyUntil;
+	LinkFaults faults;
+	// rngs[id] draws the drops and delays of the messages node id sends
+	vector<Random> rngs;
+	Capture capture;
+	double sampleDelay(Random &rng);
+	int deliveryTime(int src, int dst, int size);
 public:
- 	EmulNet(Params *p);
+ 	EmulNet(Params *p, const string& name = "net");
  	EmulNet(EmulNet &anotherEmulNet);
  	EmulNet& operator = (EmulNet &anotherEmulNet);
  	virtual ~EmulNet();
 	void *ENinit(Address *myaddr, short port);
-	int ENsend(Address *myaddr, Address *toaddr, string data);
+	int ENsend(Address *myaddr, Address *toaddr, const string& data);
 	int ENsend(Address *myaddr, Address *toaddr, char *data, int size);
 	int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue);
 	int ENcleanup();
+	void ENsetProtocol(const string& protocol, const char *const *typeNames, int typeCount, MessageClassifier classify);
+	const Traffic& ENtraffic();
 };
 
 #endif /* _EMULNET_H_ */
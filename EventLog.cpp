@@ -0,0 +1,120 @@
+/**********************************
+ * FILE NAME: EventLog.cpp
+ *
+ * DESCRIPTION: Binary event log definition
+ **********************************/
+
+#include "EventLog.h"
+
+/**
+ * Constructor
+ */
+EventLog::EventLog(): nextString(1) {}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Start a new event log at path
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool EventLog::open(const char *path) {
+	if ( !writer.open(path) ) {
+		return false;
+	}
+	strings.clear();
+	nextString = 1;
+	writer.write(EVENT_LOG_MAGIC, strlen(EVENT_LOG_MAGIC));
+	return true;
+}
+
+/**
+ * FUNCTION NAME: isOpen
+ *
+ * DESCRIPTION: Returns if the event log is open
+ */
+bool EventLog::isOpen() {
+	return writer.isOpen();
+}
+
+/**
+ * FUNCTION NAME: append
+ *
+ * DESCRIPTION: Queue one record for the file
+ */
+void EventLog::append(const EventRecord& record) {
+	writer.write((const char *)&record, sizeof(record));
+}
+
+/**
+ * FUNCTION NAME: intern
+ *
+ * DESCRIPTION: Returns the id of key s, defining it in the log the first time it is seen
+ */
+uint32_t EventLog::intern(const string& s) {
+	unordered_map<string, uint32_t>::iterator it = strings.find(s);
+	if ( it != strings.end() ) {
+		return it->second;
+	}
+	EventRecord record;
+	memset(&record, 0, sizeof(record));
+	record.type = EVENT_STRING;
+	record.key = nextString;
+	record.value = (uint32_t)s.size();
+	append(record);
+	writer.write(s.data(), s.size());
+	strings[s] = nextString;
+	return nextString++;
+}
+
+/**
+ * FUNCTION NAME: nodeEvent
+ *
+ * DESCRIPTION: Record that node saw other join or leave
+ */
+void EventLog::nodeEvent(EventType type, Address *node, Address *other, int time) {
+	EventRecord record;
+	int id;
+	short port;
+	memset(&record, 0, sizeof(record));
+	memcpy(&id, &other->addr[0], sizeof(int));
+	memcpy(&port, &other->addr[4], sizeof(short));
+	record.type = type;
+	memcpy(record.node, node->addr, sizeof(record.node));
+	record.time = time;
+	record.key = (uint32_t)id;
+	record.value = (uint16_t)port;
+	append(record);
+}
+
+/**
+ * FUNCTION NAME: kvEvent
+ *
+ * DESCRIPTION: Record the outcome of a CRUD operation at node
+ */
+void EventLog::kvEvent(EventType type, Address *node, bool isCoordinator, bool success, int time, int transID, const string& key, const string *value) {
+	EventRecord record;
+	memset(&record, 0, sizeof(record));
+	record.key = intern(key);
+	record.value = NULL != value ? (uint32_t)value->size() : 0;
+	record.type = type;
+	record.flags = (isCoordinator ? EVENT_COORDINATOR : 0) | (success ? EVENT_SUCCESS : 0) | (NULL != value ? EVENT_VALUE : 0);
+	memcpy(record.node, node->addr, sizeof(record.node));
+	record.time = time;
+	record.transID = transID;
+	append(record);
+	if ( NULL != value ) {
+		writer.write(value->data(), value->size());
+	}
+}
+
+/**
+ * FUNCTION NAME: flush
+ *
+ * DESCRIPTION: Wait until every event recorded so far is in the file
+ */
+void EventLog::flush() {
+	writer.flush();
+}
@@ -0,0 +1,79 @@
+/**********************************
+ * FILE NAME: EventLog.h
+ *
+ * DESCRIPTION: Header file of the binary event log
+ **********************************/
+
+#ifndef _EVENTLOG_H_
+#define _EVENTLOG_H_
+
+#include "stdincludes.h"
+#include "Member.h"
+#include "LogWriter.h"
+
+#include <stdint.h>
+#include <unordered_map>
+
+/*
+ * Macros
+ */
+#define BIN_LOG "dbg.bin"
+#define EVENT_LOG_MAGIC "KVEVLOG\2"
+// EventRecord flags
+#define EVENT_COORDINATOR 0x1
+#define EVENT_SUCCESS 0x2
+#define EVENT_VALUE 0x4		// value bytes follow the record
+
+enum EventType {
+	EVENT_STRING,		// defines string id key, followed by value raw bytes
+	EVENT_NODE_ADD,		// key and value hold the id and port of the other node
+	EVENT_NODE_REMOVE,
+	EVENT_CREATE,
+	EVENT_READ,
+	EVENT_UPDATE,
+	EVENT_DELETE
+};
+
+/**
+ * STRUCT NAME: EventRecord
+ *
+ * DESCRIPTION: One fixed size record of the event log. Keys are ids of
+ * 				strings defined by an earlier EVENT_STRING record. With
+ * 				EVENT_VALUE, value is the length of the value bytes that follow
+ * 				the record.
+ */
+struct EventRecord {
+	uint8_t type;
+	uint8_t flags;
+	char node[6];
+	int32_t time;
+	int32_t transID;
+	uint32_t key;
+	uint32_t value;
+};
+
+/**
+ * CLASS NAME: EventLog
+ *
+ * DESCRIPTION: Writes the events of Log::log* as EventRecords instead of text.
+ * 				Every distinct key is written once and then referred to by id;
+ * 				values are rarely repeated, so they are written in place.
+ * 				LogDecoder turns the file back into the dbg.log lines.
+ */
+class EventLog {
+private:
+	LogWriter writer;
+	unordered_map<string, uint32_t> strings;
+	uint32_t nextString;
+	uint32_t intern(const string& s);
+	void append(const EventRecord& record);
+public:
+	EventLog();
+	bool open(const char *path);
+	bool isOpen();
+	void nodeEvent(EventType type, Address *node, Address *other, int time);
+	void kvEvent(EventType type, Address *node, bool isCoordinator, bool success, int time, int transID, const string& key, const string *value);
+	void flush();
+};
+
+#endif /* _EVENTLOG_H_ */
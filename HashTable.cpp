@@ -5,22 +5,62 @@
  **********************************/
 
 #include "HashTable.h"
+#include "MemoryEngine.h"
 
-HashTable::HashTable() {}
+// bookkeeping bytes per key: the engine's tree node, the clock slot and its index entry
+static const size_t ENTRY_OVERHEAD = sizeof(pair<const string, string>) + 4 * sizeof(void *) +
+		sizeof(ClockSlot) + sizeof(pair<const string, size_t>) + 2 * sizeof(void *);
+// strings up to this length are stored inline, longer ones on the heap
+static const size_t INLINE_STRING = string().capacity();
 
-HashTable::~HashTable() {}
+/**
+ * FUNCTION NAME: heapBytes
+ *
+ * DESCRIPTION: Heap bytes of a string holding s, ignoring allocator rounding
+ */
+static size_t heapBytes(const string& s) {
+	return s.size() > INLINE_STRING ? s.size() + 1 : 0;
+}
+
+HashTable::HashTable(): engine(new MemoryEngine()), now(0), expiredCount(0), budget(0), highWatermark(0),
+		lowWatermark(0), usedBytes(0), hand(0), evictionCount(0), evictedBytesCount(0) {}
+
+/**
+ * Constructor
+ *
+ * DESCRIPTION: The table takes ownership of engine
+ */
+HashTable::HashTable(StorageEngine *engine): engine(engine), now(0), expiredCount(0), budget(0), highWatermark(0),
+		lowWatermark(0), usedBytes(0), hand(0), evictionCount(0), evictedBytesCount(0) {}
+
+HashTable::~HashTable() {
+	delete engine;
+}
 
 /**
  * FUNCTION NAME: create
  *
  * DESCRIPTION: This function inserts they (key,value) pair into the local hash table
+ * 				The key expires at time expiresAt, or never if it is 0.
  *
  * RETURNS:
  * true on SUCCESS
  * false in FAILURE
  */
-bool HashTable::create(string key, string value) {
-	hashTable.emplace(key, value);
+bool HashTable::create(const string& key, string value, int expiresAt) {
+	if ( isExpired(key) ) {
+		purge(key);
+	}
+	if ( engine->contains(key) ) {
+		return true;
+	}
+	setExpiry(key, expiresAt);
+	size_t bytes = heapBytes(value);
+	if ( !engine->create(key, move(value)) ) {
+		return false;
+	}
+	charge(key, bytes);
+	evict();
 	return true;
 }
 
@@ -33,13 +73,16 @@ bool HashTable::create(string key, string value) {
  * string value if found
  * else it returns a NULL
  */
-string HashTable::read(string key) {
-	map<string, string>::iterator search;
-
-	search = hashTable.find(key);
-	if ( search != hashTable.end() ) {
+string HashTable::read(const string& key) {
+	string value;
+	if ( isExpired(key) ) {
+		purge(key);
+		return "";
+	}
+	if ( engine->get(key, value) ) {
 		// Value found
-		return search->second;
+		touch(key);
+		return value;
 	}
 	else {
 		// Value not found
@@ -51,23 +94,25 @@ string HashTable::read(string key) {
  * FUNCTION NAME: update
  *
  * DESCRIPTION: This function updates the given key with the updated value passed in
- * 				if the key is found
+ * 				if the key is found. Like the value, the expiry is replaced:
+ * 				an update without expiresAt makes the key persistent.
  *
  * RETURNS:
  * true on SUCCESS
  * false on FAILURE
  */
-bool HashTable::update(string key, string newValue) {
-	map<string, string>::iterator update;
-
-	if (read(key).empty()) {
-		// Key not found
+bool HashTable::update(const string& key, string newValue, int expiresAt) {
+	if ( isExpired(key) ) {
+		purge(key);
 		return false;
 	}
-	// Key found
-	//update = hashTable.at(key) = newValue;
-	hashTable.at(key) = newValue;
-	// Update successful
+	size_t bytes = heapBytes(newValue);
+	if ( !engine->update(key, move(newValue)) ) {
+		return false;
+	}
+	setExpiry(key, expiresAt);
+	charge(key, bytes);
+	evict();
 	return true;
 }
 
@@ -80,20 +125,14 @@ bool HashTable::update(string key, string newValue) {
  * true on SUCCESS
  * false on FAILURE
  */
-bool HashTable::deleteKey(string key) {
-	uint eraseCount = 0;
-
-	if (read(key).empty()) {
-		// Key not found
-		return false;
-	}
-	eraseCount = hashTable.erase(key);
-	if ( eraseCount < 1 ) {
-		// Could not erase
+bool HashTable::deleteKey(const string& key) {
+	if ( isExpired(key) ) {
+		purge(key);
 		return false;
 	}
-	// Delete was successful
-	return true;
+	expiry.erase(key);
+	release(key);
+	return engine->deleteKey(key);
 }
 
 /**
@@ -106,7 +145,7 @@ bool HashTable::deleteKey(string key) {
  * false otherwise
  */
 bool HashTable::isEmpty() {
-	return hashTable.empty();
+	return engine->size() == 0;
 }
 
 /**
@@ -118,7 +157,7 @@ bool HashTable::isEmpty() {
  * size of the table as unit
  */
 unsigned long HashTable::currentSize() {
-	return (unsigned  long)hashTable.size();
+	return engine->size();
 }
 
 /**
@@ -127,7 +166,14 @@ unsigned long HashTable::currentSize() {
  * DESCRIPTION: Clear all contents from the hash table
  */
 void HashTable::clear() {
-	hashTable.clear();
+	engine->clear();
+	expiry.clear();
+	expiryBuckets.clear();
+	clock.clear();
+	freeSlots.clear();
+	slotOf.clear();
+	usedBytes = 0;
+	hand = 0;
 }
 
 /**
@@ -138,7 +184,316 @@ void HashTable::clear() {
  * RETURNS:
  * unsigned long count (Should be always 1)
  */
-unsigned long HashTable::count(string key) {
-	return (unsigned long) hashTable.count(key);
+unsigned long HashTable::count(const string& key) {
+	return !isExpired(key) && engine->contains(key) ? 1 : 0;
+}
+
+/**
+ * FUNCTION NAME: forEach
+ *
+ * DESCRIPTION: Visit every (key, value) pair in the table that has not expired
+ */
+void HashTable::forEach(const KeyValueVisitor& visit) {
+	if ( expiry.empty() ) {
+		engine->forEach(visit);
+		return;
+	}
+	engine->forEach([&](const string& key, const string& value) {
+		if ( !isExpired(key) ) {
+			visit(key, value);
+		}
+	});
+}
+
+/**
+ * FUNCTION NAME: expiresAt
+ *
+ * DESCRIPTION: Returns the expiry time of key, 0 if it does not expire
+ */
+int HashTable::expiresAt(const string& key) {
+	unordered_map<string, int>::iterator it = expiry.find(key);
+	return it == expiry.end() ? 0 : it->second;
+}
+
+/**
+ * FUNCTION NAME: expire
+ *
+ * DESCRIPTION: Advance the clock to currentTime and remove the keys of every
+ * 				bucket that has fully elapsed. Keys of the current bucket are
+ * 				left to lazy expiry or to a later sweep.
+ */
+void HashTable::expire(int currentTime) {
+	now = currentTime;
+	while ( !expiryBuckets.empty() && (expiryBuckets.begin()->first + 1) * TTL_BUCKET_TICKS <= now + 1 ) {
+		vector<string>& keys = expiryBuckets.begin()->second;
+		for ( size_t i = 0; i < keys.size(); i++ ) {
+			// skip stale entries, whose key has since been given another expiry
+			if ( isExpired(keys[i]) ) {
+				purge(keys[i]);
+			}
+		}
+		expiryBuckets.erase(expiryBuckets.begin());
+	}
+}
+
+/**
+ * FUNCTION NAME: expired
+ *
+ * DESCRIPTION: Number of keys removed because they expired
+ */
+unsigned long HashTable::expired() {
+	return expiredCount;
 }
 
+/**
+ * FUNCTION NAME: isExpired
+ *
+ * DESCRIPTION: Returns if key has an expiry time that has passed
+ */
+bool HashTable::isExpired(const string& key) {
+	if ( expiry.empty() ) {
+		return false;
+	}
+	unordered_map<string, int>::iterator it = expiry.find(key);
+	return it != expiry.end() && it->second <= now;
+}
+
+/**
+ * FUNCTION NAME: setExpiry
+ *
+ * DESCRIPTION: Record when key expires, 0 meaning never
+ */
+void HashTable::setExpiry(const string& key, int expiresAt) {
+	if ( 0 == expiresAt ) {
+		expiry.erase(key);
+		return;
+	}
+	expiry[key] = expiresAt;
+	expiryBuckets[expiresAt / TTL_BUCKET_TICKS].push_back(key);
+}
+
+/**
+ * FUNCTION NAME: purge
+ *
+ * DESCRIPTION: Remove an expired key
+ */
+void HashTable::purge(const string& key) {
+	expiry.erase(key);
+	release(key);
+	engine->deleteKey(key);
+	expiredCount++;
+}
+
+/**
+ * FUNCTION NAME: setMemoryBudget
+ *
+ * DESCRIPTION: Limit the table to bytes, 0 for no limit. Eviction starts once usage
+ * 				passes highPercent of the budget and stops at lowPercent.
+ */
+void HashTable::setMemoryBudget(size_t bytes, int highPercent, int lowPercent) {
+	budget = bytes;
+	highWatermark = bytes / 100 * highPercent;
+	lowWatermark = bytes / 100 * min(lowPercent, highPercent);
+	recharge();
+	evict();
+}
+
+/**
+ * FUNCTION NAME: memoryUsed
+ *
+ * DESCRIPTION: Bytes charged to the keys in the table, 0 when there is no budget
+ */
+size_t HashTable::memoryUsed() {
+	return usedBytes;
+}
+
+/**
+ * FUNCTION NAME: evictions
+ *
+ * DESCRIPTION: Number of keys evicted to stay within the memory budget
+ */
+unsigned long HashTable::evictions() {
+	return evictionCount;
+}
+
+/**
+ * FUNCTION NAME: evictedBytes
+ *
+ * DESCRIPTION: Bytes freed by evictions
+ */
+unsigned long long HashTable::evictedBytes() {
+	return evictedBytesCount;
+}
+
+/**
+ * FUNCTION NAME: charge
+ *
+ * DESCRIPTION: Account for key now holding a value with valueBytes on the heap. The key
+ * 				is kept on the clock with its reference bit set, so a fresh write is not
+ * 				the next victim.
+ */
+void HashTable::charge(const string& key, size_t valueBytes) {
+	if ( 0 == budget ) {
+		return;
+	}
+	// the key is held by the engine, the clock slot and the slot index; inline
+	// strings are already part of ENTRY_OVERHEAD
+	size_t bytes = ENTRY_OVERHEAD + 3 * heapBytes(key) + valueBytes;
+	unordered_map<string, size_t>::iterator it = slotOf.find(key);
+	if ( it == slotOf.end() ) {
+		size_t slot;
+		if ( freeSlots.empty() ) {
+			slot = clock.size();
+			clock.push_back(ClockSlot());
+		}
+		else {
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		it = slotOf.insert(make_pair(key, slot)).first;
+		clock[slot].key = key;
+		clock[slot].used = true;
+		clock[slot].bytes = 0;
+	}
+	ClockSlot& entry = clock[it->second];
+	usedBytes = usedBytes - entry.bytes + bytes;
+	entry.bytes = bytes;
+	entry.referenced = true;
+}
+
+/**
+ * FUNCTION NAME: release
+ *
+ * DESCRIPTION: Stop accounting for key
+ */
+void HashTable::release(const string& key) {
+	if ( 0 == budget ) {
+		return;
+	}
+	unordered_map<string, size_t>::iterator it = slotOf.find(key);
+	if ( it == slotOf.end() ) {
+		return;
+	}
+	ClockSlot& entry = clock[it->second];
+	usedBytes -= entry.bytes;
+	entry = ClockSlot();
+	freeSlots.push_back(it->second);
+	slotOf.erase(it);
+}
+
+/**
+ * FUNCTION NAME: touch
+ *
+ * DESCRIPTION: Set the reference bit of key
+ */
+void HashTable::touch(const string& key) {
+	if ( 0 == budget ) {
+		return;
+	}
+	unordered_map<string, size_t>::iterator it = slotOf.find(key);
+	if ( it != slotOf.end() ) {
+		clock[it->second].referenced = true;
+	}
+}
+
+/**
+ * FUNCTION NAME: evict
+ *
+ * DESCRIPTION: If usage passed the high watermark, sweep the clock hand and evict
+ * 				unreferenced keys until usage is down to the low watermark. Every
+ * 				step either clears a reference bit or frees a key, so the work is
+ * 				amortized over the writes that filled the table.
+ */
+void HashTable::evict() {
+	if ( 0 == budget || usedBytes <= highWatermark ) {
+		return;
+	}
+	while ( usedBytes > lowWatermark && !slotOf.empty() ) {
+		if ( hand >= clock.size() ) {
+			hand = 0;
+		}
+		ClockSlot& entry = clock[hand++];
+		if ( !entry.used ) {
+			continue;
+		}
+		if ( entry.referenced ) {
+			entry.referenced = false;
+			continue;
+		}
+		string key = entry.key;
+		evictionCount++;
+		evictedBytesCount += entry.bytes;
+		expiry.erase(key);
+		release(key);
+		engine->deleteKey(key);
+	}
+}
+
+/**
+ * FUNCTION NAME: recharge
+ *
+ * DESCRIPTION: Rebuild the accounting from the contents of the engine
+ */
+void HashTable::recharge() {
+	clock.clear();
+	freeSlots.clear();
+	slotOf.clear();
+	usedBytes = 0;
+	hand = 0;
+	if ( 0 == budget ) {
+		return;
+	}
+	engine->forEach([&](const string& key, const string& value) {
+		charge(key, heapBytes(value));
+	});
+}
+
+/**
+ * FUNCTION NAME: maintain
+ *
+ * DESCRIPTION: Let the engine pick up finished background work (snapshot writes,
+ * 				restore warm-up, flushes, compactions). Called once per tick.
+ */
+void HashTable::maintain() {
+	engine->maintain();
+}
+
+/**
+ * FUNCTION NAME: snapshot
+ *
+ * DESCRIPTION: Start a point-in-time snapshot of the table to path
+ *
+ * RETURNS:
+ * true if the snapshot was started
+ * false if the engine does not support snapshots or one is still in progress
+ */
+bool HashTable::snapshot(const string& path) {
+	return engine->snapshot(path);
+}
+
+/**
+ * FUNCTION NAME: snapshotFailures
+ *
+ * DESCRIPTION: Snapshots started by snapshot() that could not be written
+ */
+unsigned long HashTable::snapshotFailures() {
+	return engine->snapshotFailures();
+}
+
+/**
+ * FUNCTION NAME: restore
+ *
+ * DESCRIPTION: Replace the contents of the table with the snapshot at path
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool HashTable::restore(const string& path) {
+	if ( !engine->restore(path) ) {
+		return false;
+	}
+	recharge();
+	evict();
+	return true;
+}
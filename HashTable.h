@@ -13,26 +13,103 @@
 #include "stdincludes.h"
 #include "common.h"
 #include "Entry.h"
+#include "StorageEngine.h"
+
+#include <unordered_map>
+
+/*
+ * Macros
+ */
+// width, in ticks, of the buckets the expiry sweep works through
+#define TTL_BUCKET_TICKS 8
+
+/**
+ * STRUCT NAME: ClockSlot
+ *
+ * DESCRIPTION: One key on the eviction clock, with the bytes it is charged
+ */
+struct ClockSlot {
+	string key;
+	size_t bytes;
+	bool referenced;
+	bool used;
+	ClockSlot(): bytes(0), referenced(false), used(false) {}
+};
 
 /**
  * CLASS NAME: HashTable
  *
- * DESCRIPTION: This class is a wrapper to the map provided by C++ STL.
+ * DESCRIPTION: This class is the node-local key value table. The pairs
+ * 				themselves live in a StorageEngine, a MemoryEngine unless
+ * 				another engine is passed in.
+ *
+ * 				Keys may carry an expiry time. Expired keys are never visible:
+ * 				reads drop them lazily, and expire() sweeps the rest bucket by
+ * 				bucket, so a sweep only touches keys that are due.
  *
+ * 				With a memory budget set, every key is charged its key, value
+ * 				and bookkeeping bytes. Once usage passes the high watermark,
+ * 				keys are evicted with the CLOCK policy until usage is back at
+ * 				the low watermark. Reads set the reference bit of a key, which
+ * 				gives it one more turn of the clock.
  */
 class HashTable {
+private:
+	StorageEngine *engine;
+	// current time, as of the last call to expire()
+	int now;
+	// expiry time of every key that has one
+	unordered_map<string, int> expiry;
+	// keys by expiry bucket; entries go stale when a key's expiry changes
+	map<int, vector<string> > expiryBuckets;
+	unsigned long expiredCount;
+	// memory budget in bytes, 0 when unlimited, and its watermarks
+	size_t budget;
+	size_t highWatermark;
+	size_t lowWatermark;
+	size_t usedBytes;
+	// eviction clock; slots of removed keys are reused through freeSlots
+	vector<ClockSlot> clock;
+	vector<size_t> freeSlots;
+	unordered_map<string, size_t> slotOf;
+	size_t hand;
+	unsigned long evictionCount;
+	unsigned long long evictedBytesCount;
+	bool isExpired(const string& key);
+	void setExpiry(const string& key, int expiresAt);
+	void purge(const string& key);
+	void charge(const string& key, size_t valueBytes);
+	void release(const string& key);
+	void touch(const string& key);
+	void evict();
+	void recharge();
 public:
-	map<string, string> hashTable;
-//public:
 	HashTable();
-	bool create(string key, string value);
-	string read(string key);
-	bool update(string key, string newValue);
-	bool deleteKey(string key);
+	HashTable(StorageEngine *engine);
+	// values are taken by value and moved into the engine
+	bool create(const string& key, string value, int expiresAt = 0);
+	string read(const string& key);
+	bool update(const string& key, string newValue, int expiresAt = 0);
+	bool deleteKey(const string& key);
 	bool isEmpty();
 	unsigned long currentSize();
 	void clear();
-	unsigned long count(string key);
+	unsigned long count(const string& key);
+	void forEach(const KeyValueVisitor& visit);
+	// expiry
+	int expiresAt(const string& key);
+	void expire(int currentTime);
+	unsigned long expired();
+	// memory budget
+	void setMemoryBudget(size_t bytes, int highPercent, int lowPercent);
+	size_t memoryUsed();
+	unsigned long evictions();
+	unsigned long long evictedBytes();
+	// background work and snapshots, forwarded to the engine
+	void maintain();
+	bool snapshot(const string& path);
+	bool restore(const string& path);
+	unsigned long snapshotFailures();
 	virtual ~HashTable();
 };
 
@@ -0,0 +1,151 @@
+/**********************************
+ * FILE NAME: Histogram.cpp
+ *
+ * DESCRIPTION: Latency histogram definition
+ **********************************/
+
+#include "Histogram.h"
+
+static const uint64_t SUB_BUCKETS = 1 << HISTOGRAM_SUB_BITS;
+static const uint64_t HALF_BUCKETS = SUB_BUCKETS / 2;
+
+/**
+ * Constructor
+ */
+Histogram::Histogram() {
+	reset();
+}
+
+/**
+ * FUNCTION NAME: indexOf
+ *
+ * DESCRIPTION: Bucket of value. The first SUB_BUCKETS buckets hold one value each;
+ * 				after that every power of two gets HALF_BUCKETS equal buckets.
+ */
+size_t Histogram::indexOf(uint64_t value) {
+	if ( value < SUB_BUCKETS ) {
+		return value;
+	}
+	int shift = 63 - __builtin_clzll(value) - (HISTOGRAM_SUB_BITS - 1);
+	return SUB_BUCKETS + (shift - 1) * HALF_BUCKETS + ((value >> shift) - HALF_BUCKETS);
+}
+
+/**
+ * FUNCTION NAME: highestEquivalent
+ *
+ * DESCRIPTION: Largest value that falls into bucket index
+ */
+uint64_t Histogram::highestEquivalent(size_t index) {
+	if ( index < SUB_BUCKETS ) {
+		return index;
+	}
+	int shift = (index - SUB_BUCKETS) / HALF_BUCKETS + 1;
+	uint64_t offset = (index - SUB_BUCKETS) % HALF_BUCKETS;
+	return ((offset + HALF_BUCKETS) << shift) + (((uint64_t)1 << shift) - 1);
+}
+
+/**
+ * FUNCTION NAME: record
+ *
+ * DESCRIPTION: Count value count times
+ */
+void Histogram::record(uint64_t value, uint64_t count) {
+	size_t index = indexOf(value);
+	if ( index >= counts.size() ) {
+		counts.resize(index + 1, 0);
+	}
+	counts[index] += count;
+	total += count;
+	sum += (double)value * count;
+	minimum = std::min(minimum, value);
+	maximum = std::max(maximum, value);
+}
+
+/**
+ * FUNCTION NAME: merge
+ *
+ * DESCRIPTION: Add the counts of other to this histogram
+ */
+void Histogram::merge(const Histogram& other) {
+	if ( other.counts.size() > counts.size() ) {
+		counts.resize(other.counts.size(), 0);
+	}
+	for ( size_t i = 0; i < other.counts.size(); i++ ) {
+		counts[i] += other.counts[i];
+	}
+	total += other.total;
+	sum += other.sum;
+	minimum = std::min(minimum, other.minimum);
+	maximum = std::max(maximum, other.maximum);
+}
+
+/**
+ * FUNCTION NAME: reset
+ *
+ * DESCRIPTION: Forget every recorded value
+ */
+void Histogram::reset() {
+	counts.clear();
+	total = 0;
+	minimum = UINT64_MAX;
+	maximum = 0;
+	sum = 0;
+}
+
+/**
+ * FUNCTION NAME: count
+ *
+ * DESCRIPTION: Number of recorded values
+ */
+uint64_t Histogram::count() const {
+	return total;
+}
+
+/**
+ * FUNCTION NAME: min
+ *
+ * DESCRIPTION: Smallest recorded value, 0 if there is none
+ */
+uint64_t Histogram::min() const {
+	return total > 0 ? minimum : 0;
+}
+
+/**
+ * FUNCTION NAME: max
+ *
+ * DESCRIPTION: Largest recorded value
+ */
+uint64_t Histogram::max() const {
+	return maximum;
+}
+
+/**
+ * FUNCTION NAME: mean
+ *
+ * DESCRIPTION: Average of the recorded values
+ */
+double Histogram::mean() const {
+	return total > 0 ? sum / total : 0;
+}
+
+/**
+ * FUNCTION NAME: percentile
+ *
+ * DESCRIPTION: Value at or below which p percent of the recorded values fall,
+ * 				rounded up to the end of its bucket but never above max()
+ */
+uint64_t Histogram::percentile(double p) const {
+	if ( 0 == total ) {
+		return 0;
+	}
+	uint64_t rank = (uint64_t)ceil(p / 100.0 * total);
+	rank = std::max(rank, (uint64_t)1);
+	uint64_t seen = 0;
+	for ( size_t i = 0; i < counts.size(); i++ ) {
+		seen += counts[i];
+		if ( seen >= rank ) {
+			return std::min(highestEquivalent(i), maximum);
+		}
+	}
+	return maximum;
+}
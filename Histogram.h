@@ -0,0 +1,50 @@
+/**********************************
+ * FILE NAME: Histogram.h
+ *
+ * DESCRIPTION: Header file of the latency histogram
+ **********************************/
+
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+#include "stdincludes.h"
+
+#include <stdint.h>
+
+/*
+ * Macros
+ */
+// values below 2^HISTOGRAM_SUB_BITS are counted exactly; above, a value shares
+// its bucket with values less than 1/2^(HISTOGRAM_SUB_BITS-1) away
+#define HISTOGRAM_SUB_BITS 7
+
+/**
+ * CLASS NAME: Histogram
+ *
+ * DESCRIPTION: HDR style histogram of non-negative integer values. Buckets are
+ * 				linear within each power of two, so percentiles keep a fixed
+ * 				relative precision over the whole range, and recording is a
+ * 				few shifts and one increment. Histograms merge by adding counts.
+ */
+class Histogram {
+private:
+	vector<uint64_t> counts;
+	uint64_t total;
+	uint64_t minimum;
+	uint64_t maximum;
+	double sum;
+	static size_t indexOf(uint64_t value);
+	static uint64_t highestEquivalent(size_t index);
+public:
+	Histogram();
+	void record(uint64_t value, uint64_t count = 1);
+	void merge(const Histogram& other);
+	void reset();
+	uint64_t count() const;
+	uint64_t min() const;
+	uint64_t max() const;
+	double mean() const;
+	uint64_t percentile(double p) const;
+};
+
+#endif /* HISTOGRAM_H_ */
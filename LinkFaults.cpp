@@ -0,0 +1,211 @@
+/**********************************
+ * FILE NAME: LinkFaults.cpp
+ *
+ * DESCRIPTION: Scheduled EmulNet link faults definition
+ **********************************/
+
+#include "LinkFaults.h"
+
+/**
+ * Constructor
+ */
+LinkFaults::LinkFaults(): nodes(0), states(1), builtAt(-1), nextChange(INT_MAX) {}
+
+/**
+ * FUNCTION NAME: configure
+ *
+ * DESCRIPTION: Read the scenario of the test case. A malformed rule ends the run.
+ */
+void LinkFaults::configure(Params *par) {
+	nodes = par->EN_GPSZ + 1;
+	rules.clear();
+	states.assign(1, LinkState());
+	links.clear();
+	for ( size_t i = 0; i < par->PARTITIONS.size(); i++ ) {
+		if ( !parseRule(par->PARTITIONS[i].c_str(), true) ) {
+			printf("Malformed PARTITION: %s\n", par->PARTITIONS[i].c_str());
+			exit(1);
+		}
+	}
+	for ( size_t i = 0; i < par->LINK_FAULTS.size(); i++ ) {
+		if ( !parseRule(par->LINK_FAULTS[i].c_str(), false) ) {
+			printf("Malformed LINK_FAULT: %s\n", par->LINK_FAULTS[i].c_str());
+			exit(1);
+		}
+	}
+	builtAt = -1;
+	nextChange = rules.empty() ? INT_MAX : INT_MIN;
+}
+
+/**
+ * FUNCTION NAME: parseNodes
+ *
+ * DESCRIPTION: Node ids of a "*" or "1-3,7" list
+ */
+bool LinkFaults::parseNodes(const char *spec, vector<int>& ids) {
+	ids.clear();
+	if ( 0 == strcmp(spec, "*") ) {
+		for ( int id = 1; id < nodes; id++ ) {
+			ids.push_back(id);
+		}
+		return true;
+	}
+	while ( *spec ) {
+		char *end;
+		long first = strtol(spec, &end, 10);
+		long last = first;
+		if ( end == spec ) {
+			return false;
+		}
+		if ( '-' == *end ) {
+			spec = end + 1;
+			last = strtol(spec, &end, 10);
+			if ( end == spec ) {
+				return false;
+			}
+		}
+		if ( first < 1 || last >= nodes || first > last ) {
+			return false;
+		}
+		for ( long id = first; id <= last; id++ ) {
+			ids.push_back((int)id);
+		}
+		if ( ',' == *end ) {
+			end++;
+		}
+		else if ( *end ) {
+			return false;
+		}
+		spec = end;
+	}
+	return !ids.empty();
+}
+
+/**
+ * FUNCTION NAME: parseRule
+ *
+ * DESCRIPTION: Add the rule of one PARTITION or LINK_FAULT value
+ */
+bool LinkFaults::parseRule(const char *spec, bool partition) {
+	LinkRule rule;
+	char groups[128];
+	int consumed = 0;
+	rule.partition = partition;
+	if ( 3 != sscanf(spec, "%d-%d:%127[^:]%n", &rule.start, &rule.end, groups, &consumed) || rule.start >= rule.end ) {
+		return false;
+	}
+	spec += consumed;
+
+	char *save = NULL;
+	for ( char *group = strtok_r(groups, partition ? "/" : ">", &save); NULL != group; group = strtok_r(NULL, partition ? "/" : ">", &save) ) {
+		rule.groups.push_back(vector<int>());
+		if ( !parseNodes(group, rule.groups.back()) ) {
+			return false;
+		}
+	}
+
+	if ( partition ) {
+		rule.state = LinkState(1, 0);
+		if ( rule.groups.size() < 2 || *spec ) {
+			return false;
+		}
+	}
+	else {
+		if ( rule.groups.size() != 2 || sscanf(spec, ":%lf:%d", &rule.state.drop, &rule.state.delay) < 1 ) {
+			return false;
+		}
+		if ( rule.state.drop < 0 || rule.state.drop > 1 || rule.state.delay < 0 ) {
+			return false;
+		}
+	}
+	rules.push_back(rule);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: stateIndex
+ *
+ * DESCRIPTION: Index of state in states, adding it if it is new
+ */
+uint16_t LinkFaults::stateIndex(const LinkState& state) {
+	for ( size_t i = 0; i < states.size(); i++ ) {
+		if ( states[i].drop == state.drop && states[i].delay == state.delay ) {
+			return (uint16_t)i;
+		}
+	}
+	assert(states.size() < UINT16_MAX);
+	states.push_back(state);
+	return (uint16_t)(states.size() - 1);
+}
+
+/**
+ * FUNCTION NAME: apply
+ *
+ * DESCRIPTION: Compound rule into the links it covers. Every link in the same state
+ * 				moves to the same new state, so each transition is worked out once.
+ */
+void LinkFaults::apply(const LinkRule& rule) {
+	vector<int> transition;
+	for ( size_t from = 0; from < rule.groups.size(); from++ ) {
+		for ( size_t to = 0; to < rule.groups.size(); to++ ) {
+			if ( rule.partition ? from == to : (from != 0 || to != 1) ) {
+				continue;
+			}
+			for ( size_t i = 0; i < rule.groups[from].size(); i++ ) {
+				uint16_t *row = &links[rule.groups[from][i] * nodes];
+				for ( size_t j = 0; j < rule.groups[to].size(); j++ ) {
+					uint16_t &link = row[rule.groups[to][j]];
+					if ( link >= transition.size() ) {
+						transition.resize(link + 1, -1);
+					}
+					if ( transition[link] < 0 ) {
+						const LinkState &old = states[link];
+						transition[link] = stateIndex(LinkState(1 - (1 - old.drop) * (1 - rule.state.drop), old.delay + rule.state.delay));
+					}
+					link = transition[link];
+				}
+			}
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: rebuild
+ *
+ * DESCRIPTION: Recompute the matrix for the rules active at time
+ */
+void LinkFaults::rebuild(int time) {
+	states.assign(1, LinkState());
+	links.clear();
+	nextChange = INT_MAX;
+	for ( size_t r = 0; r < rules.size(); r++ ) {
+		if ( rules[r].start > time ) {
+			nextChange = min(nextChange, rules[r].start);
+			continue;
+		}
+		if ( rules[r].end <= time ) {
+			continue;
+		}
+		nextChange = min(nextChange, rules[r].end);
+		if ( links.empty() ) {
+			links.assign(nodes * nodes, 0);
+		}
+		apply(rules[r]);
+	}
+	builtAt = time;
+}
+
+/**
+ * FUNCTION NAME: at
+ *
+ * DESCRIPTION: State of the link from src to dst at time
+ */
+const LinkState& LinkFaults::at(int time, int src, int dst) {
+	if ( time >= nextChange || time < builtAt ) {
+		rebuild(time);
+	}
+	if ( links.empty() || src >= nodes || dst >= nodes ) {
+		return states[0];
+	}
+	return states[links[src * nodes + dst]];
+}
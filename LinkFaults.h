@@ -0,0 +1,82 @@
+/**********************************
+ * FILE NAME: LinkFaults.h
+ *
+ * DESCRIPTION: Header file of the scheduled EmulNet link faults
+ **********************************/
+
+#ifndef LINKFAULTS_H_
+#define LINKFAULTS_H_
+
+#include "stdincludes.h"
+#include "Params.h"
+
+#include <stdint.h>
+#include <limits.h>
+
+/**
+ * STRUCT NAME: LinkState
+ *
+ * DESCRIPTION: What a link does to the messages sent over it: drops each one
+ * 				with probability drop and delays the rest by delay ticks
+ */
+struct LinkState {
+	double drop;
+	int delay;
+	LinkState(double drop = 0, int delay = 0): drop(drop), delay(delay) {}
+};
+
+/**
+ * STRUCT NAME: LinkRule
+ *
+ * DESCRIPTION: One fault of the scenario, active for start <= time < end.
+ * 				A partition cuts every link between nodes of different groups,
+ * 				both ways; a link fault applies state to every link from a node
+ * 				of groups[0] to a node of groups[1].
+ */
+struct LinkRule {
+	int start;
+	int end;
+	bool partition;
+	vector<vector<int> > groups;
+	LinkState state;
+};
+
+/**
+ * CLASS NAME: LinkFaults
+ *
+ * DESCRIPTION: Partitions, one-way drops and degraded links scheduled from the
+ * 				PARTITION and LINK_FAULT lines of the test case:
+ *
+ * 				PARTITION: <start>-<end>:<nodes>/<nodes>[/<nodes>...]
+ * 				LINK_FAULT: <start>-<end>:<nodes>><nodes>:<drop>[:<delay>]
+ *
+ * 				<nodes> is * or a comma separated list of node ids and id
+ * 				ranges, e.g. 1-3,7. Nodes a partition does not list keep all
+ * 				their links. Faults on the same link compound.
+ *
+ * 				The state of every link is kept in a node x node matrix of
+ * 				indices into the distinct states, rebuilt only when a rule
+ * 				starts or ends, so looking a link up is O(1).
+ */
+class LinkFaults {
+private:
+	int nodes;
+	vector<LinkRule> rules;
+	// states[0] is the healthy link
+	vector<LinkState> states;
+	// [src * nodes + dst], empty while no rule is active
+	vector<uint16_t> links;
+	int builtAt;
+	int nextChange;
+	bool parseNodes(const char *spec, vector<int>& ids);
+	bool parseRule(const char *spec, bool partition);
+	uint16_t stateIndex(const LinkState& state);
+	void apply(const LinkRule& rule);
+	void rebuild(int time);
+public:
+	LinkFaults();
+	void configure(Params *par);
+	const LinkState& at(int time, int src, int dst);
+};
+
+#endif /* LINKFAULTS_H_ */
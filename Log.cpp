@@ -1,11 +1,18 @@
 /**********************************
- * FILE NAME: Log.h
+ * FILE NAME: Log.cpp
  *
  * DESCRIPTION: Log class definition
  **********************************/
 
 #include "Log.h"
 
+/*
+ * Log files, shared by every Log object and closed at exit
+ */
+static LogWriter dbgWriter;
+static LogWriter statsWriter;
+static EventLog eventLog;
+
 /**
  * Constructor
  */
@@ -33,47 +40,35 @@ Log& Log::operator = (const Log& anotherLog) {
 
 /**
  * Destructor
+ *
+ * DESCRIPTION: The log files stay open for other Log objects and are closed at exit,
+ * 				but everything this one logged is written out before it goes away
  */
-Log::~Log() {}
+Log::~Log() {
+	flush();
+}
 
 /**
  * FUNCTION NAME: LOG
  *
  * DESCRIPTION: Print out to file dbg.log, along with Address of node.
+ * 				The line is formatted here and handed to a LogWriter, which
+ * 				writes it to the file from its own thread.
  */
 void Log::LOG(Address *addr, const char * str, ...) {
 
-	static FILE *fp;
-	static FILE *fp2;
 	va_list vararglist;
-	static char buffer[30000];
-	static int numwrites;
-	static char stdstring[30];
-	static char stdstring2[40];
-	static char stdstring3[40]; 
-	static int dbg_opened=0;
-
-	if(dbg_opened != 639){
-		numwrites=0;
-
-		stdstring2[0]=0;
-
-		strcpy(stdstring3, stdstring2);
-
-		strcat(stdstring2, DBG_LOG);
-		strcat(stdstring3, STATS_LOG);
-
-		fp = fopen(stdstring2, "w");
-		fp2 = fopen(stdstring3, "w");
+	char buffer[LOG_LINE_MAX];
+	char line[LOG_LINE_MAX + 64];
+	int length;
 
-		dbg_opened=639;
+	if ( !dbgWriter.isOpen() ) {
+		dbgWriter.open(DBG_LOG);
+		statsWriter.open(STATS_LOG);
 	}
-	else 
-
-	sprintf(stdstring, "%d.%d.%d.%d:%d ", addr->addr[0], addr->addr[1], addr->addr[2], addr->addr[3], *(short *)&addr->addr[4]);
 
 	va_start(vararglist, str);
-	vsprintf(buffer, str, vararglist);
+	vsnprintf(buffer, sizeof(buffer), str, vararglist);
 	va_end(vararglist);
 
 	if (!firstTime) {
@@ -83,29 +78,49 @@ void Log::LOG(Address *addr, const char * str, ...) {
 		for ( int i = 0; i < len; i++ ) {
 			magicNumber += (int)magic.at(i);
 		}
-		fprintf(fp, "%x\n", magicNumber);
+		length = snprintf(line, sizeof(line), "%x\n", magicNumber);
+		dbgWriter.write(line, length);
 		firstTime = true;
 	}
 
-	if(memcmp(buffer, "#STATSLOG#", 10)==0){
-		fprintf(fp2, "\n %s", stdstring);
-		fprintf(fp2, "[%d] ", par->getcurrtime());
+	length = snprintf(line, sizeof(line), "\n %d.%d.%d.%d:%d [%d] %s", addr->addr[0], addr->addr[1], addr->addr[2], addr->addr[3],
+			*(short *)&addr->addr[4], par->getcurrtime(), buffer);
+	length = min(length, (int)sizeof(line) - 1);
 
-		fprintf(fp2, buffer);
+	if(memcmp(buffer, "#STATSLOG#", 10)==0){
+		statsWriter.write(line, length);
 	}
 	else{
-		fprintf(fp, "\n %s", stdstring);
-		fprintf(fp, "[%d] ", par->getcurrtime());
-		fprintf(fp, buffer);
-
+		dbgWriter.write(line, length);
 	}
 
-	if(++numwrites >= MAXWRITES){
-		fflush(fp);
-		fflush(fp2);
-		numwrites=0;
-	}
+}
 
+/**
+ * FUNCTION NAME: flush
+ *
+ * DESCRIPTION: Wait until every line logged so far is in the log files
+ */
+void Log::flush() {
+	dbgWriter.flush();
+	statsWriter.flush();
+	eventLog.flush();
+}
+
+/**
+ * FUNCTION NAME: useEventLog
+ *
+ * DESCRIPTION: Returns if the log* calls go to the binary event log instead of
+ * 				dbg.log, opening it on first use
+ */
+bool Log::useEventLog() {
+	if ( !par->EVENT_LOG ) {
+		return false;
+	}
+	if ( !eventLog.isOpen() ) {
+		eventLog.open(BIN_LOG);
+	}
+	return true;
 }
 
 /**
@@ -114,9 +129,11 @@ void Log::LOG(Address *addr, const char * str, ...) {
  * DESCRIPTION: To Log a node add
  */
 void Log::logNodeAdd(Address *thisNode, Address *addedAddr) {
-	static char stdstring[100];
-	sprintf(stdstring, "Node %d.%d.%d.%d:%d joined at time %d", addedAddr->addr[0], addedAddr->addr[1], addedAddr->addr[2], addedAddr->addr[3], *(short *)&addedAddr->addr[4], par->getcurrtime());
-    LOG(thisNode, stdstring);
+	if ( useEventLog() ) {
+		eventLog.nodeEvent(EVENT_NODE_ADD, thisNode, addedAddr, par->getcurrtime());
+		return;
+	}
+	LOG(thisNode, "Node %d.%d.%d.%d:%d joined at time %d", addedAddr->addr[0], addedAddr->addr[1], addedAddr->addr[2], addedAddr->addr[3], *(short *)&addedAddr->addr[4], par->getcurrtime());
 }
 
 /**
@@ -125,9 +142,11 @@ void Log::logNodeAdd(Address *thisNode, Address *addedAddr) {
  * DESCRIPTION: To log a node remove
  */
 void Log::logNodeRemove(Address *thisNode, Address *removedAddr) {
-	static char stdstring[30];
-	sprintf(stdstring, "Node %d.%d.%d.%d:%d removed at time %d", removedAddr->addr[0], removedAddr->addr[1], removedAddr->addr[2], removedAddr->addr[3], *(short *)&removedAddr->addr[4], par->getcurrtime());
-    LOG(thisNode, stdstring);
+	if ( useEventLog() ) {
+		eventLog.nodeEvent(EVENT_NODE_REMOVE, thisNode, removedAddr, par->getcurrtime());
+		return;
+	}
+	LOG(thisNode, "Node %d.%d.%d.%d:%d removed at time %d", removedAddr->addr[0], removedAddr->addr[1], removedAddr->addr[2], removedAddr->addr[3], *(short *)&removedAddr->addr[4], par->getcurrtime());
 }
 
 /**
@@ -136,14 +155,16 @@ void Log::logNodeRemove(Address *thisNode, Address *removedAddr) {
  * DESCRTION: Call this function after successfully create a key value pair
  */
 void Log::logCreateSuccess(Address * address, bool isCoordinator, int transID, string key, string value){
-	static char stdstring[100];
+	if ( useEventLog() ) {
+		eventLog.kvEvent(EVENT_CREATE, address, isCoordinator, true, par->getcurrtime(), transID, key, &value);
+		return;
+	}
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: create success at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), value.c_str());
-    LOG(address, stdstring);
+	LOG(address, "%s: create success at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), value.c_str());
 }
 
 /**
@@ -152,14 +173,16 @@ void Log::logCreateSuccess(Address * address, bool isCoordinator, int transID, s
  * DESCRIPTION: Call this function after successfully reading a key
  */
 void Log::logReadSuccess(Address * address, bool isCoordinator, int transID, string key, string value){
-    static char stdstring[100];
+	if ( useEventLog() ) {
+		eventLog.kvEvent(EVENT_READ, address, isCoordinator, true, par->getcurrtime(), transID, key, &value);
+		return;
+	}
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: read success at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), value.c_str());
-    LOG(address, stdstring);
+	LOG(address, "%s: read success at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), value.c_str());
 }
 
 /**
@@ -168,14 +191,16 @@ void Log::logReadSuccess(Address * address, bool isCoordinator, int transID, str
  * DESCRIPTION: Call this function after successfully updating a key
  */
 void Log::logUpdateSuccess(Address * address, bool isCoordinator, int transID, string key, string newValue){
-    static char stdstring[100];
+	if ( useEventLog() ) {
+		eventLog.kvEvent(EVENT_UPDATE, address, isCoordinator, true, par->getcurrtime(), transID, key, &newValue);
+		return;
+	}
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: update success at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), newValue.c_str());
-    LOG(address, stdstring);
+	LOG(address, "%s: update success at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), newValue.c_str());
 }
 
 /**
@@ -184,14 +209,16 @@ void Log::logUpdateSuccess(Address * address, bool isCoordinator, int transID, s
  * DESCRIPTION: Call this function after successfully deleting a key
  */
 void Log::logDeleteSuccess(Address * address, bool isCoordinator, int transID, string key){
-    static char stdstring[100];
+	if ( useEventLog() ) {
+		eventLog.kvEvent(EVENT_DELETE, address, isCoordinator, true, par->getcurrtime(), transID, key, NULL);
+		return;
+	}
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: delete success at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
-    LOG(address, stdstring);
+	LOG(address, "%s: delete success at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
 }
 
 /**
@@ -200,14 +227,16 @@ void Log::logDeleteSuccess(Address * address, bool isCoordinator, int transID, s
  * DESCRIPTION: Call this function if CREATE failed
  */
 void Log::logCreateFail(Address * address, bool isCoordinator, int transID, string key, string value){
-	static char stdstring[100];
+	if ( useEventLog() ) {
+		eventLog.kvEvent(EVENT_CREATE, address, isCoordinator, false, par->getcurrtime(), transID, key, &value);
+		return;
+	}
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: create fail at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), value.c_str());
-    LOG(address, stdstring);
+	LOG(address, "%s: create fail at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), value.c_str());
 }
 
 
@@ -217,14 +246,16 @@ void Log::logCreateFail(Address * address, bool isCoordinator, int transID, stri
  * DESCRIPTION: Call this function if READ failed
  */
 void Log::logReadFail(Address * address, bool isCoordinator, int transID, string key){
-    static char stdstring[100];
+	if ( useEventLog() ) {
+		eventLog.kvEvent(EVENT_READ, address, isCoordinator, false, par->getcurrtime(), transID, key, NULL);
+		return;
+	}
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: read fail at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
-    LOG(address, stdstring);
+	LOG(address, "%s: read fail at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
 }
 
 /**
@@ -233,14 +264,16 @@ void Log::logReadFail(Address * address, bool isCoordinator, int transID, string
  * DESCRIPTION: Call this function if UPDATE failed
  */
 void Log::logUpdateFail(Address * address, bool isCoordinator, int transID, string key, string newValue){
-    static char stdstring[100];
+	if ( useEventLog() ) {
+		eventLog.kvEvent(EVENT_UPDATE, address, isCoordinator, false, par->getcurrtime(), transID, key, &newValue);
+		return;
+	}
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: update fail at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), newValue.c_str());
-    LOG(address, stdstring);
+	LOG(address, "%s: update fail at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), newValue.c_str());
 }
 
 /**
@@ -249,12 +282,14 @@ void Log::logUpdateFail(Address * address, bool isCoordinator, int transID, stri
  * DESCRIPTION: Call this function if DELETE failed
  */
 void Log::logDeleteFail(Address * address, bool isCoordinator, int transID, string key){
-    static char stdstring[100];
+	if ( useEventLog() ) {
+		eventLog.kvEvent(EVENT_DELETE, address, isCoordinator, false, par->getcurrtime(), transID, key, NULL);
+		return;
+	}
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: delete fail at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
-    LOG(address, stdstring);
+	LOG(address, "%s: delete fail at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
 }
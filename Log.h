@@ -10,12 +10,44 @@
 #include "stdincludes.h"
 #include "Params.h"
 #include "Member.h"
+#include "LogWriter.h"
+#include "EventLog.h"
 
 /*
  * Macros
  */
-// number of writes after which to flush file
-#define MAXWRITES 1
+// longest message LOG writes, longer ones are cut off
+#define LOG_LINE_MAX 30000
+
+/*
+ * Compile time filtering. Build with e.g.
+ * 		make LOGFLAGS="-DLOG_MIN_LEVEL=LOG_LEVEL_WARN -DLOG_CATEGORIES=LOG_KV"
+ * to compile out every log call below LOG_MIN_LEVEL or outside LOG_CATEGORIES.
+ * The grader reads the LOG_LEVEL_INFO events of LOG_KV.
+ */
+// levels
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_ERROR 3
+// categories
+#define LOG_MEMBERSHIP 0x1
+#define LOG_KV 0x2
+#define LOG_NETWORK 0x4
+#define LOG_STABILIZATION 0x8
+#define LOG_ALL 0xf
+
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#endif
+#ifndef LOG_CATEGORIES
+#define LOG_CATEGORIES LOG_ALL
+#endif
+
+#define LOG_ENABLED(level, category) ((level) >= LOG_MIN_LEVEL && 0 != ((category) & LOG_CATEGORIES))
+// run a log statement only if its level and category are compiled in; a filtered
+// out statement is dead code, so its arguments are never evaluated
+#define LOG_IF(level, category, ...) do { if ( LOG_ENABLED(level, category) ) { __VA_ARGS__; } } while ( 0 )
 #define MAGIC_NUMBER "CS425"
 #define DBG_LOG "dbg.log"
 #define STATS_LOG "stats.log"
@@ -23,18 +55,22 @@
 /**
  * CLASS NAME: Log
  *
- * DESCRIPTION: Functions to log messages in a debug log
+ * DESCRIPTION: Functions to log messages in a debug log.
+ * 				With EVENT_LOG set, the log* calls are recorded in the binary
+ * 				event log (dbg.bin) instead; LogDecoder turns it back into text.
  */
 class Log{
 private:
 	Params *par;
 	bool firstTime;
+	bool useEventLog();
 public:
 	Log(Params *p);
 	Log(const Log &anotherLog);
 	Log& operator = (const Log &anotherLog);
 	virtual ~Log();
 	void LOG(Address *, const char * str, ...);
+	void flush();
 	void logNodeAdd(Address *, Address *);
 	void logNodeRemove(Address *, Address *);
 	// success
@@ -0,0 +1,111 @@
+/**********************************
+ * FILE NAME: LogDecoder.cpp
+ *
+ * DESCRIPTION: Turns the binary event log back into dbg.log lines
+ *
+ * RUN PROCEDURE:
+ * $ ./LogDecoder dbg.bin >> dbg.log
+ **********************************/
+
+#include "EventLog.h"
+
+/**
+ * FUNCTION NAME: operationName
+ *
+ * DESCRIPTION: Name of a CRUD event type as it appears in dbg.log
+ */
+static const char *operationName(uint8_t type) {
+	switch ( type ) {
+		case EVENT_CREATE:
+			return "create";
+		case EVENT_READ:
+			return "read";
+		case EVENT_UPDATE:
+			return "update";
+		case EVENT_DELETE:
+			return "delete";
+	}
+	return NULL;
+}
+
+/**
+ * FUNCTION NAME: printRecord
+ *
+ * DESCRIPTION: Print the dbg.log line of one event, value being the bytes that followed it
+ */
+static bool printRecord(const EventRecord& record, const vector<string>& strings, const string& value) {
+	printf("\n %d.%d.%d.%d:%d [%d] ", record.node[0], record.node[1], record.node[2], record.node[3],
+			*(short *)&record.node[4], record.time);
+
+	if ( EVENT_NODE_ADD == record.type || EVENT_NODE_REMOVE == record.type ) {
+		char other[4];
+		memcpy(other, &record.key, sizeof(other));
+		printf("Node %d.%d.%d.%d:%d %s at time %d", other[0], other[1], other[2], other[3], (short)record.value,
+				EVENT_NODE_ADD == record.type ? "joined" : "removed", record.time);
+		return true;
+	}
+
+	const char *operation = operationName(record.type);
+	if ( NULL == operation || record.key >= strings.size() ) {
+		return false;
+	}
+	printf("%s: %s %s at time %d, transID=%d, key=%s", (record.flags & EVENT_COORDINATOR) ? "coordinator" : "server",
+			operation, (record.flags & EVENT_SUCCESS) ? "success" : "fail", record.time, record.transID,
+			strings[record.key].c_str());
+	if ( record.flags & EVENT_VALUE ) {
+		printf(", value=%s", value.c_str());
+	}
+	return true;
+}
+
+/**********************************
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: main function. Decode the event log named on the command line to stdout
+ **********************************/
+int main(int argc, char *argv[]) {
+	char magic[sizeof(EVENT_LOG_MAGIC) - 1];
+	EventRecord record;
+	// string ids start at 1
+	vector<string> strings(1);
+
+	if ( argc != 2 ) {
+		fprintf(stderr, "Usage: %s <%s>\n", argv[0], BIN_LOG);
+		return FAILURE;
+	}
+	FILE *fp = fopen(argv[1], "rb");
+	if ( NULL == fp ) {
+		fprintf(stderr, "Unable to open event log %s\n", argv[1]);
+		return FAILURE;
+	}
+	if ( fread(magic, sizeof(magic), 1, fp) != 1 || memcmp(magic, EVENT_LOG_MAGIC, sizeof(magic)) != 0 ) {
+		fprintf(stderr, "%s is not an event log\n", argv[1]);
+		fclose(fp);
+		return FAILURE;
+	}
+
+	while ( fread(&record, sizeof(record), 1, fp) == 1 ) {
+		// a string definition and a value both carry their length in value
+		string s;
+		if ( EVENT_STRING == record.type || (record.flags & EVENT_VALUE) ) {
+			s.assign(record.value, '\0');
+			if ( record.value > 0 && fread(&s[0], record.value, 1, fp) != 1 ) {
+				fprintf(stderr, "Truncated event in %s\n", argv[1]);
+				break;
+			}
+		}
+		if ( EVENT_STRING == record.type ) {
+			if ( record.key != strings.size() ) {
+				fprintf(stderr, "Corrupt string definition in %s\n", argv[1]);
+				break;
+			}
+			strings.push_back(s);
+		}
+		else if ( !printRecord(record, strings, s) ) {
+			fprintf(stderr, "Corrupt event in %s\n", argv[1]);
+			break;
+		}
+	}
+	fclose(fp);
+	return SUCCESS;
+}
@@ -0,0 +1,168 @@
+/**********************************
+ * FILE NAME: LogWriter.cpp
+ *
+ * DESCRIPTION: Asynchronous log file writer definition
+ **********************************/
+
+#include "LogWriter.h"
+
+/*
+ * Writers closed at exit, so that lines still in a ring reach the file
+ * even when the program ends through exit()
+ */
+static vector<LogWriter *> openWriters;
+
+/**
+ * Constructor
+ */
+LogWriter::LogWriter(): fp(NULL), ring(NULL), head(0), tail(0), flushed(0), stopping(false) {}
+
+/**
+ * Destructor
+ */
+LogWriter::~LogWriter() {
+	close();
+}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Truncate the file at path and start the writer thread
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool LogWriter::open(const char *path) {
+	static bool registered = false;
+
+	close();
+	fp = fopen(path, "w");
+	if ( NULL == fp ) {
+		return false;
+	}
+	ring = new char[LOG_RING_BYTES];
+	head.store(0);
+	tail.store(0);
+	flushed.store(0);
+	stopping.store(false);
+	worker = thread(&LogWriter::run, this);
+
+	openWriters.push_back(this);
+	if ( !registered ) {
+		atexit(LogWriter::closeAll);
+		registered = true;
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: isOpen
+ *
+ * DESCRIPTION: Returns if the writer has a file open
+ */
+bool LogWriter::isOpen() {
+	return NULL != fp;
+}
+
+/**
+ * FUNCTION NAME: write
+ *
+ * DESCRIPTION: Queue length bytes for the file. Waits while the ring is full.
+ */
+void LogWriter::write(const char *data, size_t length) {
+	if ( NULL == fp ) {
+		return;
+	}
+	while ( length > 0 ) {
+		size_t h = head.load(memory_order_relaxed);
+		size_t space = LOG_RING_BYTES - (h - tail.load(memory_order_acquire));
+		if ( 0 == space ) {
+			this_thread::yield();
+			continue;
+		}
+		size_t chunk = min(length, space);
+		size_t offset = h & (LOG_RING_BYTES - 1);
+		size_t first = min(chunk, (size_t)LOG_RING_BYTES - offset);
+		memcpy(ring + offset, data, first);
+		memcpy(ring, data + first, chunk - first);
+		head.store(h + chunk, memory_order_release);
+		data += chunk;
+		length -= chunk;
+	}
+}
+
+/**
+ * FUNCTION NAME: flush
+ *
+ * DESCRIPTION: Wait until everything written so far is in the file
+ */
+void LogWriter::flush() {
+	if ( NULL == fp ) {
+		return;
+	}
+	size_t target = head.load(memory_order_relaxed);
+	while ( flushed.load(memory_order_acquire) < target ) {
+		this_thread::yield();
+	}
+}
+
+/**
+ * FUNCTION NAME: close
+ *
+ * DESCRIPTION: Drain the ring, stop the writer thread and close the file
+ */
+void LogWriter::close() {
+	if ( NULL == fp ) {
+		return;
+	}
+	stopping.store(true, memory_order_release);
+	worker.join();
+	fclose(fp);
+	fp = NULL;
+	delete [] ring;
+	ring = NULL;
+	openWriters.erase(remove(openWriters.begin(), openWriters.end(), this), openWriters.end());
+}
+
+/**
+ * FUNCTION NAME: run
+ *
+ * DESCRIPTION: Writer thread. Writes whatever the ring holds in at most two
+ * 				fwrite calls, one per side of the wrap, and flushes the file
+ * 				whenever the ring has been drained.
+ */
+void LogWriter::run() {
+	while ( true ) {
+		size_t t = tail.load(memory_order_relaxed);
+		size_t h = head.load(memory_order_acquire);
+		if ( h != t ) {
+			size_t offset = t & (LOG_RING_BYTES - 1);
+			size_t first = min(h - t, (size_t)LOG_RING_BYTES - offset);
+			fwrite(ring + offset, 1, first, fp);
+			fwrite(ring, 1, h - t - first, fp);
+			tail.store(h, memory_order_release);
+			continue;
+		}
+		if ( flushed.load(memory_order_relaxed) != t ) {
+			fflush(fp);
+			flushed.store(t, memory_order_release);
+		}
+		// the producer is done once it asked to stop, so an empty ring stays empty
+		if ( stopping.load(memory_order_acquire) && head.load(memory_order_acquire) == t ) {
+			break;
+		}
+		this_thread::sleep_for(chrono::microseconds(LOG_IDLE_MICROS));
+	}
+}
+
+/**
+ * FUNCTION NAME: closeAll
+ *
+ * DESCRIPTION: Close every open writer. Registered with atexit.
+ */
+void LogWriter::closeAll() {
+	while ( !openWriters.empty() ) {
+		openWriters.back()->close();
+	}
+}
@@ -0,0 +1,59 @@
+/**********************************
+ * FILE NAME: LogWriter.h
+ *
+ * DESCRIPTION: Header file of the asynchronous log file writer
+ **********************************/
+
+#ifndef _LOGWRITER_H_
+#define _LOGWRITER_H_
+
+#include "stdincludes.h"
+
+#include <thread>
+#include <atomic>
+
+/*
+ * Macros
+ */
+// bytes buffered between the logging thread and the writer, a power of two
+#define LOG_RING_BYTES (1 << 20)
+// how long the writer sleeps when there is nothing to write
+#define LOG_IDLE_MICROS 1000
+
+/**
+ * CLASS NAME: LogWriter
+ *
+ * DESCRIPTION: Writes a log file from a background thread.
+ * 				write() copies the bytes into a lock-free single producer,
+ * 				single consumer ring and returns; the writer thread drains the
+ * 				ring with one fwrite per contiguous stretch and flushes the file
+ * 				once the ring runs empty. A full ring makes write() wait, so no
+ * 				log line is ever dropped.
+ *
+ * 				Only one thread may call write() and flush().
+ * 				Every open writer is closed, and so flushed, at exit.
+ */
+class LogWriter {
+private:
+	FILE *fp;
+	char *ring;
+	// total bytes ever written into and taken out of the ring
+	atomic<size_t> head;
+	atomic<size_t> tail;
+	// the file is flushed up to this many bytes
+	atomic<size_t> flushed;
+	atomic<bool> stopping;
+	thread worker;
+	void run();
+	static void closeAll();
+public:
+	LogWriter();
+	bool open(const char *path);
+	bool isOpen();
+	void write(const char *data, size_t length);
+	void flush();
+	void close();
+	virtual ~LogWriter();
+};
+
+#endif /* _LOGWRITER_H_ */
@@ -0,0 +1,517 @@
+/**********************************
+ * FILE NAME: LsmEngine.cpp
+ *
+ * DESCRIPTION: Log-structured merge storage engine definition
+ **********************************/
+
+#include "LsmEngine.h"
+
+#include <sys/stat.h>
+#include <dirent.h>
+
+namespace {
+	/*
+	 * A sorted source of entries for the k-way merge: a memtable or a run
+	 */
+	class Cursor {
+	public:
+		virtual ~Cursor() {}
+		virtual bool valid() = 0;
+		virtual const string& key() = 0;
+		virtual bool deleted() = 0;
+		virtual string value() = 0;
+		virtual void next() = 0;
+	};
+
+	class TableCursor : public Cursor {
+		LsmTable::const_iterator it, end;
+	public:
+		TableCursor(const LsmTable& table): it(table.begin()), end(table.end()) {}
+		bool valid() { return it != end; }
+		const string& key() { return it->first; }
+		bool deleted() { return it->second.deleted; }
+		string value() { return it->second.value; }
+		void next() { ++it; }
+	};
+
+	class RunCursor : public Cursor {
+		const SnapshotReader& reader;
+		uint64_t i;
+		string current;
+	public:
+		RunCursor(const SnapshotReader& r): reader(r), i(0) { load(); }
+		void load() { if ( valid() ) current = reader.keyAt(i); }
+		bool valid() { return i < reader.size(); }
+		const string& key() { return current; }
+		bool deleted() { return reader.isTombstone(i); }
+		string value() { return reader.valueAt(i); }
+		void next() { ++i; load(); }
+	};
+
+	/*
+	 * Merge sources given newest first. For each key only the newest entry
+	 * is emitted; tombstones are emitted unless dropTombstones is set.
+	 */
+	void merge(vector<Cursor *>& sources, bool dropTombstones, const function<void(Cursor *)>& emit) {
+		while ( true ) {
+			Cursor *newest = NULL;
+			for ( size_t i = 0; i < sources.size(); i++ ) {
+				if ( sources[i]->valid() && (NULL == newest || sources[i]->key() < newest->key()) ) {
+					newest = sources[i];
+				}
+			}
+			if ( NULL == newest ) {
+				return;
+			}
+			string key = newest->key();
+			if ( !(dropTombstones && newest->deleted()) ) {
+				emit(newest);
+			}
+			for ( size_t i = 0; i < sources.size(); i++ ) {
+				if ( sources[i]->valid() && sources[i]->key() == key ) {
+					sources[i]->next();
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Constructor
+ */
+BloomFilter::BloomFilter(): nbits(0) {}
+
+/**
+ * FUNCTION NAME: init
+ *
+ * DESCRIPTION: Size the filter for expectedKeys keys
+ */
+void BloomFilter::init(uint64_t expectedKeys) {
+	nbits = max((uint64_t)64, expectedKeys * LSM_BLOOM_BITS_PER_KEY);
+	bits.assign((nbits + 63) / 64, 0);
+}
+
+/**
+ * FUNCTION NAME: hashes
+ *
+ * DESCRIPTION: Two independent 64-bit hashes of key (std::hash and FNV-1a)
+ */
+void BloomFilter::hashes(const string& key, uint64_t& h1, uint64_t& h2) {
+	h1 = std::hash<string>()(key);
+	h2 = 14695981039346656037ULL;
+	for ( size_t i = 0; i < key.size(); i++ ) {
+		h2 ^= (unsigned char)key[i];
+		h2 *= 1099511628211ULL;
+	}
+	h2 |= 1;
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Add key to the filter
+ */
+void BloomFilter::add(const string& key) {
+	uint64_t h1, h2;
+	hashes(key, h1, h2);
+	for ( int i = 0; i < LSM_BLOOM_HASHES; i++ ) {
+		uint64_t bit = (h1 + i * h2) % nbits;
+		bits[bit / 64] |= 1ULL << (bit % 64);
+	}
+}
+
+/**
+ * FUNCTION NAME: mayContain
+ *
+ * DESCRIPTION: false means key was never added; true means it probably was
+ */
+bool BloomFilter::mayContain(const string& key) const {
+	if ( 0 == nbits ) {
+		return true;
+	}
+	uint64_t h1, h2;
+	hashes(key, h1, h2);
+	for ( int i = 0; i < LSM_BLOOM_HASHES; i++ ) {
+		uint64_t bit = (h1 + i * h2) % nbits;
+		if ( !(bits[bit / 64] & (1ULL << (bit % 64))) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Constructor
+ *
+ * DESCRIPTION: Runs are kept in dir, which is created if needed.
+ * 				Runs left behind by an earlier process are removed.
+ */
+LsmEngine::LsmEngine(const string& dir, size_t memtableLimit, size_t maxRuns):
+	dir(dir),
+	memtableLimit(memtableLimit),
+	maxRuns(max((size_t)1, maxRuns)),
+	memtableBytes(0),
+	immutable(NULL),
+	nextRunId(0),
+	entries(0),
+	job(NO_JOB),
+	jobInputs(0),
+	jobResult(NULL),
+	workerDone(false) {
+	mkdir(dir.c_str(), 0755);
+	DIR *d = opendir(dir.c_str());
+	if ( NULL != d ) {
+		struct dirent *e;
+		while ( NULL != (e = readdir(d)) ) {
+			string name = e->d_name;
+			if ( name.size() > 4 && 0 == name.compare(name.size() - 4, 4, ".run") ) {
+				unlink((dir + "/" + name).c_str());
+			}
+		}
+		closedir(d);
+	}
+}
+
+/**
+ * Destructor
+ */
+LsmEngine::~LsmEngine() {
+	clear();
+	rmdir(dir.c_str());
+}
+
+/**
+ * FUNCTION NAME: get
+ *
+ * DESCRIPTION: Probe the memtable, the frozen memtable and then the runs,
+ * 				newest first. The first entry found for key wins.
+ */
+bool LsmEngine::get(const string& key, string& value) {
+	LsmTable::iterator search = memtable.find(key);
+	if ( search != memtable.end() ) {
+		if ( search->second.deleted ) {
+			return false;
+		}
+		value = search->second.value;
+		return true;
+	}
+	if ( NULL != immutable ) {
+		search = immutable->find(key);
+		if ( search != immutable->end() ) {
+			if ( search->second.deleted ) {
+				return false;
+			}
+			value = search->second.value;
+			return true;
+		}
+	}
+	for ( size_t i = 0; i < runs.size(); i++ ) {
+		uint64_t position;
+		if ( !runs[i]->bloom.mayContain(key) || !runs[i]->reader.search(key, position) ) {
+			continue;
+		}
+		if ( runs[i]->reader.isTombstone(position) ) {
+			return false;
+		}
+		value = runs[i]->reader.valueAt(position);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: create
+ *
+ * DESCRIPTION: Insert the pair unless the key already exists
+ */
+bool LsmEngine::create(const string& key, string value) {
+	string existing;
+	if ( get(key, existing) ) {
+		return true;
+	}
+	memtableBytes += key.size() + value.size() + LSM_ENTRY_OVERHEAD;
+	memtable[key] = LsmEntry(move(value), false);
+	entries++;
+	maybeFlush();
+	return true;
+}
+
+/**
+ * FUNCTION NAME: update
+ *
+ * DESCRIPTION: Replace the value of an existing key
+ */
+bool LsmEngine::update(const string& key, string value) {
+	string existing;
+	if ( !get(key, existing) ) {
+		return false;
+	}
+	memtableBytes += key.size() + value.size() + LSM_ENTRY_OVERHEAD;
+	memtable[key] = LsmEntry(move(value), false);
+	maybeFlush();
+	return true;
+}
+
+/**
+ * FUNCTION NAME: deleteKey
+ *
+ * DESCRIPTION: Write a tombstone for an existing key
+ */
+bool LsmEngine::deleteKey(const string& key) {
+	string existing;
+	if ( !get(key, existing) ) {
+		return false;
+	}
+	memtable[key] = LsmEntry("", true);
+	memtableBytes += key.size() + LSM_ENTRY_OVERHEAD;
+	entries--;
+	maybeFlush();
+	return true;
+}
+
+/**
+ * FUNCTION NAME: size
+ *
+ * DESCRIPTION: Number of live keys
+ */
+unsigned long LsmEngine::size() {
+	return entries;
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Drop all contents and delete the run files
+ */
+void LsmEngine::clear() {
+	join();
+	if ( NULL != jobResult ) {
+		dropRun(jobResult);
+		jobResult = NULL;
+	}
+	job = NO_JOB;
+	delete immutable;
+	immutable = NULL;
+	memtable.clear();
+	memtableBytes = 0;
+	for ( size_t i = 0; i < runs.size(); i++ ) {
+		dropRun(runs[i]);
+	}
+	runs.clear();
+	entries = 0;
+}
+
+/**
+ * FUNCTION NAME: forEach
+ *
+ * DESCRIPTION: Visit every live pair, merging the memtables and the runs
+ */
+void LsmEngine::forEach(const KeyValueVisitor& visit) {
+	vector<Cursor *> sources;
+	sources.push_back(new TableCursor(memtable));
+	if ( NULL != immutable ) {
+		sources.push_back(new TableCursor(*immutable));
+	}
+	for ( size_t i = 0; i < runs.size(); i++ ) {
+		sources.push_back(new RunCursor(runs[i]->reader));
+	}
+	merge(sources, true, [&](Cursor *c) {
+		visit(c->key(), c->value());
+	});
+	for ( size_t i = 0; i < sources.size(); i++ ) {
+		delete sources[i];
+	}
+}
+
+/**
+ * FUNCTION NAME: maintain
+ *
+ * DESCRIPTION: Install the result of a finished flush or compaction and start
+ * 				a compaction if there are too many runs
+ */
+void LsmEngine::maintain() {
+	if ( NO_JOB != job && workerDone ) {
+		join();
+		if ( FLUSH == job ) {
+			if ( NULL != jobResult ) {
+				runs.insert(runs.begin(), jobResult);
+				delete immutable;
+				immutable = NULL;
+			}
+			else {
+				// could not write the run, keep serving from the frozen memtable and retry
+				LsmTable *frozen = immutable;
+				immutable = NULL;
+				for ( LsmTable::iterator it = frozen->begin(); it != frozen->end(); ++it ) {
+					memtable.insert(*it);
+				}
+				delete frozen;
+			}
+		}
+		else if ( NULL != jobResult ) {
+			// the inputs were the oldest runs when the compaction started
+			for ( size_t i = runs.size() - jobInputs; i < runs.size(); i++ ) {
+				dropRun(runs[i]);
+			}
+			runs.resize(runs.size() - jobInputs);
+			runs.push_back(jobResult);
+		}
+		jobResult = NULL;
+		job = NO_JOB;
+	}
+	if ( NO_JOB == job && runs.size() > maxRuns ) {
+		startCompaction();
+	}
+}
+
+/**
+ * FUNCTION NAME: runCount
+ *
+ * DESCRIPTION: Number of runs on disk
+ */
+size_t LsmEngine::runCount() {
+	return runs.size();
+}
+
+/**
+ * FUNCTION NAME: maybeFlush
+ *
+ * DESCRIPTION: Freeze a full memtable and flush it to a new run in the background.
+ * 				If the previous job is still running, wait for it: this is the
+ * 				back pressure that keeps memory and read amplification bounded.
+ */
+void LsmEngine::maybeFlush() {
+	if ( memtableBytes < memtableLimit ) {
+		return;
+	}
+	maintain();
+	while ( NO_JOB != job ) {
+		join();
+		maintain();
+	}
+	immutable = new LsmTable();
+	immutable->swap(memtable);
+	memtableBytes = 0;
+	job = FLUSH;
+	workerDone = false;
+	const LsmTable *frozen = immutable;
+	string path = runPath();
+	worker = thread([this, frozen, path]() {
+		jobResult = writeRun(path, *frozen);
+		workerDone = true;
+	});
+}
+
+/**
+ * FUNCTION NAME: startCompaction
+ *
+ * DESCRIPTION: Merge all current runs into one in the background. The merge
+ * 				includes the oldest run, so tombstones can be dropped.
+ */
+void LsmEngine::startCompaction() {
+	vector<LsmRun *> inputs = runs;
+	jobInputs = inputs.size();
+	job = COMPACT;
+	workerDone = false;
+	string path = runPath();
+	worker = thread([this, inputs, path]() {
+		jobResult = mergeRuns(path, inputs);
+		workerDone = true;
+	});
+}
+
+/**
+ * FUNCTION NAME: writeRun
+ *
+ * DESCRIPTION: Write a frozen memtable, tombstones included, to a run at path
+ *
+ * RETURNS:
+ * the opened run on SUCCESS
+ * NULL on FAILURE
+ */
+LsmRun *LsmEngine::writeRun(const string& path, const LsmTable& table) {
+	SnapshotWriter writer;
+	LsmRun *run = new LsmRun();
+	run->path = path;
+	run->bloom.init(table.size());
+	bool ok = writer.open(path);
+	for ( LsmTable::const_iterator it = table.begin(); ok && it != table.end(); ++it ) {
+		ok = it->second.deleted ? writer.addTombstone(it->first) : writer.add(it->first, it->second.value);
+		run->bloom.add(it->first);
+	}
+	if ( !ok || !writer.finish() || !run->reader.open(path) ) {
+		unlink(path.c_str());
+		delete run;
+		return NULL;
+	}
+	return run;
+}
+
+/**
+ * FUNCTION NAME: mergeRuns
+ *
+ * DESCRIPTION: Merge inputs, newest first, into a single run at path
+ *
+ * RETURNS:
+ * the opened run on SUCCESS
+ * NULL on FAILURE
+ */
+LsmRun *LsmEngine::mergeRuns(const string& path, const vector<LsmRun *>& inputs) {
+	SnapshotWriter writer;
+	vector<Cursor *> sources;
+	uint64_t expected = 0;
+	for ( size_t i = 0; i < inputs.size(); i++ ) {
+		sources.push_back(new RunCursor(inputs[i]->reader));
+		expected += inputs[i]->reader.size();
+	}
+	LsmRun *run = new LsmRun();
+	run->path = path;
+	run->bloom.init(expected);
+	bool ok = writer.open(path);
+	merge(sources, true, [&](Cursor *c) {
+		if ( ok ) {
+			ok = writer.add(c->key(), c->value());
+			run->bloom.add(c->key());
+		}
+	});
+	for ( size_t i = 0; i < sources.size(); i++ ) {
+		delete sources[i];
+	}
+	if ( !ok || !writer.finish() || !run->reader.open(path) ) {
+		unlink(path.c_str());
+		delete run;
+		return NULL;
+	}
+	return run;
+}
+
+/**
+ * FUNCTION NAME: dropRun
+ *
+ * DESCRIPTION: Unmap a run and delete its file
+ */
+void LsmEngine::dropRun(LsmRun *run) {
+	run->reader.close();
+	unlink(run->path.c_str());
+	delete run;
+}
+
+/**
+ * FUNCTION NAME: runPath
+ *
+ * DESCRIPTION: File name for the next run
+ */
+string LsmEngine::runPath() {
+	return dir + "/" + to_string(nextRunId++) + ".run";
+}
+
+/**
+ * FUNCTION NAME: join
+ *
+ * DESCRIPTION: Wait for the background thread, if any
+ */
+void LsmEngine::join() {
+	if ( worker.joinable() ) {
+		worker.join();
+	}
+}
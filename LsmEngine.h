@@ -0,0 +1,120 @@
+/**********************************
+ * FILE NAME: LsmEngine.h
+ *
+ * DESCRIPTION: Header file of the log-structured merge storage engine
+ **********************************/
+
+#ifndef LSMENGINE_H_
+#define LSMENGINE_H_
+
+#include "stdincludes.h"
+#include "StorageEngine.h"
+#include "Snapshot.h"
+
+#include <thread>
+#include <atomic>
+
+/*
+ * Macros
+ */
+#define LSM_BLOOM_BITS_PER_KEY 10
+#define LSM_BLOOM_HASHES 7
+// bytes charged per memtable entry on top of key and value
+#define LSM_ENTRY_OVERHEAD 64
+
+/**
+ * CLASS NAME: BloomFilter
+ *
+ * DESCRIPTION: Fixed size bloom filter over string keys, double hashing
+ */
+class BloomFilter {
+private:
+	vector<uint64_t> bits;
+	uint64_t nbits;
+	static void hashes(const string& key, uint64_t& h1, uint64_t& h2);
+public:
+	BloomFilter();
+	void init(uint64_t expectedKeys);
+	void add(const string& key);
+	bool mayContain(const string& key) const;
+};
+
+/**
+ * STRUCT NAME: LsmEntry
+ *
+ * DESCRIPTION: Memtable entry. Deletes are kept as tombstones until a
+ * 				compaction reaches the oldest run.
+ */
+struct LsmEntry {
+	string value;
+	bool deleted;
+	LsmEntry(): deleted(false) {}
+	LsmEntry(const string& v, bool d): value(v), deleted(d) {}
+	LsmEntry(string&& v, bool d): value(move(v)), deleted(d) {}
+};
+
+typedef map<string, LsmEntry> LsmTable;
+
+/**
+ * STRUCT NAME: LsmRun
+ *
+ * DESCRIPTION: Immutable sorted run on disk, in the snapshot file format,
+ * 				together with its bloom filter
+ */
+struct LsmRun {
+	string path;
+	SnapshotReader reader;
+	BloomFilter bloom;
+};
+
+/**
+ * CLASS NAME: LsmEngine
+ *
+ * DESCRIPTION: Storage engine for data sets larger than memory.
+ * 				Writes go to a memtable. A full memtable is frozen and flushed
+ * 				to a new run by a background thread. Once there are more than
+ * 				maxRuns runs, a background compaction merges them into one,
+ * 				so a read probes at most the memtables and maxRuns runs
+ * 				(fewer in practice, since the bloom filters skip most runs).
+ */
+class LsmEngine : public StorageEngine {
+private:
+	enum Job { NO_JOB, FLUSH, COMPACT };
+	string dir;
+	size_t memtableLimit;
+	size_t maxRuns;
+	LsmTable memtable;
+	size_t memtableBytes;
+	// frozen memtable being flushed, or NULL
+	LsmTable *immutable;
+	// newest first
+	vector<LsmRun *> runs;
+	unsigned long nextRunId;
+	unsigned long entries;
+	Job job;
+	size_t jobInputs;
+	LsmRun *jobResult;
+	thread worker;
+	atomic<bool> workerDone;
+	string runPath();
+	void maybeFlush();
+	void startCompaction();
+	void dropRun(LsmRun *run);
+	void join();
+	static LsmRun *writeRun(const string& path, const LsmTable& table);
+	static LsmRun *mergeRuns(const string& path, const vector<LsmRun *>& inputs);
+public:
+	LsmEngine(const string& dir, size_t memtableLimit, size_t maxRuns);
+	bool get(const string& key, string& value);
+	bool create(const string& key, string value);
+	bool update(const string& key, string value);
+	bool deleteKey(const string& key);
+	unsigned long size();
+	void clear();
+	void forEach(const KeyValueVisitor& visit);
+	void maintain();
+	size_t runCount();
+	virtual ~LsmEngine();
+};
+
+#endif /* LSMENGINE_H_ */
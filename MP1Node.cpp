@@ -28,6 +28,56 @@
         memcpy(&a[4], &port, sizeof(short));
         return addr;
     }
+
+    // MemberListEntry as wire format 1 lays it out, padding included
+    struct LegacyEntry {
+        int id;
+        short port;
+        long heartbeat;
+        long timestamp;
+    };
+
+    // longest varint of a 64 bit value
+    const size_t maxVarint = 10;
+
+    // zigzag encoding keeps small negative numbers short as varints
+    uint64_t zigzag(long value) {
+        return ((uint64_t)value << 1) ^ (uint64_t)(value >> (sizeof(long) * 8 - 1));
+    }
+
+    long unzigzag(uint64_t value) {
+        return (long)(value >> 1) ^ -(long)(value & 1);
+    }
+
+    // 7 bits a byte, least significant first, the high bit set on all but the last byte
+    char* putVarint(char* cur, uint64_t value) {
+        while (value >= 0x80) {
+            *cur++ = (char)(value | 0x80);
+            value >>= 7;
+        }
+        *cur++ = (char)value;
+        return cur;
+    }
+
+    // false when the buffer ends inside the varint or it is too long
+    bool getVarint(const char*& cur, const char* end, uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && cur < end; shift += 7) {
+            unsigned char byte = *cur++;
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool getSigned(const char*& cur, const char* end, long& value) {
+        uint64_t raw;
+        if (!getVarint(cur, end, raw))
+            return false;
+        value = unzigzag(raw);
+        return true;
+    }
  }
 
 /**
@@ -44,6 +94,42 @@ MP1Node::MP1Node(Member *member, Params *params, EmulNet *emul, Log *log, Addres
 	this->log = log;
 	this->par = params;
 	this->memberNode->addr = *address;
+	int id = *(int *)address->addr;
+	membersAdded = Metrics::counter("mp1.members.added", id);
+	membersRemoved = Metrics::counter("mp1.members.removed", id);
+	suspicions = Metrics::counter("mp1.suspicions", id);
+	refutations = Metrics::counter("mp1.refutations", id);
+	probeRequests = Metrics::counter("mp1.probe_requests", id);
+	memberListSize = Metrics::gauge("mp1.members", id);
+	failedListSize = Metrics::gauge("mp1.failed", id);
+	rng.seed(par->SEED, "mp1", id);
+	wireVersion = id <= par->MP1_LEGACY_NODES ? MP1_WIRE_LEGACY : MP1_WIRE_VERSION;
+	probe.active = false;
+	probeIndex = 0;
+	leaveStart = -1;
+}
+
+/*
+ * Names of the MsgTypes, for the traffic report
+ */
+const char *const MP1Node::messageTypeNames[] = {
+    "JOINREQ", "JOINREP", "PINGREQ", "PINGREP", "LEAVEREQ", "LEAVEREP", "FAILEDMESSAGE", "PROBEREQ", "PROBEREP"
+};
+
+/**
+ * FUNCTION NAME: classifyMessage
+ *
+ * DESCRIPTION: MsgTypes of a packed MessageMP1. The compact format has it after
+ * 				the version byte, the legacy one starts with it.
+ */
+int MP1Node::classifyMessage(const char *data, int size) {
+    if (size >= 2 && (data[0] & MP1_WIRE_FLAG))
+        return (unsigned char)data[1];
+    MsgTypes type;
+    if (size < (int)sizeof(type))
+        return -1;
+    memcpy(&type, data, sizeof(type));
+    return type;
 }
 
 /**
@@ -89,17 +175,13 @@ void MP1Node::nodeStart(char *servaddrstr, short servport) {
 
     // Self booting routines
     if( initThisNode(&joinaddr) == -1 ) {
-#ifdef DEBUGLOG
-        log->LOG(&memberNode->addr, "init_thisnode failed. Exit.");
-#endif
+        LOG_IF(LOG_LEVEL_ERROR, LOG_MEMBERSHIP, log->LOG(&memberNode->addr, "init_thisnode failed. Exit."));
         exit(1);
     }
 
     if( !introduceSelfToGroup(&joinaddr) ) {
         finishUpThisNode();
-#ifdef DEBUGLOG
-        log->LOG(&memberNode->addr, "Unable to join self to group. Exiting.");
-#endif
+        LOG_IF(LOG_LEVEL_ERROR, LOG_MEMBERSHIP, log->LOG(&memberNode->addr, "Unable to join self to group. Exiting."));
         exit(1);
     }
 
@@ -137,25 +219,16 @@ int MP1Node::initThisNode(Address *joinaddr) {
  * DESCRIPTION: Join the distributed system
  */
 int MP1Node::introduceSelfToGroup(Address *joinaddr) {
-#ifdef DEBUGLOG
-    static char s[1024];
-#endif
-
     if ( 0 == memcmp((char *)&(memberNode->addr.addr), (char *)&(joinaddr->addr), sizeof(memberNode->addr.addr))) {
         // I am the group booter (first process to join the group). Boot up the group
-#ifdef DEBUGLOG
-        log->LOG(&memberNode->addr, "Starting up group...");
-#endif
+        LOG_IF(LOG_LEVEL_INFO, LOG_MEMBERSHIP, log->LOG(&memberNode->addr, "Starting up group..."));
         memberNode->inGroup = true;
     }
     else {
-#ifdef DEBUGLOG
-        sprintf(s, "Trying to join...");
-        log->LOG(&memberNode->addr, s);
-#endif
+        LOG_IF(LOG_LEVEL_INFO, LOG_MEMBERSHIP, log->LOG(&memberNode->addr, "Trying to join..."));
 
         // send JOINREQ message to introducer member
-        sendMessage(*joinaddr, JOINREQ, false);
+        sendMessage(*joinaddr, JOINREQ, false, MP1_WIRE_LEGACY);
     }
 
     return 1;
@@ -168,9 +241,14 @@ int MP1Node::introduceSelfToGroup(Address *joinaddr) {
  * DESCRIPTION: Wind up this node and clean up state
  */
 int MP1Node::finishUpThisNode(){
-   /*
-    * Your code goes here
-    */
+    memberNode->inGroup = false;
+    memberNode->memberList.clear();
+    failedItems.clear();
+    probe.active = false;
+    relays.clear();
+    updates.clear();
+    leavePending.clear();
+    return 0;
 }
 
 /**
@@ -192,8 +270,17 @@ void MP1Node::nodeLoop() {
     	return;
     }
 
+    // ...and stop gossiping once the KV store lets the node leave
+    if (memberNode->bHandedOff) {
+        leaveLoopOps();
+        return;
+    }
+
     // ...then jump in and share your responsibilites!
     nodeLoopOps();
+
+    memberListSize->set(memberNode->memberList.size());
+    failedListSize->set(failedItems.size());
 
     return;
 }
@@ -223,22 +310,50 @@ void MP1Node::checkMessages() {
  * DESCRIPTION: Message handler for different message types
  */
 bool MP1Node::recvCallBack(void *env, char *data, int size ) {
+	ALLOC_SCOPE(ALLOC_MP1_MESSAGE);
 	long timestamp = par->getcurrtime();
 	if (!data) {
-#ifdef DEBUGLOG
-            log->LOG(&memberNode->addr, "Empty message recieved");
-#endif
+        LOG_IF(LOG_LEVEL_WARN, LOG_MEMBERSHIP, log->LOG(&memberNode->addr, "Empty message recieved"));
         return false;
     }
 	try {
         MessageMP1 msg(data, size);
+        // a node that only knows the legacy format cannot read the compact one
+        if (msg.version > wireVersion) {
+            LOG_IF(LOG_LEVEL_WARN, LOG_MEMBERSHIP, log->LOG(&memberNode->addr, "Unsupported wire format %d", msg.version));
+            return false;
+        }
         pair<int, short> idPort = getIdPort(msg.addr);
+        // a leave is handled the same by every detector, and must not add its sender back
+        if (msg.message_type == LEAVEREQ) {
+            memberLeft(msg);
+            return true;
+        }
+        if (msg.message_type == LEAVEREP) {
+            for (auto it = leavePending.begin(); it != leavePending.end(); ++it) {
+                if (it->id == idPort.first && it->port == idPort.second) {
+                    leavePending.erase(it);
+                    break;
+                }
+            }
+            return true;
+        }
+        // a node that announced its leave answers nothing else
+        if (memberNode->bHandedOff)
+            return true;
         MemberListEntry new_entry(idPort.first, idPort.second, msg.heartbeat, timestamp);
+        new_entry.version = msg.peerVersion;
+        new_entry.incarnation = msg.incarnation;
+        if (par->FAILURE_DETECTOR == SWIM_DETECTOR) {
+            swimRecv(msg, new_entry);
+            return true;
+        }
+        tellRemoved(msg);
         switch (msg.message_type) {
             case (JOINREQ) :
                 {
                     addMember(new_entry);
-                    sendMessage(msg.addr, JOINREP, true);
+                    sendMessage(msg.addr, JOINREP, true, msg.peerVersion);
                 }
                 break;
             case (JOINREP) :
@@ -252,7 +367,7 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
                 {
                     addMember(new_entry);
                     mergeMembers(msg.members, timestamp);
-                    sendMessage(msg.addr, PINGREP, true);
+                    sendMessage(msg.addr, PINGREP, true, msg.peerVersion);
                 }
                 break;
             case (PINGREP) :
@@ -261,18 +376,12 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
                     mergeMembers(msg.members, timestamp);
                 }
                 break;
-            //case (LEAVEREQ) :
-                //process
-            //    break;
-            //case (LEAVEREP) :
-                //process
-            //    break;
+            default:
+                break;
             }
         }
     catch(...) {
-#ifdef DEBUGLOG
-        log->LOG(&memberNode->addr, "Failed to unpack message");
-#endif
+        LOG_IF(LOG_LEVEL_WARN, LOG_MEMBERSHIP, log->LOG(&memberNode->addr, "Failed to unpack message"));
     }
 }
 
@@ -284,23 +393,29 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
  * 				Propagate your membership list
  */
 void MP1Node::nodeLoopOps() {
-    size_t randomId = rand() % memberNode->memberList.size();
-    MemberListEntry& randomMember = memberNode->memberList[randomId];
-    Address addr = getAddress(randomMember.getid(), randomMember.getport());
-    sendMessage(addr, PINGREQ, true);
-#ifdef DEBUGLOG
-//                log->LOG(&memberNode->addr, "ping, %d", addr.addr[0]);
-#endif
+    ALLOC_SCOPE(ALLOC_GOSSIP);
     long timestamp = par->getcurrtime();
-    for (auto it = memberNode->memberList.begin(); it != memberNode->memberList.end();) {
-        if (timestamp - it->timestamp > 40) {
-            failedItems.push_back(*it);
-            Address addr = getAddress(it->id, it->port);
-            log->logNodeRemove(&memberNode->addr, &addr);
-            it = memberNode->memberList.erase(it);
+    if (par->FAILURE_DETECTOR == SWIM_DETECTOR) {
+        swimLoopOps();
+    }
+    else {
+        // a node cut off from every member has nobody to ping
+        if (!memberNode->memberList.empty()) {
+            size_t randomId = rng.below(memberNode->memberList.size());
+            MemberListEntry& randomMember = memberNode->memberList[randomId];
+            Address addr = getAddress(randomMember.getid(), randomMember.getport());
+            sendMessage(addr, PINGREQ, true, randomMember.version);
         }
-        else
+        for (auto it = memberNode->memberList.begin(); it != memberNode->memberList.end();) {
+            // a suspect is removed once it has stayed silent HEARTBEAT_SUSPECT_TIMEOUT ticks past the suspicion
+            if (it->state == MEMBER_SUSPECT && isSilent(*it, timestamp - HEARTBEAT_SUSPECT_TIMEOUT)) {
+                it = removeMember(it);
+                continue;
+            }
+            if (isSilent(*it, timestamp))
+                suspect(*it, it->timestamp);
             ++it;
+        }
     }
 
     for (auto it = failedItems.begin(); it != failedItems.end();) {
@@ -315,6 +430,101 @@ void MP1Node::nodeLoopOps() {
 	 */
 
     return;
+}
+
+/**
+ * FUNCTION NAME: isSilent
+ *
+ * DESCRIPTION: Whether a member has gone without heartbeats for long enough to be
+ * 				suspected; it is removed if it is still silent
+ * 				HEARTBEAT_SUSPECT_TIMEOUT ticks later. The heartbeat detector allows a
+ * 				fixed HEARTBEAT_TIMEOUT ticks in all. The phi accrual one compares
+ * 				the silence with the member's own inter-arrival times, so the
+ * 				allowance grows with drops and jitter on its path; until it has
+ * 				seen an interval it falls back on the fixed timeout.
+ */
+bool MP1Node::isSilent(const MemberListEntry& entry, long timestamp) {
+    if (par->FAILURE_DETECTOR == PHI_DETECTOR && entry.arrivals.samples() > 0) {
+        double phi = entry.arrivals.phi(timestamp, par->PHI_MIN_STD_DEV, par->PHI_ACCEPTABLE_PAUSE);
+        if (phi < par->PHI_THRESHOLD)
+            return false;
+        LOG_IF(LOG_LEVEL_DEBUG, LOG_MEMBERSHIP, log->LOG(&memberNode->addr, "Node %d:%d phi %.2f at time %d", entry.id, entry.port,
+                phi, par->getcurrtime()));
+        return true;
+    }
+    return timestamp - entry.timestamp > HEARTBEAT_TIMEOUT - HEARTBEAT_SUSPECT_TIMEOUT;
+}
+
+/**
+ * FUNCTION NAME: leaveLoopOps
+ *
+ * DESCRIPTION: One tick of a graceful leave, which starts once the KV store has
+ * 				handed its ranges off. The node sends every member a LEAVEREQ and
+ * 				resends it to those that have not answered; it leaves when all
+ * 				have, or after LEAVE_TIMEOUT ticks, when the rest time it out, and
+ * 				the writes the KV store forwarded meanwhile are acknowledged. If a
+ * 				handoff failed it leaves without a LEAVEREQ, so that the members
+ * 				time it out like a failure and re-replicate its keys.
+ */
+void MP1Node::leaveLoopOps() {
+    long timestamp = par->getcurrtime();
+    if (leaveStart < 0) {
+        leaveStart = timestamp;
+        if (memberNode->bHandoffFailed) {
+            LOG_IF(LOG_LEVEL_WARN, LOG_MEMBERSHIP, log->LOG(&memberNode->addr, "Handoff incomplete, leaving unannounced at time %d",
+                    par->getcurrtime()));
+            finishUpThisNode();
+            memberNode->bFailed = true;
+            return;
+        }
+        leavePending = memberNode->memberList;
+        LOG_IF(LOG_LEVEL_INFO, LOG_MEMBERSHIP, log->LOG(&memberNode->addr, "Leaving the group at time %d", par->getcurrtime()));
+    }
+    if (!leavePending.empty() && timestamp - leaveStart < LEAVE_TIMEOUT) {
+        if ((timestamp - leaveStart) % LEAVE_RESEND == 0) {
+            vector<MemberListEntry> none;
+            for (auto &member : leavePending) {
+                Address addr = getAddress(member.id, member.port);
+                sendMembers(addr, LEAVEREQ, none, true, member.version);
+            }
+        }
+        return;
+    }
+    if (memberNode->pendingHandoffs > 0)
+        return;
+    LOG_IF(LOG_LEVEL_INFO, LOG_MEMBERSHIP, log->LOG(&memberNode->addr, "Left the group at time %d, %zu members did not answer",
+            par->getcurrtime(), leavePending.size()));
+    finishUpThisNode();
+    memberNode->bFailed = true;
+}
+
+/**
+ * FUNCTION NAME: memberLeft
+ *
+ * DESCRIPTION: A member announced its leave. It is removed at once, kept among the
+ * 				failed ones from its last heartbeat on so that older gossip does not
+ * 				bring it back, and the KV store is told it handed its ranges off.
+ * 				With SWIM the leave spreads like a removal. Always acknowledged.
+ */
+void MP1Node::memberLeft(MessageMP1& msg) {
+    pair<int, short> idPort = getIdPort(msg.addr);
+    for (auto it = memberNode->memberList.begin(); it != memberNode->memberList.end(); ++it) {
+        if (it->id == idPort.first && it->port == idPort.second) {
+            it->heartbeat = max(it->heartbeat, msg.heartbeat);
+            it->incarnation = max(it->incarnation, msg.incarnation);
+            it->timestamp = par->getcurrtime();
+            if (par->FAILURE_DETECTOR == SWIM_DETECTOR) {
+                MemberListEntry left(*it);
+                left.state = MEMBER_LEFT;
+                enqueueUpdate(left);
+            }
+            removeMember(it);
+            memberNode->leftMembers.push_back(msg.addr);
+            break;
+        }
+    }
+    vector<MemberListEntry> none;
+    sendMembers(msg.addr, LEAVEREP, none, true, msg.peerVersion);
 }
 
 /**
@@ -361,19 +571,41 @@ void MP1Node::printAddress(Address *addr)
                                                        addr->addr[3], *(short*)&addr->addr[4]) ;
 }
 
+/**
+ * FUNCTION NAME: addMember
+ *
+ * DESCRIPTION: Merge what a message says about a member. A newer incarnation means
+ * 				the member refuted a suspicion and replaces whatever this node
+ * 				thought; an older one is stale. Within an incarnation heartbeats
+ * 				only count as arrivals and a suspicion is taken over, so that a
+ * 				slow member hears of it and refutes it instead of flapping. A
+ * 				sender without incarnations speaks of the current one.
+ */
 void MP1Node::addMember(const MemberListEntry& new_entry, long timestamp) {
     Address new_addr = getAddress(new_entry.id, new_entry.port);
-    if (new_addr == memberNode->addr)
+    if (new_addr == memberNode->addr) {
+        refute(new_entry);
         return;
+    }
     for (auto &entry : memberNode->memberList) {
         if (entry.id == new_entry.id && entry.port == new_entry.port) {
+            if (entry.version < new_entry.version)
+                entry.version = new_entry.version;
+            long incarnation = new_entry.incarnation < 0 ? entry.incarnation : new_entry.incarnation;
+            if (incarnation < entry.incarnation)
+                return;
+            if (incarnation > entry.incarnation) {
+                entry.incarnation = incarnation;
+                entry.state = MEMBER_ALIVE;
+                entry.settimestamp(par->getcurrtime());
+            }
+            if (new_entry.state == MEMBER_SUSPECT && new_entry.incarnation >= 0)
+                suspect(entry, entry.timestamp);
             if (entry.heartbeat < new_entry.heartbeat) {
-#ifdef DEBUGLOG
-//                log->LOG(&memberNode->addr, "Update, %d", new_entry.id);
-#endif
                 entry.setheartbeat(new_entry.heartbeat);
                 if (timestamp)
                     entry.settimestamp(timestamp);
+                entry.arrivals.arrived(timestamp ? timestamp : new_entry.timestamp, par->PHI_WINDOW);
             }
             return;
         }
@@ -381,15 +613,51 @@ void MP1Node::addMember(const MemberListEntry& new_entry, long timestamp) {
     if (isFailed(new_entry))
         return;
     memberNode->memberList.push_back(new_entry);
+    MemberListEntry& added = memberNode->memberList.back();
     if (timestamp)
-        memberNode->memberList.back().settimestamp(timestamp);
-    log->logNodeAdd(&memberNode->addr, &new_addr);
+        added.settimestamp(timestamp);
+    added.arrivals = ArrivalWindow();
+    added.arrivals.arrived(added.timestamp, par->PHI_WINDOW);
+    LOG_IF(LOG_LEVEL_INFO, LOG_MEMBERSHIP, log->logNodeAdd(&memberNode->addr, &new_addr));
+    membersAdded->add();
+}
+
+/**
+ * FUNCTION NAME: tellRemoved
+ *
+ * DESCRIPTION: A member this node removed is still sending, so the removal was
+ * 				false. Send it its own entry marked faulty at the incarnation it was
+ * 				removed at: it refutes that with a newer one, which brings it back,
+ * 				see isFailed. SWIM spreads removals itself.
+ */
+void MP1Node::tellRemoved(MessageMP1& msg) {
+    pair<int, short> idPort = getIdPort(msg.addr);
+    for (auto &failed : failedItems) {
+        if (failed.id == idPort.first && failed.port == idPort.second) {
+            // without incarnations, or with a newer one, the message brings the member back anyway
+            if (msg.incarnation < 0 || msg.incarnation > failed.incarnation)
+                return;
+            vector<MemberListEntry> removed(1, failed);
+            removed[0].state = MEMBER_FAULTY;
+            sendMembers(msg.addr, PINGREP, removed, true, msg.peerVersion);
+            return;
+        }
+    }
 }
 
+/**
+ * FUNCTION NAME: isFailed
+ *
+ * DESCRIPTION: Whether new_entry is about a member this node removed. Only a newer
+ * 				incarnation brings it back, as the member must have refuted its
+ * 				removal; without incarnations on either side a newer heartbeat does.
+ */
 bool MP1Node::isFailed(const MemberListEntry& new_entry) {
     for (auto it = failedItems.begin(); it != failedItems.end(); ++it) {
         if (it->id == new_entry.id && it->port == new_entry.port) {
-            if (it->heartbeat < new_entry.heartbeat) {
+            bool newer = it->incarnation >= 0 && new_entry.incarnation >= 0 ? it->incarnation < new_entry.incarnation
+                    : it->heartbeat < new_entry.heartbeat;
+            if (newer) {
                 failedItems.erase(it);
                 return false;
             }
@@ -402,42 +670,487 @@ bool MP1Node::isFailed(const MemberListEntry& new_entry) {
 
 
 void MP1Node::mergeMembers(const vector<MemberListEntry>& members, long timestamp) {
+    TRACE_SCOPE("mergeMembers", "membership", *(int *)memberNode->addr.addr);
     for (auto &entry : members) {
         addMember(entry, timestamp);
     }
 }
 
-void MP1Node::sendMessage(Address& joinaddr, MsgTypes type, bool pack_data) {
-    MessageMP1 msg(type, memberNode->addr, memberNode->heartbeat, memberNode->memberList);
-    pair<char*, size_t> data = msg.Pack(pack_data);
+/**
+ * FUNCTION NAME: removeMember
+ *
+ * DESCRIPTION: Move a member to the failed ones
+ *
+ * RETURNS:
+ * the iterator past it
+ */
+vector<MemberListEntry>::iterator MP1Node::removeMember(vector<MemberListEntry>::iterator it) {
+    failedItems.push_back(*it);
+    Address addr = getAddress(it->id, it->port);
+    LOG_IF(LOG_LEVEL_INFO, LOG_MEMBERSHIP, log->logNodeRemove(&memberNode->addr, &addr));
+    membersRemoved->add();
+    return memberNode->memberList.erase(it);
+}
+
+/**
+ * FUNCTION NAME: findMember
+ *
+ * DESCRIPTION: The entry of a member, NULL if it is not in the list
+ */
+MemberListEntry* MP1Node::findMember(int id, short port) {
+    for (auto &entry : memberNode->memberList) {
+        if (entry.id == id && entry.port == port)
+            return &entry;
+    }
+    return NULL;
+}
+
+/**
+ * FUNCTION NAME: swimLoopOps
+ *
+ * DESCRIPTION: One tick of the SWIM failure detector. Every SWIM_PERIOD ticks a node
+ * 				pings the next member of its list, in an order shuffled once per pass.
+ * 				Without an ack after SWIM_ACK_TIMEOUT ticks it asks SWIM_INDIRECT_PROBES
+ * 				other members to ping the member too, and without any ack by the end
+ * 				of the period the member is suspected. A member still suspected after
+ * 				SWIM_SUSPECT_TIMEOUT * log10(group) ticks is removed. Suspicions and removals travel
+ * 				piggybacked on pings and acks, so the load of a node stays the same
+ * 				however large the group gets.
+ */
+void MP1Node::swimLoopOps() {
+    long timestamp = par->getcurrtime();
+    if (probe.active) {
+        MemberListEntry* target = findMember(probe.id, probe.port);
+        if (NULL == target) {
+            // removed by an update meanwhile
+            probe.active = false;
+        }
+        else if (timestamp - probe.sentAt >= par->SWIM_PERIOD) {
+            probe.active = false;
+            if (!probe.acked && target->state == MEMBER_ALIVE) {
+                suspect(*target, timestamp);
+                // tell the member first, a live one refutes it with its ack
+                Address addr = getAddress(target->id, target->port);
+                sendMessage(addr, PINGREQ, true, target->version);
+            }
+        }
+        else if (!probe.acked && !probe.indirect && timestamp - probe.sentAt >= par->SWIM_ACK_TIMEOUT) {
+            sendProbeRequests(*target);
+            probe.indirect = true;
+        }
+    }
+    if (!probe.active)
+        startProbe(timestamp);
+
+    // a suspicion takes about log(group) periods to reach every member, and so does its refutation
+    long suspectTimeout = (long)ceil(par->SWIM_SUSPECT_TIMEOUT * max(1.0, log10((double)memberNode->memberList.size() + 1)));
+    for (auto it = memberNode->memberList.begin(); it != memberNode->memberList.end();) {
+        if (it->state == MEMBER_SUSPECT && timestamp - it->timestamp >= suspectTimeout) {
+            MemberListEntry faulty(*it);
+            faulty.state = MEMBER_FAULTY;
+            enqueueUpdate(faulty);
+            it = removeMember(it);
+        }
+        else
+            ++it;
+    }
+
+    for (auto it = relays.begin(); it != relays.end();) {
+        if (timestamp - it->since >= par->SWIM_PERIOD)
+            it = relays.erase(it);
+        else
+            ++it;
+    }
+}
+
+/**
+ * FUNCTION NAME: swimRecv
+ *
+ * DESCRIPTION: Message handler of the SWIM failure detector
+ */
+void MP1Node::swimRecv(MessageMP1& msg, MemberListEntry& sender) {
+    heardFrom(sender);
+    switch (msg.message_type) {
+        case (JOINREQ) :
+            sendMessage(msg.addr, JOINREP, true, msg.peerVersion);
+            break;
+        case (JOINREP) :
+            mergeUpdates(msg.members);
+            memberNode->inGroup = true;
+            break;
+        case (PINGREQ) :
+            mergeUpdates(msg.members);
+            sendMessage(msg.addr, PINGREP, true, msg.peerVersion);
+            break;
+        case (PINGREP) :
+            {
+                mergeUpdates(msg.members);
+                if (probe.active && probe.id == sender.id && probe.port == sender.port)
+                    probe.acked = true;
+                // pass the ack on to the members this node probed the sender for
+                MemberListEntry* entry = findMember(sender.id, sender.port);
+                vector<MemberListEntry> carried(1, NULL != entry ? *entry : sender);
+                for (auto it = relays.begin(); it != relays.end();) {
+                    if (it->id == sender.id && it->port == sender.port) {
+                        sendMembers(it->origin, PROBEREP, carried, true, it->originVersion);
+                        it = relays.erase(it);
+                    }
+                    else
+                        ++it;
+                }
+            }
+            break;
+        case (PROBEREQ) :
+            if (!msg.members.empty()) {
+                MemberListEntry& target = msg.members.front();
+                ProbeRelay relay = { msg.addr, msg.peerVersion, target.id, target.port, par->getcurrtime() };
+                relays.push_back(relay);
+                MemberListEntry* entry = findMember(target.id, target.port);
+                Address addr = getAddress(target.id, target.port);
+                sendMessage(addr, PINGREQ, true, NULL != entry ? entry->version : target.version);
+            }
+            break;
+        case (PROBEREP) :
+            if (!msg.members.empty()) {
+                MemberListEntry& target = msg.members.front();
+                if (probe.active && probe.id == target.id && probe.port == target.port)
+                    probe.acked = true;
+                mergeUpdates(msg.members);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * FUNCTION NAME: startProbe
+ *
+ * DESCRIPTION: Ping the next member, starting a protocol period
+ */
+void MP1Node::startProbe(long timestamp) {
+    vector<MemberListEntry>& members = memberNode->memberList;
+    if (members.empty())
+        return;
+    if (probeIndex >= members.size()) {
+        // every member gets probed once per pass, in a fresh random order
+        for (size_t i = members.size() - 1; i > 0; i--)
+            swap(members[i], members[rng.below(i + 1)]);
+        probeIndex = 0;
+    }
+    MemberListEntry& target = members[probeIndex++];
+    probe.active = true;
+    probe.id = target.id;
+    probe.port = target.port;
+    probe.sentAt = timestamp;
+    probe.acked = false;
+    probe.indirect = false;
+    Address addr = getAddress(target.id, target.port);
+    sendMessage(addr, PINGREQ, true, target.version);
+}
+
+/**
+ * FUNCTION NAME: sendProbeRequests
+ *
+ * DESCRIPTION: Ask up to SWIM_INDIRECT_PROBES random live members to probe target
+ */
+void MP1Node::sendProbeRequests(const MemberListEntry& target) {
+    vector<MemberListEntry>& members = memberNode->memberList;
+    vector<size_t> helpers;
+    for (size_t i = 0; i < members.size(); i++) {
+        if (members[i].state == MEMBER_ALIVE && !(members[i].id == target.id && members[i].port == target.port))
+            helpers.push_back(i);
+    }
+    vector<MemberListEntry> carried(1, target);
+    size_t count = min(helpers.size(), (size_t)max(0, par->SWIM_INDIRECT_PROBES));
+    for (size_t i = 0; i < count; i++) {
+        // a partial shuffle picks distinct helpers
+        swap(helpers[i], helpers[i + rng.below(helpers.size() - i)]);
+        MemberListEntry& helper = members[helpers[i]];
+        Address addr = getAddress(helper.id, helper.port);
+        sendMembers(addr, PROBEREQ, carried, true, helper.version);
+        probeRequests->add();
+    }
+}
+
+/**
+ * FUNCTION NAME: swimAdd
+ *
+ * DESCRIPTION: Add a member at a random place of the list, so that the round robin
+ * 				probes of different nodes do not reach it together, and spread it
+ */
+void MP1Node::swimAdd(const MemberListEntry& entry, long timestamp) {
+    vector<MemberListEntry>& members = memberNode->memberList;
+    size_t size = members.size();
+    addMember(entry, timestamp);
+    if (members.size() == size)
+        return;
+    enqueueUpdate(members.back());
+    swap(members.back(), members[rng.below(members.size())]);
+}
+
+/**
+ * FUNCTION NAME: heardFrom
+ *
+ * DESCRIPTION: A message came straight from sender, so it is alive. A suspected
+ * 				sender that has refuted the suspicion carries a newer incarnation,
+ * 				which clears it here too.
+ */
+void MP1Node::heardFrom(const MemberListEntry& sender) {
+    MemberListEntry* entry = findMember(sender.id, sender.port);
+    if (NULL == entry) {
+        swimAdd(sender, sender.timestamp);
+        return;
+    }
+    if (entry->version < sender.version)
+        entry->version = sender.version;
+    entry->heartbeat = max(entry->heartbeat, sender.heartbeat);
+    // hearing from a suspect directly restarts the suspicion, it may just not have heard of it yet
+    entry->timestamp = sender.timestamp;
+    if (entry->incarnation < sender.incarnation) {
+        entry->incarnation = sender.incarnation;
+        if (entry->state == MEMBER_SUSPECT) {
+            entry->state = MEMBER_ALIVE;
+            enqueueUpdate(*entry);
+        }
+    }
+}
+
+/**
+ * FUNCTION NAME: mergeUpdates
+ *
+ * DESCRIPTION: Apply SWIM membership updates. The incarnation of a member orders
+ * 				its updates: a suspicion or removal holds against an alive update
+ * 				of the same incarnation, an alive update only wins with a newer
+ * 				one. A node hearing it is suspected or removed refutes it, see refute.
+ * 				Updates that change this node's view are passed on.
+ */
+void MP1Node::mergeUpdates(const vector<MemberListEntry>& members) {
+    TRACE_SCOPE("mergeUpdates", "membership", *(int *)memberNode->addr.addr);
+    long timestamp = par->getcurrtime();
+    for (auto &update : members) {
+        if (getAddress(update.id, update.port) == memberNode->addr) {
+            refute(update);
+            continue;
+        }
+        auto it = memberNode->memberList.begin();
+        while (it != memberNode->memberList.end() && !(it->id == update.id && it->port == update.port))
+            ++it;
+        if (it == memberNode->memberList.end()) {
+            if (update.state != MEMBER_ALIVE) {
+                // only an alive update can bring back a member this node removed
+                bool removed = false;
+                for (auto &failed : failedItems)
+                    removed = removed || (failed.id == update.id && failed.port == update.port);
+                if (removed)
+                    continue;
+                if (update.state == MEMBER_FAULTY || update.state == MEMBER_LEFT) {
+                    // remember it, so that older alive updates do not bring it back
+                    failedItems.push_back(update);
+                    failedItems.back().settimestamp(timestamp);
+                    continue;
+                }
+            }
+            swimAdd(update, timestamp);
+            continue;
+        }
+        if (it->version < update.version)
+            it->version = update.version;
+        switch (update.state) {
+            case (MEMBER_ALIVE) :
+                if (update.incarnation > it->incarnation) {
+                    it->incarnation = update.incarnation;
+                    if (it->state == MEMBER_SUSPECT) {
+                        it->state = MEMBER_ALIVE;
+                        it->timestamp = timestamp;
+                        enqueueUpdate(*it);
+                    }
+                }
+                break;
+            case (MEMBER_SUSPECT) :
+                if (update.incarnation >= it->incarnation) {
+                    it->incarnation = update.incarnation;
+                    suspect(*it, timestamp);
+                }
+                break;
+            case (MEMBER_FAULTY) :
+            case (MEMBER_LEFT) :
+                if (update.incarnation >= it->incarnation) {
+                    enqueueUpdate(update);
+                    if (update.state == MEMBER_LEFT)
+                        memberNode->leftMembers.push_back(getAddress(update.id, update.port));
+                    removeMember(it);
+                }
+                break;
+        }
+    }
+}
+
+/**
+ * FUNCTION NAME: suspect
+ *
+ * DESCRIPTION: Suspect a live member and spread the suspicion
+ */
+void MP1Node::suspect(MemberListEntry& entry, long timestamp) {
+    if (entry.state != MEMBER_ALIVE)
+        return;
+    entry.state = MEMBER_SUSPECT;
+    entry.timestamp = timestamp;
+    if (par->FAILURE_DETECTOR == SWIM_DETECTOR)
+        enqueueUpdate(entry);
+    suspicions->add();
+    Address addr = getAddress(entry.id, entry.port);
+    LOG_IF(LOG_LEVEL_INFO, LOG_MEMBERSHIP, log->LOG(&memberNode->addr, "Node %d.%d.%d.%d:%d suspected at time %d", addr.addr[0],
+            addr.addr[1], addr.addr[2], addr.addr[3], *(short *)&addr.addr[4], par->getcurrtime()));
+}
+
+/**
+ * FUNCTION NAME: refute
+ *
+ * DESCRIPTION: Another member suspects or removed this node. Unless that is about
+ * 				an incarnation already refuted, start a newer one: it overrides the
+ * 				suspicion everywhere. SWIM piggybacks it, otherwise every message
+ * 				this node sends carries it anyway.
+ */
+void MP1Node::refute(const MemberListEntry& update) {
+    // an update without an incarnation comes from a format older than 4 and cannot be refuted
+    if (update.state == MEMBER_ALIVE || update.incarnation < memberNode->incarnation)
+        return;
+    memberNode->incarnation = update.incarnation + 1;
+    if (par->FAILURE_DETECTOR == SWIM_DETECTOR) {
+        pair<int, short> idPort = getIdPort(memberNode->addr);
+        MemberListEntry self(idPort.first, idPort.second, memberNode->heartbeat, par->getcurrtime());
+        self.incarnation = memberNode->incarnation;
+        self.version = wireVersion;
+        enqueueUpdate(self);
+    }
+    refutations->add();
+    LOG_IF(LOG_LEVEL_INFO, LOG_MEMBERSHIP, log->LOG(&memberNode->addr, "Refuted suspicion with incarnation %ld at time %d",
+            memberNode->incarnation, par->getcurrtime()));
+}
+
+/**
+ * FUNCTION NAME: enqueueUpdate
+ *
+ * DESCRIPTION: Queue an update to piggyback, replacing an older one of the same member
+ */
+void MP1Node::enqueueUpdate(const MemberListEntry& entry) {
+    for (auto &update : updates) {
+        if (update.entry.id == entry.id && update.entry.port == entry.port) {
+            update.entry = entry;
+            update.sends = 0;
+            return;
+        }
+    }
+    MemberUpdate update = { entry, 0 };
+    updates.push_back(update);
+}
+
+/**
+ * FUNCTION NAME: piggyback
+ *
+ * DESCRIPTION: Up to SWIM_PIGGYBACK updates for a message to receiver, the least
+ * 				sent first. A suspicion of the receiver goes first of all, so that
+ * 				it can refute it before the suspicion times out. An update is dropped
+ * 				after SWIM_RETRANSMIT_MULT * log2(group) messages, by when it has
+ * 				reached the whole group with high probability.
+ */
+vector<MemberListEntry> MP1Node::piggyback(const Address& receiver) {
+    vector<MemberListEntry> picked;
+    if (updates.empty())
+        return picked;
+    stable_sort(updates.begin(), updates.end(), [](const MemberUpdate& a, const MemberUpdate& b) {
+        return a.sends < b.sends;
+    });
+    for (auto it = updates.begin(); it != updates.end(); ++it) {
+        if (it->entry.state != MEMBER_ALIVE && getAddress(it->entry.id, it->entry.port) == receiver) {
+            rotate(updates.begin(), it, it + 1);
+            break;
+        }
+    }
+    int limit = SWIM_RETRANSMIT_MULT * (int)ceil(log2(memberNode->memberList.size() + 2));
+    size_t count = min(updates.size(), (size_t)max(0, par->SWIM_PIGGYBACK));
+    picked.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        picked.push_back(updates[i].entry);
+        ++updates[i].sends;
+    }
+    updates.erase(remove_if(updates.begin(), updates.end(), [limit](const MemberUpdate& update) {
+        return update.sends >= limit;
+    }), updates.end());
+    return picked;
+}
+
+/**
+ * FUNCTION NAME: sendMessage
+ *
+ * DESCRIPTION: Send a message in the highest wire format both this node and the
+ * 				receiver understand; peerVersion is 0 when the receiver's is unknown
+ */
+void MP1Node::sendMessage(Address& joinaddr, MsgTypes type, bool pack_data, int peerVersion) {
+    // with SWIM a message carries a few recent updates, but a joining node needs the whole list
+    if (par->FAILURE_DETECTOR == SWIM_DETECTOR && type != JOINREP)
+        sendMembers(joinaddr, type, piggyback(joinaddr), pack_data, peerVersion);
+    else
+        sendMembers(joinaddr, type, memberNode->memberList, pack_data, peerVersion);
+}
+
+/**
+ * FUNCTION NAME: sendMembers
+ *
+ * DESCRIPTION: Send a message carrying members
+ */
+void MP1Node::sendMembers(Address& joinaddr, MsgTypes type, const vector<MemberListEntry>& members, bool pack_data, int peerVersion) {
+    MessageMP1 msg(type, memberNode->addr, memberNode->heartbeat, members);
+    msg.incarnation = memberNode->incarnation;
+    msg.peerVersion = wireVersion;
+    pair<char*, size_t> data = msg.Pack(pack_data, max(MP1_WIRE_LEGACY, min(wireVersion, peerVersion)));
     if (!!data.first) {
         emulNet->ENsend(&memberNode->addr, &joinaddr, data.first, data.second);
         free(data.first);
         ++memberNode->heartbeat;
     }
     else {
-#ifdef DEBUGLOG
-        log->LOG(&memberNode->addr, "Failed to pack message");
-#endif
+        LOG_IF(LOG_LEVEL_WARN, LOG_MEMBERSHIP, log->LOG(&memberNode->addr, "Failed to pack message"));
     }
 }
 
-MessageMP1::MessageMP1() {}
+MessageMP1::MessageMP1() : incarnation(0), version(MP1_WIRE_VERSION), peerVersion(MP1_WIRE_VERSION) {}
 
 MessageMP1::MessageMP1(MsgTypes t, Address a, long hb, vector<MemberListEntry> m) :
     message_type(t)
     , addr(a)
     , heartbeat(hb)
-    , members(m) {}
+    , incarnation(0)
+    , members(m)
+    , version(MP1_WIRE_VERSION)
+    , peerVersion(MP1_WIRE_VERSION) {}
 
 //Unpack packed message
 MessageMP1::MessageMP1(char* packed_message, size_t message_size) {
+    if (message_size >= 1 && (packed_message[0] & MP1_WIRE_FLAG))
+        UnpackCompact(packed_message, message_size);
+    else
+        UnpackLegacy(packed_message, message_size);
+}
+
+/**
+ * FUNCTION NAME: UnpackLegacy
+ *
+ * DESCRIPTION: Unpack wire format 1. Senders that understand a newer format add
+ * 				a byte with it after the last field, which older nodes ignore.
+ */
+void MessageMP1::UnpackLegacy(char* packed_message, size_t message_size) {
+    version = MP1_WIRE_LEGACY;
+    peerVersion = MP1_WIRE_LEGACY;
+    incarnation = -1;
     size_t min_size = sizeof(message_type) + sizeof(addr) + sizeof(heartbeat);
     if (message_size < min_size){
         message_type = FAILEDMESSAGE;
         return;
     }
     char* cur = packed_message;
+    char* end = packed_message + message_size;
     memcpy(&message_type, cur, sizeof(message_type));
     cur += sizeof(message_type);
     memcpy(&addr, cur, sizeof(addr));
@@ -448,22 +1161,139 @@ MessageMP1::MessageMP1(char* packed_message, size_t message_size) {
         size_t members_size;
         memcpy(&members_size, cur, sizeof(size_t));
         cur += sizeof(size_t);
-        if (members_size > 0) {
-            if (message_size >= min_size + sizeof(size_t) + members_size * sizeof(MemberListEntry)) {
-                members = vector<MemberListEntry>((MemberListEntry*)cur, (MemberListEntry*)cur + members_size);
-            }
-            else {
-                message_type = FAILEDMESSAGE;
+        if (members_size > (message_size - min_size - sizeof(size_t)) / sizeof(LegacyEntry)) {
+            message_type = FAILEDMESSAGE;
+            return;
+        }
+        members.reserve(members_size);
+        for (size_t i = 0; i < members_size; i++) {
+            LegacyEntry entry;
+            memcpy(&entry, cur, sizeof(entry));
+            cur += sizeof(entry);
+            members.push_back(MemberListEntry(entry.id, entry.port, entry.heartbeat, entry.timestamp));
+            members.back().incarnation = -1;
+        }
+    }
+    if (cur < end)
+        peerVersion = max(MP1_WIRE_LEGACY, (int)(unsigned char)*cur);
+}
+
+/**
+ * FUNCTION NAME: UnpackCompact
+ *
+ * DESCRIPTION: Unpack wire format 2 to 4, see Pack
+ */
+void MessageMP1::UnpackCompact(char* packed_message, size_t message_size) {
+    const char* cur = packed_message;
+    const char* end = packed_message + message_size;
+    version = (unsigned char)*cur++ & ~MP1_WIRE_FLAG;
+    peerVersion = version;
+    message_type = FAILEDMESSAGE;
+    incarnation = -1;
+    if (version < MP1_WIRE_COMPACT || version > MP1_WIRE_VERSION || cur == end)
+        return;
+    MsgTypes type = (MsgTypes)(unsigned char)*cur++;
+    uint64_t id, port, members_size;
+    long timestamp;
+    if (!getVarint(cur, end, id) || !getVarint(cur, end, port) || !getSigned(cur, end, heartbeat))
+        return;
+    if (version >= MP1_WIRE_INCARNATION && !getSigned(cur, end, incarnation))
+        return;
+    addr = getAddress((int)id, (short)port);
+    if (cur < end) {
+        if (!getVarint(cur, end, members_size) || !getSigned(cur, end, timestamp))
+            return;
+        // every member takes at least 5 bytes, which bounds a corrupt count
+        if (members_size > (size_t)(end - cur) / 5)
+            return;
+        members.reserve(members_size);
+        for (size_t i = 0; i < members_size; i++) {
+            uint64_t member_id, member_port, member_version, member_state = MEMBER_ALIVE;
+            long member_heartbeat, age, member_incarnation = -1;
+            if (!getVarint(cur, end, member_id) || !getVarint(cur, end, member_port)
+                    || !getSigned(cur, end, member_heartbeat) || !getSigned(cur, end, age)
+                    || !getVarint(cur, end, member_version)
+                    || (version >= MP1_WIRE_STATE && !getVarint(cur, end, member_state))
+                    || (version >= MP1_WIRE_INCARNATION && !getSigned(cur, end, member_incarnation)))
                 return;
-            }
+            members.push_back(MemberListEntry((int)member_id, (short)member_port, member_heartbeat, timestamp - age));
+            members.back().version = (int)member_version;
+            members.back().state = (int)member_state;
+            members.back().incarnation = member_incarnation;
         }
     }
+    message_type = type;
 }
 
-pair<char*, size_t> MessageMP1::Pack(bool pack_data) {
-    size_t msgsize = sizeof(MsgTypes) + sizeof(Address) + sizeof(long);
+/**
+ * FUNCTION NAME: Pack
+ *
+ * DESCRIPTION: Pack the message in wire_version. Wire format 2 has every integer
+ * 				as a varint, the signed ones zigzag encoded:
+ * 				  byte		MP1_WIRE_FLAG | 2
+ * 				  byte		MsgTypes
+ * 				  id, port, heartbeat of the sender
+ * 				and when pack_data, the member list:
+ * 				  count, base timestamp (the latest one)
+ * 				  per member: id, port, heartbeat, base - timestamp, version
+ * 				Format 3 adds the memberSTATE after the version of each member,
+ * 				format 4 the incarnation after the sender's heartbeat and after
+ * 				the memberSTATE of each member.
+ * 				A member usually takes 5 to 8 bytes instead of the 24 of format 1.
+ */
+pair<char*, size_t> MessageMP1::Pack(bool pack_data, int wire_version) {
+    if (wire_version == MP1_WIRE_LEGACY)
+        return PackLegacy(pack_data);
+    size_t maxsize = 2 + 4 * maxVarint;
     if (pack_data) {
-        msgsize += sizeof(size_t) + members.size() * sizeof(MemberListEntry);
+        maxsize += 2 * maxVarint + members.size() * 7 * maxVarint;
+    }
+    char* msg = (char*) malloc(maxsize);
+    if (!msg) {
+        return make_pair<char*, size_t>(nullptr, 0);
+    }
+    pair<int, short> idPort = getIdPort(addr);
+    char* cur = msg;
+    *cur++ = (char)(MP1_WIRE_FLAG | wire_version);
+    *cur++ = (char)message_type;
+    cur = putVarint(cur, (uint32_t)idPort.first);
+    cur = putVarint(cur, (uint16_t)idPort.second);
+    cur = putVarint(cur, zigzag(heartbeat));
+    if (wire_version >= MP1_WIRE_INCARNATION)
+        cur = putVarint(cur, zigzag(incarnation));
+    if (pack_data) {
+        long base = 0;
+        for (auto& entry : members) {
+            base = max(base, entry.timestamp);
+        }
+        cur = putVarint(cur, members.size());
+        cur = putVarint(cur, zigzag(base));
+        for (auto& entry : members) {
+            cur = putVarint(cur, (uint32_t)entry.id);
+            cur = putVarint(cur, (uint16_t)entry.port);
+            cur = putVarint(cur, zigzag(entry.heartbeat));
+            cur = putVarint(cur, zigzag(base - entry.timestamp));
+            cur = putVarint(cur, (uint32_t)entry.version);
+            if (wire_version >= MP1_WIRE_STATE)
+                cur = putVarint(cur, (uint32_t)entry.state);
+            if (wire_version >= MP1_WIRE_INCARNATION)
+                cur = putVarint(cur, zigzag(entry.incarnation));
+        }
+    }
+    return make_pair(msg, (size_t)(cur - msg));
+}
+
+/**
+ * FUNCTION NAME: PackLegacy
+ *
+ * DESCRIPTION: Pack the message in wire format 1, followed by the newest format
+ * 				this node understands unless that is format 1 itself
+ */
+pair<char*, size_t> MessageMP1::PackLegacy(bool pack_data) {
+    bool trailer = peerVersion > MP1_WIRE_LEGACY;
+    size_t msgsize = sizeof(MsgTypes) + sizeof(Address) + sizeof(long) + (trailer ? 1 : 0);
+    if (pack_data) {
+        msgsize += sizeof(size_t) + members.size() * sizeof(LegacyEntry);
     }
     char* msg = (char*) malloc(msgsize * sizeof(char));
         if (!msg) {
@@ -480,10 +1310,18 @@ pair<char*, size_t> MessageMP1::Pack(bool pack_data) {
         size_t sizeoflist = members.size();
         memcpy(cur, &sizeoflist, sizeof(size_t));
         cur += sizeof(size_t);
-        if (sizeoflist > 0) {
-            memcpy(cur, &members.front(), sizeoflist * sizeof(MemberListEntry));
+        for (auto& member : members) {
+            LegacyEntry entry;
+            memset(&entry, 0, sizeof(entry));
+            entry.id = member.id;
+            entry.port = member.port;
+            entry.heartbeat = member.heartbeat;
+            entry.timestamp = member.timestamp;
+            memcpy(cur, &entry, sizeof(entry));
+            cur += sizeof(entry);
         }
     }
+    if (trailer)
+        *cur = (char)peerVersion;
     return make_pair(msg, msgsize);
 }
-
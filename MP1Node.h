@@ -14,12 +14,42 @@
 #include "Member.h"
 #include "EmulNet.h"
 #include "Queue.h"
+#include "Trace.h"
+#include "AllocProfile.h"
+#include "Metrics.h"
+#include "Random.h"
 
 /**
  * Macros
  */
 #define TREMOVE 20
 #define TFAIL 5
+// ticks without a newer heartbeat after which the heartbeat detector removes a member
+#define HEARTBEAT_TIMEOUT 40
+// of those, the member is suspected for the last HEARTBEAT_SUSPECT_TIMEOUT, time for it to refute
+#define HEARTBEAT_SUSPECT_TIMEOUT 8
+
+// a leaving node resends LEAVEREQ to the members that have not answered every LEAVE_RESEND
+// ticks, and leaves regardless after LEAVE_TIMEOUT ticks
+#define LEAVE_RESEND 2
+#define LEAVE_TIMEOUT 10
+
+// SWIM piggybacks an update on this many times log2 of the group size messages
+#define SWIM_RETRANSMIT_MULT 3
+
+/*
+ * MP1 wire formats. 1 is the original one, the raw MessageMP1 fields followed by
+ * MemberListEntry structs. 2 is the compact one described at MessageMP1::Pack,
+ * 3 adds the memberSTATE of each member to it and 4 the incarnations of the sender and of each
+ * member. A node sends a member the highest format both understand, and 1 until it knows.
+ */
+#define MP1_WIRE_LEGACY 1
+#define MP1_WIRE_COMPACT 2
+#define MP1_WIRE_STATE 3
+#define MP1_WIRE_INCARNATION 4
+#define MP1_WIRE_VERSION 4
+// first byte of a compact message: the flag a legacy MsgTypes never has, then the version
+#define MP1_WIRE_FLAG 0x80
 
 /*
  * Note: You can change/add any functions in MP1Node.{h,cpp}
@@ -36,7 +66,47 @@ enum MsgTypes{
     LEAVEREQ,
     LEAVEREP,
     FAILEDMESSAGE,
+    // appended, as the values of the others go on the wire
+    PROBEREQ,	// SWIM ping-req: probe the one member carried on my behalf
+    PROBEREP,	// SWIM: the member carried answered a PROBEREQ probe
     DUMMYLASTMSGTYPE
+};
+
+/**
+ * STRUCT NAME: MemberUpdate
+ *
+ * DESCRIPTION: A SWIM membership update waiting to be piggybacked
+ */
+struct MemberUpdate {
+	MemberListEntry entry;	// the member as the update describes it, state included
+	int sends;				// messages it has been piggybacked on so far
+};
+
+/**
+ * STRUCT NAME: SwimProbe
+ *
+ * DESCRIPTION: The probe a node has running in the current SWIM protocol period
+ */
+struct SwimProbe {
+	bool active;
+	int id;
+	short port;
+	long sentAt;	// tick the direct ping went out
+	bool acked;		// directly or through a PROBEREQ
+	bool indirect;	// PROBEREQs sent
+};
+
+/**
+ * STRUCT NAME: ProbeRelay
+ *
+ * DESCRIPTION: A PROBEREQ this node is serving, until the target answers or a period ends
+ */
+struct ProbeRelay {
+	Address origin;
+	int originVersion;
+	int id;
+	short port;
+	long since;
 };
 
 /**
@@ -47,6 +117,8 @@ enum MsgTypes{
 typedef struct MessageHdr {
 	enum MsgTypes msgType;
 }MessageHdr;
+
+struct MessageMP1;
 
 /**
  * CLASS NAME: MP1Node
@@ -61,6 +133,24 @@ private:
 	Member *memberNode;
 	char NULLADDR[6];
 	vector<MemberListEntry> failedItems;
+	Random rng;
+	int wireVersion;	// highest wire format this node understands
+	// SWIM failure detector
+	SwimProbe probe;
+	size_t probeIndex;	// next member to probe, in a list shuffled once per pass
+	vector<ProbeRelay> relays;
+	vector<MemberUpdate> updates;
+	// graceful leave: members yet to answer the LEAVEREQ, and when it was first sent
+	vector<MemberListEntry> leavePending;
+	long leaveStart;
+	// metrics
+	Counter *membersAdded;
+	Counter *membersRemoved;
+	Counter *suspicions;
+	Counter *refutations;
+	Counter *probeRequests;
+	Gauge *memberListSize;
+	Gauge *failedListSize;
 
 public:
 	MP1Node(Member *, Params *, EmulNet *, Log *, Address *);
@@ -83,9 +173,32 @@ public:
 	void printAddress(Address *addr);
 	char* packMessage(MsgTypes msgtype, bool pack_data, size_t& msgsize);
 	void addMember(const MemberListEntry& new_entry, long timestamp = 0);
-	void sendMessage(Address& joinaddr, MsgTypes type, bool pack_data);
+	void sendMessage(Address& joinaddr, MsgTypes type, bool pack_data, int peerVersion);
+	void sendMembers(Address& toaddr, MsgTypes type, const vector<MemberListEntry>& members, bool pack_data, int peerVersion);
 	void mergeMembers(const vector<MemberListEntry>& members, long timestamp);
 	bool isFailed(const MemberListEntry& new_entry);
+	void tellRemoved(MessageMP1& msg);
+	bool isSilent(const MemberListEntry& entry, long timestamp);
+	// graceful leave
+	void leaveLoopOps();
+	void memberLeft(MessageMP1& msg);
+	// SWIM failure detector
+	void swimLoopOps();
+	void swimRecv(MessageMP1& msg, MemberListEntry& sender);
+	void startProbe(long timestamp);
+	void sendProbeRequests(const MemberListEntry& target);
+	void swimAdd(const MemberListEntry& entry, long timestamp);
+	void heardFrom(const MemberListEntry& sender);
+	void mergeUpdates(const vector<MemberListEntry>& members);
+	void suspect(MemberListEntry& entry, long timestamp);
+	void refute(const MemberListEntry& update);
+	vector<MemberListEntry>::iterator removeMember(vector<MemberListEntry>::iterator it);
+	MemberListEntry* findMember(int id, short port);
+	void enqueueUpdate(const MemberListEntry& entry);
+	vector<MemberListEntry> piggyback(const Address& receiver);
+	// traffic accounting
+	static const char *const messageTypeNames[];
+	static int classifyMessage(const char *data, int size);
 	virtual ~MP1Node();
 };
 
@@ -93,12 +206,19 @@ struct MessageMP1 {
     MsgTypes message_type;
     Address addr;
     long heartbeat;
+    long incarnation; // of the sender, -1 before wire format 4
     vector<MemberListEntry> members;
+    int version; // wire format the message was packed in
+    int peerVersion; // highest wire format its sender understands
     MessageMP1();
     MessageMP1(MsgTypes t, Address a, long hb, vector<MemberListEntry> m);
-    //Unpack packed message
+    //Unpack packed message, in either wire format
     MessageMP1(char* packed_message, size_t message_size);
-    pair<char*, size_t> Pack(bool pack_data);
+    pair<char*, size_t> Pack(bool pack_data, int wire_version = MP1_WIRE_VERSION);
+private:
+    pair<char*, size_t> PackLegacy(bool pack_data);
+    void UnpackLegacy(char* packed_message, size_t message_size);
+    void UnpackCompact(char* packed_message, size_t message_size);
 };
 
 #endif /* _MP1NODE_H_ */
@@ -4,9 +4,14 @@
  * DESCRIPTION: MP2Node class definition
  **********************************/
 #include "MP2Node.h"
+#include "LsmEngine.h"
 
 const string delimiter = "@@";
 const long timeout = 10;
+// room left in a HANDOFF message for the EmulNet and Message headers
+const size_t handoffHeadroom = 128;
+// resends of a HANDOFF message before the leaving node gives up on its receiver
+const int handoffRetries = 3;
 
 /**
  * constructor
@@ -16,8 +21,60 @@ MP2Node::MP2Node(Member *memberNode, Params *par, EmulNet * emulNet, Log * log,
 	this->par = par;
 	this->emulNet = emulNet;
 	this->log = log;
-	ht = new HashTable();
 	this->memberNode->addr = *address;
+	memset(timeouts, 0, sizeof(timeouts));
+	memset(failures, 0, sizeof(failures));
+	int id = *(int *)address->addr;
+	stabilizationKeys = Metrics::counter("mp2.stabilization.keys", id);
+	handoffKeys = Metrics::counter("mp2.handoff.keys", id);
+	handoffFailures = Metrics::counter("mp2.handoff.failed", id);
+	snapshotFailures = Metrics::counter("mp2.snapshot.failed", id);
+	snapshotFailuresSeen = 0;
+	waitListDepth = Metrics::gauge("mp2.waitlist", id);
+	tableKeys = Metrics::gauge("mp2.table.keys", id);
+	tableBytes = Metrics::gauge("mp2.table.bytes", id);
+	tableEvictions = Metrics::counter("mp2.table.evictions", id);
+	tableExpired = Metrics::counter("mp2.table.expired", id);
+	evictionsSeen = 0;
+	expiredSeen = 0;
+	if ( LSM_STORAGE == par->STORAGE_ENGINE ) {
+		ht = new HashTable(new LsmEngine(storagePath("lsm_", ""), (size_t)par->LSM_MEMTABLE_KB * 1024, par->LSM_MAX_RUNS));
+	}
+	else {
+		ht = new HashTable();
+	}
+	if ( par->MEMORY_BUDGET_KB > 0 ) {
+		ht->setMemoryBudget((size_t)par->MEMORY_BUDGET_KB * 1024, par->EVICT_HIGH_WATERMARK, par->EVICT_LOW_WATERMARK);
+	}
+	if ( par->SNAPSHOT_RESTORE ) {
+		ht->restore(storagePath("snapshot_", ".db"));
+	}
+}
+
+/*
+ * Names of the MessageTypes, for the traffic report
+ */
+const char *const MP2Node::messageTypeNames[] = { "CREATE", "READ", "UPDATE", "DELETE", "REPLY", "READREPLY", "HANDOFF" };
+
+/**
+ * FUNCTION NAME: classifyMessage
+ *
+ * DESCRIPTION: MessageType of a serialized Message, its third field
+ */
+int MP2Node::classifyMessage(const char *data, int size) {
+	const char *end = data + size;
+	const char *field = data;
+	for ( int i = 0; i < 2; i++ ) {
+		field = search(field, end, "::", "::" + 2);
+		if ( field == end ) {
+			return -1;
+		}
+		field += 2;
+	}
+	if ( field == end || !isdigit((unsigned char)*field) ) {
+		return -1;
+	}
+	return *field - '0';
 }
 
 /**
@@ -38,6 +95,8 @@ MP2Node::~MP2Node() {
  * 				3) Calls the Stabilization Protocol
  */
 void MP2Node::updateRing() {
+	TRACE_SCOPE("updateRing", "kv", *(int *)memberNode->addr.addr);
+	ALLOC_SCOPE(ALLOC_KV_RING);
 	/*
 	 * Implement this. Parts of it are already implemented
 	 */
@@ -57,15 +116,18 @@ void MP2Node::updateRing() {
 	sort(curMemList.begin(), curMemList.end());
 
 	set<size_t> failedNodes;
+	bool joined = false;
 	for (auto it1 = ring.begin(), it2 = curMemList.begin(); it1 != ring.end() || it2 != curMemList.end();) {
         if (it1 == ring.end()) {
+            joined = true;
             ++it2;
             continue;
         }
         if (it2 == curMemList.end() || it1->nodeHashCode < it2->nodeHashCode) {
             failedNodes.insert(it1->nodeHashCode);
             ++it1;
-        } else if (it1->nodeHashCode < it2->nodeHashCode) {
+        } else if (it1->nodeHashCode > it2->nodeHashCode) {
+            joined = true;
             ++it2;
         } else {
             ++it1;
@@ -108,7 +170,7 @@ void MP2Node::updateRing() {
         }
     }
 
-    if (failedNodes.count(haveReplicasOf[1].nodeHashCode)) {
+    if (haveReplicasOf.size() == 2 && failedNodes.count(haveReplicasOf[1].nodeHashCode)) {
         haveReplicasOfdiff.push_back(haveReplicasOf[1]);
         if (failedNodes.count(haveReplicasOf[0].nodeHashCode))
             haveReplicasOfdiff.push_back(haveReplicasOf[0]);
@@ -127,7 +189,14 @@ void MP2Node::updateRing() {
         haveReplicasOfHashes.insert(node.nodeHashCode);
 
 
-    bool needStab = (!hasMyreplicasDiff.empty() || !haveReplicasOfdiff.empty()) && !ht->isEmpty();
+    // a node that left gracefully has handed its ranges off already, see leave
+    size_t departed = 0;
+    for (auto& addr : memberNode->leftMembers)
+        departed += failedNodes.count(Node(addr).nodeHashCode);
+    memberNode->leftMembers.clear();
+    bool handedOff = !joined && !failedNodes.empty() && departed == failedNodes.size();
+
+    bool needStab = (!hasMyreplicasDiff.empty() || !haveReplicasOfdiff.empty()) && !ht->isEmpty() && !handedOff;
     if (needStab)
         stabilizationProtocol(oldRing, hasMyreplicasDiff, haveReplicasOfdiff);
 	/*
@@ -169,7 +238,7 @@ vector<Node> MP2Node::getMembershipList() {
  * RETURNS:
  * size_t position on the ring
  */
-size_t MP2Node::hashFunction(string key) {
+size_t MP2Node::hashFunction(const string& key) {
 	std::hash<string> hashFunc;
 	size_t ret = hashFunc(key);
 	return ret%RING_SIZE;
@@ -183,14 +252,19 @@ size_t MP2Node::hashFunction(string key) {
  * 				1) Constructs the message
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
+ * 				A nonzero ttl makes the key expire ttl ticks after the replicas store it.
  */
-void MP2Node::clientCreate(string key, string value) {
-	Message createMessage(g_transID, memberNode->addr, CREATE, key, value);
+void MP2Node::clientCreate(string key, string value, int ttl) {
+	ALLOC_SCOPE(ALLOC_KV_CLIENT);
 	vector<Node> nodes = findNodes(key);
+	// key and value move into the message and from there into the transaction
+	Message createMessage(g_transID, memberNode->addr, CREATE, move(key), move(value));
+	createMessage.ttl = ttl;
+	string frame = createMessage.toString();
     for (auto& node : nodes) {
-        emulNet->ENsend(&memberNode->addr, node.getAddress(), createMessage.toString());
+        emulNet->ENsend(&memberNode->addr, node.getAddress(), frame);
     }
-	WaitList.insert(make_pair(g_transID, TransData(g_transID, par->getcurrtime(), CREATE, key, value)));
+	WaitList.insert(make_pair(g_transID, TransData(g_transID, par->getcurrtime(), CREATE, move(createMessage.key), move(createMessage.value))));
 	++g_transID;
 }
 
@@ -204,12 +278,14 @@ void MP2Node::clientCreate(string key, string value) {
  * 				3) Sends a message to the replica
  */
 void MP2Node::clientRead(string key){
-	Message createMessage(g_transID, memberNode->addr, READ, key);
+	ALLOC_SCOPE(ALLOC_KV_CLIENT);
 	vector<Node> nodes = findNodes(key);
+	Message createMessage(g_transID, memberNode->addr, READ, move(key));
+	string frame = createMessage.toString();
     for (auto& node : nodes) {
-        emulNet->ENsend(&memberNode->addr, node.getAddress(), createMessage.toString());
+        emulNet->ENsend(&memberNode->addr, node.getAddress(), frame);
     }
-	WaitList.insert(make_pair(g_transID, TransData(g_transID, par->getcurrtime(), READ, key)));
+	WaitList.insert(make_pair(g_transID, TransData(g_transID, par->getcurrtime(), READ, move(createMessage.key))));
 	++g_transID;
 }
 
@@ -221,14 +297,19 @@ void MP2Node::clientRead(string key){
  * 				1) Constructs the message
  * 				2) Finds the replicas of this key
  * 				3) Sends a message to the replica
+ * 				The update replaces the expiry of the key as well: with ttl 0 it never expires.
  */
-void MP2Node::clientUpdate(string key, string value){
-	Message createMessage(g_transID, memberNode->addr, UPDATE, key, value);
+void MP2Node::clientUpdate(string key, string value, int ttl){
+	ALLOC_SCOPE(ALLOC_KV_CLIENT);
 	vector<Node> nodes = findNodes(key);
+	// key and value move into the message and from there into the transaction
+	Message createMessage(g_transID, memberNode->addr, UPDATE, move(key), move(value));
+	createMessage.ttl = ttl;
+	string frame = createMessage.toString();
     for (auto& node : nodes) {
-        emulNet->ENsend(&memberNode->addr, node.getAddress(), createMessage.toString());
+        emulNet->ENsend(&memberNode->addr, node.getAddress(), frame);
     }
-	WaitList.insert(make_pair(g_transID, TransData(g_transID, par->getcurrtime(), UPDATE, key, value)));
+	WaitList.insert(make_pair(g_transID, TransData(g_transID, par->getcurrtime(), UPDATE, move(createMessage.key), move(createMessage.value))));
 	++g_transID;
 }
 
@@ -242,12 +323,14 @@ void MP2Node::clientUpdate(string key, string value){
  * 				3) Sends a message to the replica
  */
 void MP2Node::clientDelete(string key){
-	Message createMessage(g_transID, memberNode->addr, DELETE, key);
+	ALLOC_SCOPE(ALLOC_KV_CLIENT);
 	vector<Node> nodes = findNodes(key);
+	Message createMessage(g_transID, memberNode->addr, DELETE, move(key));
+	string frame = createMessage.toString();
     for (auto& node : nodes) {
-        emulNet->ENsend(&memberNode->addr, node.getAddress(), createMessage.toString());
+        emulNet->ENsend(&memberNode->addr, node.getAddress(), frame);
     }
-	WaitList.insert(make_pair(g_transID, TransData(g_transID, par->getcurrtime(), DELETE, key)));
+	WaitList.insert(make_pair(g_transID, TransData(g_transID, par->getcurrtime(), DELETE, move(createMessage.key))));
 	++g_transID;
 }
 
@@ -259,9 +342,8 @@ void MP2Node::clientDelete(string key){
  * 			   	1) Inserts key value into the local hash table
  * 			   	2) Return true or false based on success or failure
  */
-bool MP2Node::createKeyValue(string key, string value, int transId/*, ReplicaType replica*/) {
-    string idVal = to_string(transId) + delimiter + value;
-	return ht->create(key, idVal);
+bool MP2Node::createKeyValue(const string& key, const string& value, int transId, int ttl/*, ReplicaType replica*/) {
+	return ht->create(key, versionedValue(transId, value), expiryTime(ttl));
 }
 
 /**
@@ -272,7 +354,7 @@ bool MP2Node::createKeyValue(string key, string value, int transId/*, ReplicaTyp
  * 			    1) Read key from local hash table
  * 			    2) Return value
  */
-string MP2Node::readKey(string key) {
+string MP2Node::readKey(const string& key) {
 	return ht->read(key);
 }
 
@@ -284,8 +366,34 @@ string MP2Node::readKey(string key) {
  * 				1) Update the key to the new value in the local hash table
  * 				2) Return true or false based on success or failure
  */
-bool MP2Node::updateKeyValue(string key, string value/*, ReplicaType replica*/) {
-	return ht->update(key, value);
+bool MP2Node::updateKeyValue(const string& key, const string& value, int transId, int ttl/*, ReplicaType replica*/) {
+	// stored like createKeyValue does, so that reads can pick the latest version
+	return ht->update(key, versionedValue(transId, value), expiryTime(ttl));
+}
+
+/**
+ * FUNCTION NAME: versionedValue
+ *
+ * DESCRIPTION: value prefixed with the transaction that wrote it, built in one allocation
+ */
+string MP2Node::versionedValue(int transId, const string& value) {
+	char id[16];
+	int idLength = snprintf(id, sizeof(id), "%d", transId);
+	string idVal;
+	idVal.reserve(idLength + delimiter.size() + value.size());
+	idVal.append(id, idLength);
+	idVal.append(delimiter);
+	idVal.append(value);
+	return idVal;
+}
+
+/**
+ * FUNCTION NAME: expiryTime
+ *
+ * DESCRIPTION: Absolute expiry time of a key stored now with the given ttl, 0 for never
+ */
+int MP2Node::expiryTime(int ttl) {
+	return ttl > 0 ? par->getcurrtime() + ttl : 0;
 }
 
 /**
@@ -296,12 +404,12 @@ bool MP2Node::updateKeyValue(string key, string value/*, ReplicaType replica*/)
  * 				1) Delete the key from the local hash table
  * 				2) Return true or false based on success or failure
  */
-bool MP2Node::deleteKey(string key) {
+bool MP2Node::deleteKey(const string& key) {
 	return ht->deleteKey(key);
 }
 
 
-void MP2Node::HandleReplies(Message reply) {
+void MP2Node::HandleReplies(Message& reply) {
     auto it = WaitList.find(reply.transID);
     if (it != WaitList.end()) {
         TransData& data = it->second;
@@ -310,8 +418,8 @@ void MP2Node::HandleReplies(Message reply) {
                 {
                     ++data.replyNumber;
                     if (data.replyNumber >= 2) { //quorum
-                        log->logCreateSuccess(&memberNode->addr, true, reply.transID, data.key, data.value);
-                        WaitList.erase(it);
+                        LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logCreateSuccess(&memberNode->addr, true, reply.transID, data.key, data.value));
+                        finishTransaction(it, true);
                     }
                 }
                 break;
@@ -320,12 +428,12 @@ void MP2Node::HandleReplies(Message reply) {
                     if (reply.success) {
                         ++data.replyNumber;
                         if (data.replyNumber == 3) { //all replicas
-                            log->logDeleteSuccess(&memberNode->addr, true, reply.transID, data.key);
-                            WaitList.erase(it);
+                            LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logDeleteSuccess(&memberNode->addr, true, reply.transID, data.key));
+                            finishTransaction(it, true);
                         }
                     } else {
-                        log->logDeleteFail(&memberNode->addr, true, reply.transID, data.key);
-                        WaitList.erase(it);
+                        LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logDeleteFail(&memberNode->addr, true, reply.transID, data.key));
+                        finishTransaction(it, false);
                     }
                 }
                 break;
@@ -336,19 +444,22 @@ void MP2Node::HandleReplies(Message reply) {
                         ++data.replyNumber;
 
                         size_t pos = idVal.find(delimiter);
-                        int transId = stoi(idVal.substr(0, pos));
-                        string value = idVal.substr(pos + 2);
-                        if (transId > data.bestValue.first)
-                            data.bestValue = make_pair(transId, value);
+                        int transId = atoi(idVal.c_str());
+                        if (transId > data.bestValue.first) {
+                            // the reply is not used after this, so strip the version in place
+                            idVal.erase(0, pos + delimiter.size());
+                            data.bestValue.first = transId;
+                            data.bestValue.second.swap(idVal);
+                        }
                         if (data.replyNumber >= 2) {
-                            log->logReadSuccess(&memberNode->addr, true, reply.transID, data.key, data.bestValue.second);
-                            WaitList.erase(it);
+                            LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logReadSuccess(&memberNode->addr, true, reply.transID, data.key, data.bestValue.second));
+                            finishTransaction(it, true);
                         }
                     } else {
                         ++data.failedNumber;
                         if (data.failedNumber > 1) {
-                            log->logReadFail(&memberNode->addr, true, reply.transID, data.key);
-                            WaitList.erase(it);
+                            LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logReadFail(&memberNode->addr, true, reply.transID, data.key));
+                            finishTransaction(it, false);
                         }
                     }
                 }
@@ -358,46 +469,107 @@ void MP2Node::HandleReplies(Message reply) {
                     if (reply.success) {
                         ++data.replyNumber;
                         if (data.replyNumber >= 2) {
-                            log->logUpdateSuccess(&memberNode->addr, true, reply.transID, data.key, data.value);
-                            WaitList.erase(it);
+                            LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logUpdateSuccess(&memberNode->addr, true, reply.transID, data.key, data.value));
+                            finishTransaction(it, true);
                         }
                     } else {
                         ++data.failedNumber;
                         if (data.failedNumber > 1) {
-                            log->logUpdateFail(&memberNode->addr, true, reply.transID, data.key, data.value);
-                            WaitList.erase(it);
+                            LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logUpdateFail(&memberNode->addr, true, reply.transID, data.key, data.value));
+                            finishTransaction(it, false);
                         }
                     }
                 }
                 break;
+            case (HANDOFF) :
+                // a handoff is no client transaction, see checkHandoffs
+                break;
         }
     }
 }
 
 void MP2Node::checkTimeouts() {
     long curTimestamp = par->getcurrtime();
-    for (auto it = WaitList.begin(); it != WaitList.end(); ++it) {
+    for (auto it = WaitList.begin(); it != WaitList.end();) {
         TransData& data = it->second;
-        if (curTimestamp - data.timestamp <= timeout)
+        if (curTimestamp - data.timestamp <= timeout) {
+            ++it;
             continue;
+        }
         switch (data.type) {
             case (CREATE) :
-                log->logCreateFail(&memberNode->addr, true, data.transId, data.key, data.value);
+                LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logCreateFail(&memberNode->addr, true, data.transId, data.key, data.value));
                 break;
             case (DELETE) :
-                log->logDeleteFail(&memberNode->addr, true, data.transId, data.key);
+                LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logDeleteFail(&memberNode->addr, true, data.transId, data.key));
                 break;
             case (READ) :
-                log->logReadFail(&memberNode->addr, true, data.transId, data.key);
+                LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logReadFail(&memberNode->addr, true, data.transId, data.key));
                 break;
             case (UPDATE) :
-                log->logUpdateFail(&memberNode->addr, true, data.transId, data.key, data.value);
+                LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logUpdateFail(&memberNode->addr, true, data.transId, data.key, data.value));
+                break;
+            case (HANDOFF) :
                 break;
         }
-        WaitList.erase(it);
+        timeouts[data.type]++;
+        it = WaitList.erase(it);
     }
 }
 
+/**
+ * FUNCTION NAME: finishTransaction
+ *
+ * DESCRIPTION: Record how long the transaction took and how it ended, and drop it
+ * 				from the wait list
+ */
+void MP2Node::finishTransaction(TransMap::iterator it, bool success) {
+    TransData& data = it->second;
+    latency[data.type].record(par->getcurrtime() - data.timestamp);
+    if (!success)
+        failures[data.type]++;
+    WaitList.erase(it);
+}
+
+/**
+ * FUNCTION NAME: getLatency
+ *
+ * DESCRIPTION: Latency histogram of the transactions of the given type this node coordinated
+ */
+const Histogram& MP2Node::getLatency(MessageType type) {
+    return latency[type];
+}
+
+/**
+ * FUNCTION NAME: getTimeouts
+ *
+ * DESCRIPTION: Number of transactions of the given type that timed out
+ */
+unsigned long MP2Node::getTimeouts(MessageType type) {
+    return timeouts[type];
+}
+
+/**
+ * FUNCTION NAME: getFailures
+ *
+ * DESCRIPTION: Number of transactions of the given type that completed with a failure
+ */
+unsigned long MP2Node::getFailures(MessageType type) {
+    return failures[type];
+}
+
+/**
+ * FUNCTION NAME: resetStats
+ *
+ * DESCRIPTION: Forget the latencies, timeouts and failures recorded so far
+ */
+void MP2Node::resetStats() {
+    for (int type = CREATE; type <= DELETE; type++)
+        latency[type].reset();
+    memset(timeouts, 0, sizeof(timeouts));
+    memset(failures, 0, sizeof(failures));
+}
+
 /**
  * FUNCTION NAME: checkMessages
  *
@@ -407,6 +579,7 @@ void MP2Node::checkTimeouts() {
  * 				2) Handles the messages according to message types
  */
 void MP2Node::checkMessages() {
+	TRACE_SCOPE("checkMessages", "kv", *(int *)memberNode->addr.addr);
 	/*
 	 * Implement this. Parts of it are already implemented
 	 */
@@ -417,8 +590,12 @@ void MP2Node::checkMessages() {
 	 * Declare your local variables here
 	 */
 
+	// drop the keys whose ttl ran out before serving anything this tick
+	ht->expire(par->getcurrtime());
+
 	// dequeue all messages and handle them
 	while ( !memberNode->mp2q.empty() ) {
+		ALLOC_SCOPE(ALLOC_KV_MESSAGE);
 		/*
 		 * Pop a message from the queue
 		 */
@@ -426,19 +603,20 @@ void MP2Node::checkMessages() {
 		size = memberNode->mp2q.front().size;
 		memberNode->mp2q.pop();
 
-		string message(data, data + size);
-		Message msg(message);
+		Message msg(data, size);
 
 		switch (msg.type) {
             case (CREATE) :
                 {
-                    bool success = createKeyValue(msg.key, msg.value, msg.transID);
+                    bool success = createKeyValue(msg.key, msg.value, msg.transID, msg.ttl);
                     Message reply(msg.transID, memberNode->addr, REPLY, success);
                     emulNet->ENsend(&memberNode->addr, &msg.fromAddr, reply.toString());
+                    if (success && memberNode->bLeaving)
+                        forwardWrite(msg);
                     if (success)
-                        log->logCreateSuccess(&memberNode->addr, false, msg.transID, msg.key, msg.value);
+                        LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logCreateSuccess(&memberNode->addr, false, msg.transID, msg.key, msg.value));
                     else
-                        log->logCreateFail(&memberNode->addr, false, msg.transID, msg.key, msg.value);
+                        LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logCreateFail(&memberNode->addr, false, msg.transID, msg.key, msg.value));
                 }
                 break;
             case (DELETE) :
@@ -446,45 +624,61 @@ void MP2Node::checkMessages() {
                     bool success = deleteKey(msg.key);
                     Message reply(msg.transID, memberNode->addr, REPLY, success);
                     emulNet->ENsend(&memberNode->addr, &msg.fromAddr, reply.toString());
+                    if (success && memberNode->bLeaving)
+                        forwardWrite(msg);
                     if (success)
-                        log->logDeleteSuccess(&memberNode->addr, false, msg.transID, msg.key);
+                        LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logDeleteSuccess(&memberNode->addr, false, msg.transID, msg.key));
                     else
-                        log->logDeleteFail(&memberNode->addr, false, msg.transID, msg.key);
+                        LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logDeleteFail(&memberNode->addr, false, msg.transID, msg.key));
                 }
                 break;
             case (READ) :
                 {
-                    string idVal = readKey(msg.key);
-                    Message reply(msg.transID, memberNode->addr, idVal);
+                    Message reply(msg.transID, memberNode->addr, readKey(msg.key));
                     emulNet->ENsend(&memberNode->addr, &msg.fromAddr, reply.toString());
+                    const string& idVal = reply.value;
                     if (!idVal.empty()) {
-                        size_t pos = idVal.find(delimiter);
-                        string value = idVal.substr(pos + 2);
-                        log->logReadSuccess(&memberNode->addr, false, msg.transID, msg.key, value);
+                        LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logReadSuccess(&memberNode->addr, false, msg.transID, msg.key, idVal.substr(idVal.find(delimiter) + 2)));
                     } else
-                        log->logReadFail(&memberNode->addr, false, msg.transID, msg.key);
+                        LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logReadFail(&memberNode->addr, false, msg.transID, msg.key));
                 }
                 break;
             case (UPDATE) :
                 {
-                    bool success = updateKeyValue(msg.key, msg.value);
+                    bool success = updateKeyValue(msg.key, msg.value, msg.transID, msg.ttl);
                     Message reply(msg.transID, memberNode->addr, REPLY, success);
                     emulNet->ENsend(&memberNode->addr, &msg.fromAddr, reply.toString());
+                    if (success && memberNode->bLeaving)
+                        forwardWrite(msg);
                     if (success)
-                        log->logUpdateSuccess(&memberNode->addr, false, msg.transID, msg.key, msg.value);
+                        LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logUpdateSuccess(&memberNode->addr, false, msg.transID, msg.key, msg.value));
                     else
-                        log->logUpdateFail(&memberNode->addr, false, msg.transID, msg.key, msg.value);
+                        LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->logUpdateFail(&memberNode->addr, false, msg.transID, msg.key, msg.value));
                 }
                 break;
             case (REPLY) :
-                HandleReplies(msg);
+                {
+                    auto pending = handoffs.find(msg.transID);
+                    if (pending == handoffs.end())
+                        HandleReplies(msg);
+                    // a forwarded DELETE that got there before the handoff of its key is resent
+                    else if (msg.success)
+                        handoffs.erase(pending);
+                }
                 break;
             case (READREPLY) :
                 HandleReplies(msg);
                 break;
+            case (HANDOFF) :
+                handleHandoff(msg);
+                break;
 		}
 	}
 	checkTimeouts();
+	if (memberNode->bLeaving)
+		checkHandoffs();
+	checkStorage();
+	updateMetrics();
 
 	/*
 	 * This function should also ensure all READ and UPDATE operation
@@ -498,16 +692,17 @@ void MP2Node::checkMessages() {
  * DESCRIPTION: Find the replicas of the given keyfunction
  * 				This function is responsible for finding the replicas of a key
  */
-vector<Node> MP2Node::findNodes(string key) {
+vector<Node> MP2Node::findNodes(const string& key) {
 	return findNodes(key, ring);
 }
 
-vector<Node> MP2Node::findNodes(string key, vector<Node>& newRing) {
+vector<Node> MP2Node::findNodes(const string& key, vector<Node>& newRing) {
 	size_t pos = hashFunction(key);
 	vector<Node> addr_vec;
-	if (ring.size() >= 3) {
+	addr_vec.reserve(3);
+	if (newRing.size() >= 3) {
 		// if pos <= min || pos > max, the leader is the min
-		if (pos <= newRing.at(0).getHashCode() || pos > newRing.at(ring.size()-1).getHashCode()) {
+		if (pos <= newRing.at(0).getHashCode() || pos > newRing.at(newRing.size()-1).getHashCode()) {
 			addr_vec.emplace_back(newRing.at(0));
 			addr_vec.emplace_back(newRing.at(1));
 			addr_vec.emplace_back(newRing.at(2));
@@ -515,11 +710,11 @@ vector<Node> MP2Node::findNodes(string key, vector<Node>& newRing) {
 		else {
 			// go through the ring until pos <= node
 			for (int i=1; i<newRing.size(); i++){
-				Node addr = newRing.at(i);
+				Node& addr = newRing.at(i);
 				if (pos <= addr.getHashCode()) {
 					addr_vec.emplace_back(addr);
-					addr_vec.emplace_back(newRing.at((i+1)%ring.size()));
-					addr_vec.emplace_back(newRing.at((i+2)%ring.size()));
+					addr_vec.emplace_back(newRing.at((i+1)%newRing.size()));
+					addr_vec.emplace_back(newRing.at((i+2)%newRing.size()));
 					break;
 				}
 			}
@@ -561,24 +756,276 @@ int MP2Node::enqueueWrapper(void *env, char *buff, int size) {
  *				Note:- "CORRECT" replicas implies that every key is replicated in its two neighboring nodes in the ring
  */
 void MP2Node::stabilizationProtocol(vector<Node>& oldRing, vector<Node>& hasMyReplicasDiff, vector<Node>& haveReplicasOfDiff) {
+    TRACE_SCOPE("stabilizationProtocol", "stabilization", *(int *)memberNode->addr.addr);
+    ALLOC_SCOPE(ALLOC_KV_STABILIZATION);
     size_t myHash = Node(memberNode->addr).nodeHashCode;
-    for (auto item : ht->hashTable) {
-        if (findNodes(item.first).front().nodeHashCode == myHash) {
-            Message createMessage(g_transID, memberNode->addr, CREATE, item.first, item.second);
-            for (auto node: hasMyReplicasDiff) {
-                emulNet->ENsend(&memberNode->addr, node.getAddress(), createMessage.toString());
+    ht->forEach([&](const string& key, const string& value) {
+        vector<Node> replicas = findNodes(key);
+        if (!replicas.empty() && replicas.front().nodeHashCode == myHash) {
+            Message createMessage(g_transID, memberNode->addr, CREATE, key, value);
+            createMessage.ttl = remainingTtl(key);
+            string frame = createMessage.toString();
+            for (auto& node: hasMyReplicasDiff) {
+                emulNet->ENsend(&memberNode->addr, node.getAddress(), frame);
             }
+            stabilizationKeys->add(hasMyReplicasDiff.size());
         }
-    }
-    for (auto item : ht->hashTable) {
+    });
+    ht->forEach([&](const string& key, const string& value) {
+        vector<Node> oldReplicas = findNodes(key, oldRing);
+        if (oldReplicas.empty())
+            return;
         for (auto node : haveReplicasOfDiff) {
-            if (findNodes(item.first, oldRing).front().nodeHashCode == node.nodeHashCode) {
-                Message createMessage(g_transID, memberNode->addr, CREATE, item.first, item.second);
-                for (auto node: hasMyReplicas) {
-                    emulNet->ENsend(&memberNode->addr, node.getAddress(), createMessage.toString());
+            if (oldReplicas.front().nodeHashCode == node.nodeHashCode) {
+                Message createMessage(g_transID, memberNode->addr, CREATE, key, value);
+                createMessage.ttl = remainingTtl(key);
+                string frame = createMessage.toString();
+                for (auto& node: hasMyReplicas) {
+                    emulNet->ENsend(&memberNode->addr, node.getAddress(), frame);
                 }
+                stabilizationKeys->add(hasMyReplicas.size());
+            }
+        }
+    });
+
+}
+
+/**
+ * FUNCTION NAME: leave
+ *
+ * DESCRIPTION: Start a graceful leave. Every key this node holds gets a new replica
+ * 				once the node is off the ring; the keys are sent to those new owners
+ * 				in bulk, a HANDOFF message per MAX_MSG_SIZE of keys, before the
+ * 				membership protocol announces the leave. Peers then skip the
+ * 				stabilization protocol for this node, so a planned shutdown moves
+ * 				each key once instead of re-replicating it key by key.
+ * 				The node stops coordinating but keeps serving, and forwards the
+ * 				writes it serves meanwhile, see forwardWrite. See checkHandoffs for
+ * 				when it leaves.
+ */
+void MP2Node::leave() {
+    if (memberNode->bLeaving || memberNode->bFailed)
+        return;
+    memberNode->bLeaving = true;
+    LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->LOG(&memberNode->addr, "Leaving, handing off %lu keys at time %d", ht->currentSize(),
+            par->getcurrtime()));
+    vector<Node> newRing = ringAfterLeave();
+
+    size_t limit = par->MAX_MSG_SIZE > (int)handoffHeadroom ? par->MAX_MSG_SIZE - handoffHeadroom : 0;
+    vector<Node> owners;
+    vector<Message> batches;
+    ht->forEach([&](const string& key, const string& value) {
+        int ttl = remainingTtl(key);
+        for (auto& owner : newOwners(key, newRing)) {
+            size_t i = 0;
+            while (i < owners.size() && owners[i].nodeHashCode != owner.nodeHashCode)
+                ++i;
+            if (i == owners.size()) {
+                owners.push_back(owner);
+                batches.push_back(Message(g_transID++, memberNode->addr));
+            }
+            else if (!batches[i].value.empty() && batches[i].value.size() + key.size() + value.size() + 32 > limit) {
+                sendHandoff(batches[i], owners[i]);
+                batches[i] = Message(g_transID++, memberNode->addr);
             }
+            batches[i].addEntry(key, value, ttl);
+            handoffKeys->add();
+        }
+    });
+    for (size_t i = 0; i < batches.size(); i++)
+        sendHandoff(batches[i], owners[i]);
+}
+
+/**
+ * FUNCTION NAME: ringAfterLeave
+ *
+ * DESCRIPTION: The ring without this node
+ */
+vector<Node> MP2Node::ringAfterLeave() {
+    size_t myHash = Node(memberNode->addr).nodeHashCode;
+    vector<Node> newRing;
+    for (auto& node : ring) {
+        if (node.nodeHashCode != myHash)
+            newRing.push_back(node);
+    }
+    return newRing;
+}
+
+/**
+ * FUNCTION NAME: newOwners
+ *
+ * DESCRIPTION: Replicas of key on newRing that are not replicas of it now
+ */
+vector<Node> MP2Node::newOwners(const string& key, vector<Node>& newRing) {
+    vector<Node> oldReplicas = findNodes(key);
+    vector<Node> owners;
+    for (auto& owner : findNodes(key, newRing)) {
+        bool replica = false;
+        for (auto& node : oldReplicas)
+            replica = replica || node.nodeHashCode == owner.nodeHashCode;
+        if (!replica)
+            owners.push_back(owner);
+    }
+    return owners;
+}
+
+/**
+ * FUNCTION NAME: forwardWrite
+ *
+ * DESCRIPTION: While leaving, pass a replica write on to the new owners of its key.
+ * 				Coordinators keep sending to this node until they see its leave, and
+ * 				the handoff went out before the write. A create or update travels as
+ * 				a HANDOFF entry, so it applies in version order whether or not the
+ * 				handoff of its key got there first; a DELETE is resent until it finds
+ * 				the key. Both are tracked like handoffs.
+ */
+void MP2Node::forwardWrite(const Message& msg) {
+    vector<Node> newRing = ringAfterLeave();
+    for (auto& owner : newOwners(msg.key, newRing)) {
+        if (DELETE == msg.type) {
+            Message forward(g_transID++, memberNode->addr, DELETE, msg.key);
+            sendHandoff(forward, owner);
+        }
+        else {
+            Message forward(g_transID++, memberNode->addr);
+            forward.addEntry(msg.key, versionedValue(msg.transID, msg.value), msg.ttl);
+            sendHandoff(forward, owner);
+        }
+    }
+}
+
+/**
+ * FUNCTION NAME: sendHandoff
+ *
+ * DESCRIPTION: Send a HANDOFF message and wait for its REPLY
+ */
+void MP2Node::sendHandoff(Message& batch, Node& to) {
+    PendingHandoff pending = { *to.getAddress(), batch.toString(), par->getcurrtime(), 0 };
+    emulNet->ENsend(&memberNode->addr, &pending.to, pending.frame);
+    handoffs.insert(make_pair(batch.transID, move(pending)));
+}
+
+/**
+ * FUNCTION NAME: checkHandoffs
+ *
+ * DESCRIPTION: Resend the HANDOFF messages without a REPLY after the timeout, up to
+ * 				handoffRetries times. Once none is left, and the transactions this
+ * 				node coordinated are over, the membership protocol may leave. A
+ * 				handoff given up on makes it leave unannounced instead, so that peers
+ * 				take it for failed and run the stabilization protocol.
+ */
+void MP2Node::checkHandoffs() {
+    long now = par->getcurrtime();
+    for (auto it = handoffs.begin(); it != handoffs.end();) {
+        PendingHandoff& pending = it->second;
+        if (now - pending.sentAt <= timeout) {
+            ++it;
+            continue;
+        }
+        if (pending.retries >= handoffRetries) {
+            LOG_IF(LOG_LEVEL_WARN, LOG_KV, log->LOG(&memberNode->addr, "Handoff %d to %s was never acknowledged", it->first,
+                    pending.to.getAddress().c_str()));
+            handoffFailures->add();
+            memberNode->bHandoffFailed = true;
+            it = handoffs.erase(it);
+            continue;
         }
+        emulNet->ENsend(&memberNode->addr, &pending.to, pending.frame);
+        pending.sentAt = now;
+        ++pending.retries;
+        ++it;
     }
+    memberNode->pendingHandoffs = (int)handoffs.size();
+    if (handoffs.empty() && WaitList.empty() && !memberNode->bHandedOff) {
+        memberNode->bHandedOff = true;
+        LOG_IF(LOG_LEVEL_INFO, LOG_KV, log->LOG(&memberNode->addr, "Handoff acknowledged at time %d", par->getcurrtime()));
+    }
+}
+
+/**
+ * FUNCTION NAME: handleHandoff
+ *
+ * DESCRIPTION: Store the keys a leaving node handed to this one, keeping the
+ * 				version a key already has here when it is newer, and acknowledge
+ */
+void MP2Node::handleHandoff(Message& msg) {
+    vector<HandoffEntry> entries = msg.entries();
+    for (auto& entry : entries) {
+        string current = readKey(entry.key);
+        if (current.empty())
+            ht->create(entry.key, move(entry.value), expiryTime(entry.ttl));
+        else if (atoi(entry.value.c_str()) > atoi(current.c_str()))
+            ht->update(entry.key, move(entry.value), expiryTime(entry.ttl));
+    }
+    Message reply(msg.transID, memberNode->addr, REPLY, true);
+    emulNet->ENsend(&memberNode->addr, &msg.fromAddr, reply.toString());
+    LOG_IF(LOG_LEVEL_DEBUG, LOG_KV, log->LOG(&memberNode->addr, "Took %zu handed off keys from %s", entries.size(),
+            msg.fromAddr.getAddress().c_str()));
+}
+
+/**
+ * FUNCTION NAME: remainingTtl
+ *
+ * DESCRIPTION: Ticks left before key expires, so that replicas made by the
+ * 				stabilization protocol expire together with this one. 0 for never.
+ */
+int MP2Node::remainingTtl(const string& key) {
+	int expiresAt = ht->expiresAt(key);
+	return expiresAt > 0 ? max(expiresAt - par->getcurrtime(), 1) : 0;
+}
 
+/**
+ * FUNCTION NAME: updateMetrics
+ *
+ * DESCRIPTION: Refresh the gauges of this node and add the evictions and
+ * 				expiries of the table since the last tick to its counters
+ */
+void MP2Node::updateMetrics() {
+	waitListDepth->set(WaitList.size());
+	tableKeys->set(ht->currentSize());
+	tableBytes->set(ht->memoryUsed());
+	unsigned long evictions = ht->evictions();
+	tableEvictions->add(evictions - evictionsSeen);
+	evictionsSeen = evictions;
+	unsigned long expired = ht->expired();
+	tableExpired->add(expired - expiredSeen);
+	expiredSeen = expired;
+}
+
+/**
+ * FUNCTION NAME: storagePath
+ *
+ * DESCRIPTION: Name of a file or directory holding this node's data
+ */
+string MP2Node::storagePath(const string& prefix, const string& suffix) {
+	int id = 0;
+	short port;
+	memcpy(&id, &memberNode->addr.addr[0], sizeof(int));
+	memcpy(&port, &memberNode->addr.addr[4], sizeof(short));
+	return prefix + to_string(id) + "_" + to_string(port) + suffix;
+}
+
+/**
+ * FUNCTION NAME: checkStorage
+ *
+ * DESCRIPTION: Let the storage engine install finished background work and
+ * 				start a new snapshot every SNAPSHOT_INTERVAL ticks.
+ * 				Neither step waits for disk I/O. Snapshots that failed or
+ * 				could not be started are logged and counted.
+ */
+void MP2Node::checkStorage() {
+	ht->maintain();
+	unsigned long failed = ht->snapshotFailures();
+	if ( failed > snapshotFailuresSeen ) {
+		LOG_IF(LOG_LEVEL_WARN, LOG_KV, log->LOG(&memberNode->addr, "Snapshot to %s failed, %lu so far",
+				storagePath("snapshot_", ".db").c_str(), failed));
+		snapshotFailures->add(failed - snapshotFailuresSeen);
+		snapshotFailuresSeen = failed;
+	}
+	if ( par->SNAPSHOT_INTERVAL > 0 && par->getcurrtime() % par->SNAPSHOT_INTERVAL == 0 ) {
+		if ( !ht->snapshot(storagePath("snapshot_", ".db")) ) {
+			LOG_IF(LOG_LEVEL_WARN, LOG_KV, log->LOG(&memberNode->addr, "Snapshot at time %d could not be started", par->getcurrtime()));
+			snapshotFailures->add();
+		}
+	}
 }
@@ -18,6 +18,10 @@
 #include "Params.h"
 #include "Message.h"
 #include "Queue.h"
+#include "Trace.h"
+#include "AllocProfile.h"
+#include "Histogram.h"
+#include "Metrics.h"
 
 #include <set>
 using namespace std;
@@ -36,7 +40,7 @@ struct TransData {
         transId(id),
         timestamp(ts),
         type(t),
-        key(k),
+        key(move(k)),
         replyNumber(0),
         failedNumber(0),
         bestValue(make_pair(-1, ""))
@@ -46,8 +50,8 @@ struct TransData {
         transId(id),
         timestamp(ts),
         type(t),
-        key(k),
-        value(v),
+        key(move(k)),
+        value(move(v)),
         replyNumber(0),
         failedNumber(0),
         bestValue(make_pair(-1, ""))
@@ -56,6 +60,19 @@ struct TransData {
 
 typedef map<int, TransData> TransMap;
 
+/**
+ * STRUCT NAME: PendingHandoff
+ *
+ * DESCRIPTION: A HANDOFF message, or a write forwarded by a leaving node, until
+ * 				its REPLY comes
+ */
+struct PendingHandoff {
+    Address to;
+    string frame;
+    long sentAt;
+    int retries;
+};
+
 /**
  * CLASS NAME: MP2Node
  *
@@ -91,6 +108,39 @@ private:
 
 	TransMap WaitList;
 
+	// ticks from sending a request to its outcome, per MessageType (CREATE to DELETE)
+	Histogram latency[DELETE + 1];
+	unsigned long timeouts[DELETE + 1];
+	// transactions that got a failure reply, not counting timeouts
+	unsigned long failures[DELETE + 1];
+	void finishTransaction(TransMap::iterator it, bool success);
+
+	// graceful leave: HANDOFF messages waiting for their REPLY, by transaction
+	map<int, PendingHandoff> handoffs;
+	void sendHandoff(Message& batch, Node& to);
+	vector<Node> ringAfterLeave();
+	vector<Node> newOwners(const string& key, vector<Node>& newRing);
+	void forwardWrite(const Message& msg);
+	void checkHandoffs();
+	void handleHandoff(Message& msg);
+
+	// metrics
+	Counter *stabilizationKeys;
+	Counter *handoffKeys;
+	Counter *handoffFailures;
+	Counter *snapshotFailures;
+	// snapshot failures of the table already reported
+	unsigned long snapshotFailuresSeen;
+	Gauge *waitListDepth;
+	Gauge *tableKeys;
+	Gauge *tableBytes;
+	Counter *tableEvictions;
+	Counter *tableExpired;
+	// table evictions and expiries already added to the counters
+	unsigned long evictionsSeen;
+	unsigned long expiredSeen;
+	void updateMetrics();
+
 public:
 	MP2Node(Member *memberNode, Params *par, EmulNet *emulNet, Log *log, Address *addressOfMember);
 	Member * getMemberNode() {
@@ -100,13 +150,13 @@ public:
 	// ring functionalities
 	void updateRing();
 	vector<Node> getMembershipList();
-	size_t hashFunction(string key);
+	size_t hashFunction(const string& key);
 	void findNeighbors();
 
-	// client side CRUD APIs
-	void clientCreate(string key, string value);
+	// client side CRUD APIs; key and value are taken by value and moved, pass temporaries to avoid copies
+	void clientCreate(string key, string value, int ttl = 0);
 	void clientRead(string key);
-	void clientUpdate(string key, string value);
+	void clientUpdate(string key, string value, int ttl = 0);
 	void clientDelete(string key);
 
 	// receive messages from Emulnet
@@ -116,26 +166,44 @@ public:
 	// handle messages from receiving queue
 	void checkMessages();
 
-	void HandleReplies(Message reply);
+	void HandleReplies(Message& reply);
 
 	// coordinator dispatches messages to corresponding nodes
 	void dispatchMessages(Message message);
 
 	// find the addresses of nodes that are responsible for a key
-	vector<Node> findNodes(string key);
-	vector<Node> findNodes(string key, vector<Node>& newRing);
+	vector<Node> findNodes(const string& key);
+	vector<Node> findNodes(const string& key, vector<Node>& newRing);
 
 	// server
-	bool createKeyValue(string key, string value, int transId/*, ReplicaType replica*/);
-	string readKey(string key);
-	bool updateKeyValue(string key, string value/*, ReplicaType replica*/);
-	bool deleteKey(string key);
+	bool createKeyValue(const string& key, const string& value, int transId, int ttl = 0/*, ReplicaType replica*/);
+	string readKey(const string& key);
+	bool updateKeyValue(const string& key, const string& value, int transId, int ttl = 0/*, ReplicaType replica*/);
+	bool deleteKey(const string& key);
 
 	// stabilization protocol - handle multiple failures
 	void stabilizationProtocol(vector<Node>& oldRing, vector<Node>& hasMyreplicasDiff, vector<Node>& haveReplicasOfDiff);
 
 	void checkTimeouts();
 
+	// graceful leave: hand the ranges of this node off to their new owners
+	void leave();
+	const Histogram& getLatency(MessageType type);
+	unsigned long getTimeouts(MessageType type);
+	unsigned long getFailures(MessageType type);
+	void resetStats();
+	int expiryTime(int ttl);
+	static string versionedValue(int transId, const string& value);
+	int remainingTtl(const string& key);
+
+	// storage of the local hash table
+	string storagePath(const string& prefix, const string& suffix);
+	void checkStorage();
+
+	// traffic accounting
+	static const char *const messageTypeNames[];
+	static int classifyMessage(const char *data, int size);
+
 	~MP2Node();
 };
 
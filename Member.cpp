@@ -35,15 +35,72 @@ bool Address::operator ==(const Address& anotherAddress) {
 	return !memcmp(this->addr, anotherAddress.addr, sizeof(this->addr));
 }
 
+/**
+ * FUNCTION NAME: arrived
+ *
+ * DESCRIPTION: Record a heartbeat arriving at time, keeping the latest size
+ * 				intervals. Several arrivals in one tick count as one.
+ */
+void ArrivalWindow::arrived(long time, int size) {
+	if ( time <= last ) {
+		return;
+	}
+	if ( last >= 0 ) {
+		size = max(1, min(size, ARRIVAL_WINDOW_MAX));
+		while ( count >= size ) {
+			int oldest = intervals[(next + ARRIVAL_WINDOW_MAX - count) % ARRIVAL_WINDOW_MAX];
+			sum -= oldest;
+			sumSquares -= oldest * oldest;
+			count--;
+		}
+		int interval = (int)min(time - last, 255L);
+		intervals[next] = (unsigned char)interval;
+		next = (next + 1) % ARRIVAL_WINDOW_MAX;
+		count++;
+		sum += interval;
+		sumSquares += interval * interval;
+	}
+	last = time;
+}
+
+/**
+ * FUNCTION NAME: phi
+ *
+ * DESCRIPTION: Suspicion level of the member at time, -log10 of the probability
+ * 				that a heartbeat comes this late, with inter-arrival times taken as
+ * 				normally distributed (Hayashibara et al., The phi accrual failure
+ * 				detector). The normal CDF is approximated by a logistic function as
+ * 				in Akka. minStdDeviation keeps a very regular member from being
+ * 				removed at its first late heartbeat, and acceptablePause adds ticks
+ * 				the member may be silent on top of its mean.
+ *
+ * RETURNS:
+ * phi, 0 without any interval yet
+ */
+double ArrivalWindow::phi(long time, double minStdDeviation, double acceptablePause) const {
+	if ( 0 == count ) {
+		return 0.0;
+	}
+	double mean = (double)sum / count;
+	double variance = max(0.0, (double)sumSquares / count - mean * mean);
+	double stdDeviation = max(sqrt(variance), minStdDeviation);
+	double y = ((double)(time - last) - mean - acceptablePause) / stdDeviation;
+	double e = exp(-y * (1.5976 + 0.070566 * y * y));
+	if ( y > 0 ) {
+		return -log10(e / (1.0 + e));
+	}
+	return -log10(1.0 - 1.0 / (1.0 + e));
+}
+
 /**
  * Constructor
  */
-MemberListEntry::MemberListEntry(int id, short port, long heartbeat, long timestamp): id(id), port(port), heartbeat(heartbeat), timestamp(timestamp) {}
+MemberListEntry::MemberListEntry(int id, short port, long heartbeat, long timestamp): id(id), port(port), heartbeat(heartbeat), timestamp(timestamp), version(0), state(MEMBER_ALIVE), incarnation(0) {}
 
 /**
  * Constuctor
  */
-MemberListEntry::MemberListEntry(int id, short port): id(id), port(port) {}
+MemberListEntry::MemberListEntry(int id, short port): id(id), port(port), version(0), state(MEMBER_ALIVE), incarnation(0) {}
 
 /**
  * Copy constructor
@@ -53,6 +110,10 @@ MemberListEntry::MemberListEntry(const MemberListEntry &anotherMLE) {
 	this->id = anotherMLE.id;
 	this->port = anotherMLE.port;
 	this->timestamp = anotherMLE.timestamp;
+	this->version = anotherMLE.version;
+	this->state = anotherMLE.state;
+	this->incarnation = anotherMLE.incarnation;
+	this->arrivals = anotherMLE.arrivals;
 }
 
 /**
@@ -64,6 +125,10 @@ MemberListEntry& MemberListEntry::operator =(const MemberListEntry &anotherMLE)
 	swap(id, temp.id);
 	swap(port, temp.port);
 	swap(timestamp, temp.timestamp);
+	swap(version, temp.version);
+	swap(state, temp.state);
+	swap(incarnation, temp.incarnation);
+	swap(arrivals, temp.arrivals);
 	return *this;
 }
 
@@ -147,8 +212,14 @@ Member::Member(const Member &anotherMember) {
 	this->inited = anotherMember.inited;
 	this->inGroup = anotherMember.inGroup;
 	this->bFailed = anotherMember.bFailed;
+	this->bLeaving = anotherMember.bLeaving;
+	this->bHandedOff = anotherMember.bHandedOff;
+	this->bHandoffFailed = anotherMember.bHandoffFailed;
+	this->pendingHandoffs = anotherMember.pendingHandoffs;
+	this->leftMembers = anotherMember.leftMembers;
 	this->nnb = anotherMember.nnb;
 	this->heartbeat = anotherMember.heartbeat;
+	this->incarnation = anotherMember.incarnation;
 	this->pingCounter = anotherMember.pingCounter;
 	this->timeOutCounter = anotherMember.timeOutCounter;
 	this->memberList = anotherMember.memberList;
@@ -165,8 +236,14 @@ Member& Member::operator =(const Member& anotherMember) {
 	this->inited = anotherMember.inited;
 	this->inGroup = anotherMember.inGroup;
 	this->bFailed = anotherMember.bFailed;
+	this->bLeaving = anotherMember.bLeaving;
+	this->bHandedOff = anotherMember.bHandedOff;
+	this->bHandoffFailed = anotherMember.bHandoffFailed;
+	this->pendingHandoffs = anotherMember.pendingHandoffs;
+	this->leftMembers = anotherMember.leftMembers;
 	this->nnb = anotherMember.nnb;
 	this->heartbeat = anotherMember.heartbeat;
+	this->incarnation = anotherMember.incarnation;
 	this->pingCounter = anotherMember.pingCounter;
 	this->timeOutCounter = anotherMember.timeOutCounter;
 	this->memberList = anotherMember.memberList;
@@ -54,6 +54,36 @@ public:
 	}
 };
 
+// liveness of a member as the failure detector sees it; LEFT is a graceful leave
+enum memberSTATE { MEMBER_ALIVE, MEMBER_SUSPECT, MEMBER_FAULTY, MEMBER_LEFT };
+
+// inter-arrival times an ArrivalWindow can hold
+#define ARRIVAL_WINDOW_MAX 32
+
+/**
+ * CLASS NAME: ArrivalWindow
+ *
+ * DESCRIPTION: The latest inter-arrival times of a member's heartbeats, in ticks,
+ * 				with running sums for their mean and variance. Intervals are kept
+ * 				in a byte each; longer ones are cut to 255 ticks.
+ */
+class ArrivalWindow {
+private:
+	unsigned char intervals[ARRIVAL_WINDOW_MAX];
+	unsigned char count;
+	unsigned char next;
+	int sum;
+	int sumSquares;
+	long last;		// tick of the latest arrival, -1 before the first
+public:
+	ArrivalWindow(): count(0), next(0), sum(0), sumSquares(0), last(-1) {}
+	void arrived(long time, int size);
+	double phi(long time, double minStdDeviation, double acceptablePause) const;
+	int samples() const {
+		return count;
+	}
+};
+
 /**
  * CLASS NAME: MemberListEntry
  *
@@ -65,9 +95,13 @@ public:
 	short port;
 	long heartbeat;
 	long timestamp;
+	int version;	// highest MP1 wire format the member understands, 0 while unknown
+	int state;		// memberSTATE
+	long incarnation;	// bumped by the member to refute a suspicion, -1 when the sender's wire format has none
+	ArrivalWindow arrivals;	// heartbeats seen by this node, for the phi accrual detector
 	MemberListEntry(int id, short port, long heartbeat, long timestamp);
 	MemberListEntry(int id, short port);
-	MemberListEntry(): id(0), port(0), heartbeat(0), timestamp(0) {}
+	MemberListEntry(): id(0), port(0), heartbeat(0), timestamp(0), version(0), state(MEMBER_ALIVE), incarnation(0) {}
 	MemberListEntry(const MemberListEntry &anotherMLE);
 	MemberListEntry& operator =(const MemberListEntry &anotherMLE);
 	int getid();
@@ -96,10 +130,22 @@ public:
 	bool inGroup;
 	// boolean indicating if this member has failed
 	bool bFailed;
+	// boolean indicating if this member is leaving the group gracefully
+	bool bLeaving;
+	// boolean indicating if the KV store has handed its ranges off, so the member may leave
+	bool bHandedOff;
+	// boolean indicating if a handoff was never acknowledged, so peers must re-replicate instead
+	bool bHandoffFailed;
+	// handoffs and forwarded writes the KV store still waits for; the member leaves once none is left
+	int pendingHandoffs;
+	// members that left gracefully since the KV store last built its ring
+	vector<Address> leftMembers;
 	// number of my neighbors
 	int nnb;
 	// the node's own heartbeat
 	long heartbeat;
+	// the node's own incarnation, see MemberListEntry
+	long incarnation;
 	// counter for next ping
 	int pingCounter;
 	// counter for ping timeout
@@ -115,7 +161,7 @@ public:
 	/**
 	 * Constructor
 	 */
-	Member(): inited(false), inGroup(false), bFailed(false), nnb(0), heartbeat(0), pingCounter(0), timeOutCounter(0) {}
+	Member(): inited(false), inGroup(false), bFailed(false), bLeaving(false), bHandedOff(false), bHandoffFailed(false), pendingHandoffs(0), nnb(0), heartbeat(0), incarnation(0), pingCounter(0), timeOutCounter(0) {}
 	// copy constructor
 	Member(const Member &anotherMember);
 	// Assignment operator overloading
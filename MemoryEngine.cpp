@@ -0,0 +1,292 @@
+/**********************************
+ * FILE NAME: MemoryEngine.cpp
+ *
+ * DESCRIPTION: In-memory storage engine definition
+ **********************************/
+
+#include "MemoryEngine.h"
+
+/**
+ * Constructor
+ */
+MemoryEngine::MemoryEngine(): state(IDLE), frozen(NULL), entries(0), workerDone(false), workerFailed(false), failedSnapshots(0) {}
+
+/**
+ * Destructor
+ */
+MemoryEngine::~MemoryEngine() {
+	join();
+	delete frozen;
+}
+
+/**
+ * FUNCTION NAME: lookup
+ *
+ * DESCRIPTION: Find key in the live generation first and fall back to the pinned base
+ *
+ * RETURNS:
+ * true if the key is visible, value is filled in when not NULL
+ * false otherwise
+ */
+bool MemoryEngine::lookup(const string& key, string *value) {
+	map<string, string>::iterator search = table.find(key);
+	if ( search != table.end() ) {
+		if ( value ) {
+			*value = search->second;
+		}
+		return true;
+	}
+	if ( IDLE == state || tombstones.count(key) ) {
+		return false;
+	}
+	if ( WRITING == state ) {
+		search = frozen->find(key);
+		if ( search == frozen->end() ) {
+			return false;
+		}
+		if ( value ) {
+			*value = search->second;
+		}
+		return true;
+	}
+	string found;
+	if ( !restored.find(key, found) ) {
+		return false;
+	}
+	if ( value ) {
+		*value = found;
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: get
+ *
+ * DESCRIPTION: Read the value of key
+ */
+bool MemoryEngine::get(const string& key, string& value) {
+	return lookup(key, &value);
+}
+
+/**
+ * FUNCTION NAME: contains
+ *
+ * DESCRIPTION: Whether key exists
+ */
+bool MemoryEngine::contains(const string& key) {
+	return lookup(key, NULL);
+}
+
+/**
+ * FUNCTION NAME: create
+ *
+ * DESCRIPTION: Insert the pair unless the key already exists
+ */
+bool MemoryEngine::create(const string& key, string value) {
+	if ( IDLE != state && lookup(key, NULL) ) {
+		return true;
+	}
+	if ( table.emplace(key, move(value)).second ) {
+		entries++;
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: update
+ *
+ * DESCRIPTION: Replace the value of an existing key. The live generation shadows the base one.
+ */
+bool MemoryEngine::update(const string& key, string value) {
+	if ( !lookup(key, NULL) ) {
+		return false;
+	}
+	table[key] = move(value);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: deleteKey
+ *
+ * DESCRIPTION: Remove an existing key
+ */
+bool MemoryEngine::deleteKey(const string& key) {
+	if ( !lookup(key, NULL) ) {
+		return false;
+	}
+	table.erase(key);
+	if ( IDLE != state ) {
+		tombstones.insert(key);
+	}
+	entries--;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: size
+ *
+ * DESCRIPTION: Number of visible keys
+ */
+unsigned long MemoryEngine::size() {
+	return entries;
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Drop all contents, waiting for background work first
+ */
+void MemoryEngine::clear() {
+	join();
+	delete frozen;
+	frozen = NULL;
+	restored.close();
+	tombstones.clear();
+	table.clear();
+	entries = 0;
+	state = IDLE;
+}
+
+/**
+ * FUNCTION NAME: forEach
+ *
+ * DESCRIPTION: Visit every visible (key, value) pair, across both generations
+ */
+void MemoryEngine::forEach(const KeyValueVisitor& visit) {
+	if ( WRITING == state ) {
+		for ( map<string, string>::iterator it = frozen->begin(); it != frozen->end(); ++it ) {
+			if ( !tombstones.count(it->first) && !table.count(it->first) ) {
+				visit(it->first, it->second);
+			}
+		}
+	}
+	else if ( WARMING == state ) {
+		for ( uint64_t i = 0; i < restored.size(); i++ ) {
+			string key = restored.keyAt(i);
+			if ( !tombstones.count(key) && !table.count(key) ) {
+				visit(key, restored.valueAt(i));
+			}
+		}
+	}
+	for ( map<string, string>::iterator it = table.begin(); it != table.end(); ++it ) {
+		visit(it->first, it->second);
+	}
+}
+
+/**
+ * FUNCTION NAME: snapshot
+ *
+ * DESCRIPTION: Freeze the current contents and write them to path on a background
+ * 				thread. Freezing swaps the map out, so it is O(1) and the caller
+ * 				keeps serving requests from the live generation meanwhile.
+ *
+ * RETURNS:
+ * true if the snapshot was started
+ * false if a previous snapshot or restore is still in progress
+ */
+bool MemoryEngine::snapshot(const string& path) {
+	maintain();
+	if ( IDLE != state ) {
+		return false;
+	}
+	frozen = new map<string, string>();
+	frozen->swap(table);
+	state = WRITING;
+	workerDone = false;
+	workerFailed = false;
+	const map<string, string> *generation = frozen;
+	worker = thread([this, generation, path]() {
+		workerFailed = !SnapshotWriter::write(path, *generation);
+		workerDone = true;
+	});
+	return true;
+}
+
+/**
+ * FUNCTION NAME: restore
+ *
+ * DESCRIPTION: Replace the contents with the snapshot at path.
+ * 				The file is mmapped and reads are served from it right away,
+ * 				while a background thread loads it into a map.
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false if the snapshot could not be opened
+ */
+bool MemoryEngine::restore(const string& path) {
+	clear();
+	if ( !restored.open(path) ) {
+		return false;
+	}
+	entries = restored.size();
+	frozen = new map<string, string>();
+	state = WARMING;
+	workerDone = false;
+	map<string, string> *generation = frozen;
+	worker = thread([this, generation]() {
+		for ( uint64_t i = 0; i < restored.size(); i++ ) {
+			generation->emplace_hint(generation->end(), restored.keyAt(i), restored.valueAt(i));
+		}
+		workerDone = true;
+	});
+	return true;
+}
+
+/**
+ * FUNCTION NAME: maintain
+ *
+ * DESCRIPTION: If the background thread has finished, fold the live generation
+ * 				into the base one. Cost is proportional to the writes made while
+ * 				the base was pinned, not to the size of the table.
+ */
+void MemoryEngine::maintain() {
+	if ( IDLE == state || !workerDone ) {
+		return;
+	}
+	join();
+	if ( WRITING == state && workerFailed ) {
+		failedSnapshots++;
+	}
+	for ( set<string>::iterator it = tombstones.begin(); it != tombstones.end(); ++it ) {
+		frozen->erase(*it);
+	}
+	for ( map<string, string>::iterator it = table.begin(); it != table.end(); ++it ) {
+		(*frozen)[it->first].swap(it->second);
+	}
+	table.swap(*frozen);
+	delete frozen;
+	frozen = NULL;
+	tombstones.clear();
+	restored.close();
+	state = IDLE;
+}
+
+/**
+ * FUNCTION NAME: snapshotFailures
+ *
+ * DESCRIPTION: Snapshots that could not be written, counted once maintain() has
+ * 				picked up their worker
+ */
+unsigned long MemoryEngine::snapshotFailures() {
+	return failedSnapshots;
+}
+
+/**
+ * FUNCTION NAME: isPinned
+ *
+ * DESCRIPTION: Returns if a snapshot write or a restore warm-up is in progress
+ */
+bool MemoryEngine::isPinned() {
+	return IDLE != state;
+}
+
+/**
+ * FUNCTION NAME: join
+ *
+ * DESCRIPTION: Wait for the background thread, if any
+ */
+void MemoryEngine::join() {
+	if ( worker.joinable() ) {
+		worker.join();
+	}
+}
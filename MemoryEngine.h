@@ -0,0 +1,67 @@
+/**********************************
+ * FILE NAME: MemoryEngine.h
+ *
+ * DESCRIPTION: Header file of the in-memory storage engine
+ **********************************/
+
+#ifndef MEMORYENGINE_H_
+#define MEMORYENGINE_H_
+
+#include "stdincludes.h"
+#include "StorageEngine.h"
+#include "Snapshot.h"
+
+#include <set>
+#include <thread>
+#include <atomic>
+
+/**
+ * CLASS NAME: MemoryEngine
+ *
+ * DESCRIPTION: Keeps every pair in a std::map. This is the default engine.
+ *
+ * 				While a snapshot is being written or a restored snapshot is
+ * 				warming up, the table is split in two generations: a pinned
+ * 				base generation owned by the background thread, and table,
+ * 				which then only holds the writes made since the base was pinned.
+ * 				Deletes of base keys are remembered in tombstones. maintain()
+ * 				folds the two generations back together once the background
+ * 				work is done.
+ */
+class MemoryEngine : public StorageEngine {
+private:
+	enum BaseState { IDLE, WRITING, WARMING };
+	map<string, string> table;
+	BaseState state;
+	// pinned base generation: being written while WRITING, being filled while WARMING
+	map<string, string> *frozen;
+	// mmapped snapshot serving base reads while WARMING
+	SnapshotReader restored;
+	set<string> tombstones;
+	unsigned long entries;
+	thread worker;
+	atomic<bool> workerDone;
+	// set by the worker before workerDone when its snapshot could not be written
+	atomic<bool> workerFailed;
+	unsigned long failedSnapshots;
+	bool lookup(const string& key, string *value);
+	void join();
+public:
+	MemoryEngine();
+	bool get(const string& key, string& value);
+	bool contains(const string& key);
+	bool create(const string& key, string value);
+	bool update(const string& key, string value);
+	bool deleteKey(const string& key);
+	unsigned long size();
+	void clear();
+	void forEach(const KeyValueVisitor& visit);
+	void maintain();
+	bool snapshot(const string& path);
+	bool restore(const string& path);
+	unsigned long snapshotFailures();
+	bool isPinned();
+	virtual ~MemoryEngine();
+};
+
+#endif /* MEMORYENGINE_H_ */
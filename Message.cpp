@@ -5,52 +5,128 @@
  **********************************/
 #include "Message.h"
 
+// separates the fields of a serialized message
+static const char delimiter[] = "::";
+static const size_t delimiterLength = sizeof(delimiter) - 1;
+
+/**
+ * STRUCT NAME: FieldReader
+ *
+ * DESCRIPTION: Walks the fields of a serialized message in place
+ */
+struct FieldReader {
+	const char *data;
+	const char *end;
+	FieldReader(const char *data, size_t size): data(data), end(data + size) {}
+	// next field, up to the next delimiter or the end; false past the last field
+	bool next(const char *&field, size_t& length) {
+		if ( NULL == data ) {
+			return false;
+		}
+		field = data;
+		const char *found = search(data, end, delimiter, delimiter + delimiterLength);
+		length = found - field;
+		data = found == end ? NULL : found + delimiterLength;
+		return true;
+	}
+	// everything left, delimiters included
+	bool rest(const char *&field, size_t& length) {
+		if ( NULL == data ) {
+			return false;
+		}
+		field = data;
+		length = end - data;
+		data = NULL;
+		return true;
+	}
+	int nextInt() {
+		const char *field;
+		size_t length;
+		return next(field, length) ? parseInt(field, length) : 0;
+	}
+	static int parseInt(const char *field, size_t length) {
+		bool negative = length > 0 && '-' == *field;
+		int value = 0;
+		for ( size_t i = negative ? 1 : 0; i < length && isdigit((unsigned char)field[i]); i++ ) {
+			value = value * 10 + (field[i] - '0');
+		}
+		return negative ? -value : value;
+	}
+};
+
 /**
  * Constructor
  */
-// transID::fromAddr::CREATE::key::value::ReplicaType
+// transID::fromAddr::CREATE::key::value::ReplicaType[::ttl]
 // transID::fromAddr::READ::key
-// transID::fromAddr::UPDATE::key::value::ReplicaType
+// transID::fromAddr::UPDATE::key::value::ReplicaType[::ttl]
 // transID::fromAddr::DELETE::key
 // transID::fromAddr::REPLY::sucess
 // transID::fromAddr::READREPLY::value
-Message::Message(string message){
-	this->delimiter = "::";
-	vector<string> tuple;
-	size_t pos = message.find(delimiter);
-	size_t start = 0;
-	while (pos != string::npos) {
-		string field = message.substr(start, pos-start);
-		tuple.push_back(field);
-		start = pos + 2;
-		pos = message.find(delimiter, start);
-	}
-	tuple.push_back(message.substr(start));
+// transID::fromAddr::HANDOFF::entries
+Message::Message(const string& message){
+	parse(message.data(), message.size());
+}
 
-	transID = stoi(tuple.at(0));
-	Address addr(tuple.at(1));
-	fromAddr = addr;
-	type = static_cast<MessageType>(stoi(tuple.at(2)));
+/**
+ * Constructor
+ */
+Message::Message(const char *data, size_t size){
+	parse(data, size);
+}
+
+/**
+ * FUNCTION NAME: parse
+ *
+ * DESCRIPTION: Fill in the fields from a serialized message. Only key and value
+ * 				are copied out of data.
+ */
+void Message::parse(const char *data, size_t size) {
+	FieldReader reader(data, size);
+	const char *field;
+	size_t length;
+	this->ttl = 0;
+	this->replica = PRIMARY;
+	this->success = false;
+
+	transID = reader.nextInt();
+	fromAddr.init();
+	if ( reader.next(field, length) ) {
+		const char *colon = (const char *)memchr(field, ':', length);
+		size_t idLength = NULL == colon ? length : colon - field;
+		int id = FieldReader::parseInt(field, idLength);
+		short port = NULL == colon ? 0 : (short)FieldReader::parseInt(colon + 1, length - idLength - 1);
+		memcpy(&fromAddr.addr[0], &id, sizeof(int));
+		memcpy(&fromAddr.addr[4], &port, sizeof(short));
+	}
+	type = static_cast<MessageType>(reader.nextInt());
 	switch(type){
 		case CREATE:
 		case UPDATE:
-			key = tuple.at(3);
-			value = tuple.at(4);
-			if (tuple.size() > 5)
-				replica = static_cast<ReplicaType>(stoi(tuple.at(5)));
+			if ( reader.next(field, length) )
+				key.assign(field, length);
+			if ( reader.next(field, length) )
+				value.assign(field, length);
+			if ( reader.next(field, length) )
+				replica = static_cast<ReplicaType>(FieldReader::parseInt(field, length));
+			if ( reader.next(field, length) )
+				ttl = FieldReader::parseInt(field, length);
 			break;
 		case READ:
 		case DELETE:
-			key = tuple.at(3);
+			if ( reader.next(field, length) )
+				key.assign(field, length);
 			break;
 		case REPLY:
-			if (tuple.at(3) == "1")
-				success = true;
-			else
-				success = false;
+			success = reader.next(field, length) && 1 == length && '1' == *field;
 			break;
 		case READREPLY:
-			value = tuple.at(3);
+			if ( reader.next(field, length) )
+				value.assign(field, length);
+			break;
+		case HANDOFF:
+			if ( reader.rest(field, length) )
+				value.assign(field, length);
 			break;
 	}
 }
@@ -59,118 +135,133 @@ Message::Message(string message){
  * Constructor
  */
 // construct a create or update message
-Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value, ReplicaType _replica){
-	this->delimiter = "::";
-	transID = _transID;
-	fromAddr = _fromAddr;
-	type = _type;
-	key = _key;
-	value = _value;
-	replica = _replica;
-}
+Message::Message(int _transID, const Address& _fromAddr, MessageType _type, string _key, string _value, ReplicaType _replica):
+		type(_type), replica(_replica), key(move(_key)), value(move(_value)), fromAddr(_fromAddr), transID(_transID), success(false), ttl(0) {}
 
 /**
  * Constructor
  */
-Message::Message(const Message& anotherMessage) {
-	this->delimiter = anotherMessage.delimiter;
-	this->fromAddr = anotherMessage.fromAddr;
-	this->key = anotherMessage.key;
-	this->replica = anotherMessage.replica;
-	this->success = anotherMessage.success;
-	this->transID = anotherMessage.transID;
-	this->type = anotherMessage.type;
-	this->value = anotherMessage.value;
-}
+Message::Message(int _transID, const Address& _fromAddr, MessageType _type, string _key, string _value):
+		type(_type), replica(PRIMARY), key(move(_key)), value(move(_value)), fromAddr(_fromAddr), transID(_transID), success(false), ttl(0) {}
 
 /**
  * Constructor
  */
-Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value){
-	this->delimiter = "::";
-	transID = _transID;
-	fromAddr = _fromAddr;
-	type = _type;
-	key = _key;
-	value = _value;
-}
+// construct a read or delete message
+Message::Message(int _transID, const Address& _fromAddr, MessageType _type, string _key):
+		type(_type), replica(PRIMARY), key(move(_key)), fromAddr(_fromAddr), transID(_transID), success(false), ttl(0) {}
 
 /**
  * Constructor
  */
-// construct a read or delete message
-Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key){
-	this->delimiter = "::";
-	transID = _transID;
-	fromAddr = _fromAddr;
-	type = _type;
-	key = _key;
-}
+// construct reply message
+Message::Message(int _transID, const Address& _fromAddr, MessageType _type, bool _success):
+		type(_type), replica(PRIMARY), fromAddr(_fromAddr), transID(_transID), success(_success), ttl(0) {}
 
 /**
  * Constructor
  */
-// construct reply message
-Message::Message(int _transID, Address _fromAddr, MessageType _type, bool _success){
-	this->delimiter = "::";
-	transID = _transID;
-	fromAddr = _fromAddr;
-	type = _type;
-	success = _success;
-}
+// construct read reply message
+Message::Message(int _transID, const Address& _fromAddr, string _value):
+		type(READREPLY), replica(PRIMARY), value(move(_value)), fromAddr(_fromAddr), transID(_transID), success(false), ttl(0) {}
 
 /**
  * Constructor
  */
-// construct read reply message
-Message::Message(int _transID, Address _fromAddr, string _value){
-	this->delimiter = "::";
-	transID = _transID;
-	fromAddr = _fromAddr;
-	type = READREPLY;
-	value = _value;
+// construct handoff message
+Message::Message(int _transID, const Address& _fromAddr):
+		type(HANDOFF), replica(PRIMARY), fromAddr(_fromAddr), transID(_transID), success(false), ttl(0) {}
+
+/**
+ * FUNCTION NAME: addEntry
+ *
+ * DESCRIPTION: Append a key of a handoff to the value, as
+ * 				keyLength:valueLength:ttl:key value
+ * 				The lengths let keys and values hold the delimiter.
+ */
+void Message::addEntry(const string& key, const string& value, int ttl) {
+	char header[48];
+	int headerLength = snprintf(header, sizeof(header), "%zu:%zu:%d:", key.size(), value.size(), ttl);
+	this->value.reserve(this->value.size() + headerLength + key.size() + value.size());
+	this->value.append(header, headerLength);
+	this->value.append(key);
+	this->value.append(value);
+}
+
+/**
+ * FUNCTION NAME: entries
+ *
+ * DESCRIPTION: The keys of a handoff, up to the first malformed one
+ */
+vector<HandoffEntry> Message::entries() const {
+	vector<HandoffEntry> result;
+	const char *cur = value.data();
+	const char *end = cur + value.size();
+	while ( cur < end ) {
+		size_t fields[3];
+		for ( int i = 0; i < 3; i++ ) {
+			const char *colon = (const char *)memchr(cur, ':', end - cur);
+			if ( NULL == colon ) {
+				return result;
+			}
+			fields[i] = (size_t)FieldReader::parseInt(cur, colon - cur);
+			cur = colon + 1;
+		}
+		if ( (size_t)(end - cur) < fields[0] + fields[1] ) {
+			return result;
+		}
+		HandoffEntry entry;
+		entry.key.assign(cur, fields[0]);
+		entry.value.assign(cur + fields[0], fields[1]);
+		entry.ttl = (int)fields[2];
+		result.push_back(move(entry));
+		cur += fields[0] + fields[1];
+	}
+	return result;
 }
 
 /**
  * FUNCTION NAME: toString
  *
- * DESCRIPTION: Serialized Message in string format
+ * DESCRIPTION: Serialized Message in string format. The numeric fields are
+ * 				formatted on the stack so the string is allocated once.
  */
-string Message::toString(){
-	string message = to_string(transID) + delimiter + fromAddr.getAddress() + delimiter + to_string(type) + delimiter;
+string Message::toString() const {
+	int id;
+	short port;
+	memcpy(&id, &fromAddr.addr[0], sizeof(int));
+	memcpy(&port, &fromAddr.addr[4], sizeof(short));
+	char header[64];
+	int headerLength = snprintf(header, sizeof(header), "%d::%d:%d::%d::", transID, id, port, (int)type);
+	char trailer[32];
+	int trailerLength = 0;
+	if ( CREATE == type || UPDATE == type ) {
+		trailerLength = ttl > 0 ? snprintf(trailer, sizeof(trailer), "::%d::%d", (int)replica, ttl)
+				: snprintf(trailer, sizeof(trailer), "::%d", (int)replica);
+	}
+
+	string message;
+	message.reserve(headerLength + key.size() + delimiterLength + value.size() + trailerLength + 1);
+	message.append(header, headerLength);
 	switch(type){
 		case CREATE:
 		case UPDATE:
-			message += key + delimiter + value + delimiter + to_string(replica);
+			message.append(key);
+			message.append(delimiter, delimiterLength);
+			message.append(value);
+			message.append(trailer, trailerLength);
 			break;
 		case READ:
 		case DELETE:
-			message += key;
+			message.append(key);
 			break;
 		case REPLY:
-			if (success)
-				message += "1";
-			else
-				message += "0";
+			message.push_back(success ? '1' : '0');
 			break;
 		case READREPLY:
-			message += value;
+		case HANDOFF:
+			message.append(value);
 			break;
 	}
 	return message;
 }
-
-/**
- * Assignment operator overloading
- */
-Message& Message::operator =(const Message& anotherMessage) {
-	this->delimiter = anotherMessage.delimiter;
-	this->fromAddr = anotherMessage.fromAddr;
-	this->key = anotherMessage.key;
-	this->replica = anotherMessage.replica;
-	this->success = anotherMessage.success;
-	this->transID = anotherMessage.transID;
-	this->type = anotherMessage.type;
-	this->value = anotherMessage.value;
-	return *this;
-}
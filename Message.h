@@ -10,6 +10,17 @@
 #include "Member.h"
 #include "common.h"
 
+/**
+ * STRUCT NAME: HandoffEntry
+ *
+ * DESCRIPTION: A key of a HANDOFF message, its value as stored and its ttl
+ */
+struct HandoffEntry {
+	string key;
+	string value;
+	int ttl;
+};
+
 /**
  * CLASS NAME: Message
  *
@@ -24,23 +35,29 @@ public:
 	Address fromAddr;
 	int transID;
 	bool success; // success or not 
-	// delimiter
-	string delimiter;
+	int ttl; // create/update: ticks until the key expires, 0 for never
 	// construct a message from a string
-	Message(string message);
-	Message(const Message& anotherMessage);
-	// construct a create or update message
-	Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value);
-	Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value, ReplicaType _replica);
+	Message(const string& message);
+	// construct a message from a received buffer, without copying it to a string first
+	Message(const char *data, size_t size);
+	// construct a create or update message; key and value are moved in when passed as temporaries
+	Message(int _transID, const Address& _fromAddr, MessageType _type, string _key, string _value);
+	Message(int _transID, const Address& _fromAddr, MessageType _type, string _key, string _value, ReplicaType _replica);
 	// construct a read or delete message
-	Message(int _transID, Address _fromAddr, MessageType _type, string _key);
+	Message(int _transID, const Address& _fromAddr, MessageType _type, string _key);
 	// construct reply message
-	Message(int _transID, Address _fromAddr, MessageType _type, bool _success);
+	Message(int _transID, const Address& _fromAddr, MessageType _type, bool _success);
 	// construct read reply message
-	Message(int _transID, Address _fromAddr, string _value);
-	Message& operator = (const Message& anotherMessage);
-	// serialize to a string
-	string toString();
+	Message(int _transID, const Address& _fromAddr, string _value);
+	// construct an empty handoff message, see addEntry
+	Message(int _transID, const Address& _fromAddr);
+	// serialize to a string, in one allocation
+	string toString() const;
+	// handoff: append a key to the value, and read the keys back
+	void addEntry(const string& key, const string& value, int ttl);
+	vector<HandoffEntry> entries() const;
+private:
+	void parse(const char *data, size_t size);
 };
 
 #endif
@@ -0,0 +1,137 @@
+/**********************************
+ * FILE NAME: Metrics.cpp
+ *
+ * DESCRIPTION: Metrics registry definition
+ **********************************/
+
+#include "Metrics.h"
+
+#include <mutex>
+#include <new>
+
+/*
+ * Registry, keyed by (metric, node). Metrics are never removed, so the
+ * pointers handed out stay valid for the whole run.
+ */
+typedef pair<string, int> MetricKey;
+static mutex registryLock;
+static map<MetricKey, Counter *> counters;
+static map<MetricKey, Gauge *> gauges;
+static FILE *metricsFile = NULL;
+
+static atomic<unsigned> nextShard(0);
+static thread_local unsigned myShard = nextShard++ % METRICS_SHARDS;
+
+/**
+ * Constructor
+ */
+Counter::Counter() {
+	for ( int i = 0; i < METRICS_SHARDS; i++ ) {
+		shards[i].value.store(0);
+	}
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Add n to the shard of the calling thread
+ */
+void Counter::add(uint64_t n) {
+	shards[myShard].value.fetch_add(n, memory_order_relaxed);
+}
+
+/**
+ * FUNCTION NAME: value
+ *
+ * DESCRIPTION: Sum of all shards
+ */
+uint64_t Counter::value() const {
+	uint64_t sum = 0;
+	for ( int i = 0; i < METRICS_SHARDS; i++ ) {
+		sum += shards[i].value.load(memory_order_relaxed);
+	}
+	return sum;
+}
+
+/**
+ * FUNCTION NAME: counter
+ *
+ * DESCRIPTION: The counter called name of node, created on first use
+ */
+Counter *Metrics::counter(const string& name, int node) {
+	lock_guard<mutex> guard(registryLock);
+	Counter *& c = counters[MetricKey(name, node)];
+	if ( NULL == c ) {
+		// new of C++11 does not honour the alignment of the shards
+		void *memory = NULL;
+		if ( 0 != posix_memalign(&memory, alignof(Counter), sizeof(Counter)) ) {
+			throw bad_alloc();
+		}
+		c = new (memory) Counter();
+	}
+	return c;
+}
+
+/**
+ * FUNCTION NAME: gauge
+ *
+ * DESCRIPTION: The gauge called name of node, created on first use
+ */
+Gauge *Metrics::gauge(const string& name, int node) {
+	lock_guard<mutex> guard(registryLock);
+	Gauge *& g = gauges[MetricKey(name, node)];
+	if ( NULL == g ) {
+		g = new Gauge();
+	}
+	return g;
+}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Start the metrics file at path
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool Metrics::open(const char *path) {
+	close();
+	metricsFile = fopen(path, "w");
+	if ( NULL == metricsFile ) {
+		printf("Unable to open metrics file %s\n", path);
+		return false;
+	}
+	fprintf(metricsFile, "time,node,metric,value\n");
+	return true;
+}
+
+/**
+ * FUNCTION NAME: snapshot
+ *
+ * DESCRIPTION: Append the current value of every metric, stamped with time
+ */
+void Metrics::snapshot(int time) {
+	if ( NULL == metricsFile ) {
+		return;
+	}
+	lock_guard<mutex> guard(registryLock);
+	for ( map<MetricKey, Counter *>::iterator it = counters.begin(); it != counters.end(); ++it ) {
+		fprintf(metricsFile, "%d,%d,%s,%llu\n", time, it->first.second, it->first.first.c_str(), (unsigned long long)it->second->value());
+	}
+	for ( map<MetricKey, Gauge *>::iterator it = gauges.begin(); it != gauges.end(); ++it ) {
+		fprintf(metricsFile, "%d,%d,%s,%lld\n", time, it->first.second, it->first.first.c_str(), (long long)it->second->value());
+	}
+}
+
+/**
+ * FUNCTION NAME: close
+ *
+ * DESCRIPTION: Close the metrics file
+ */
+void Metrics::close() {
+	if ( NULL != metricsFile ) {
+		fclose(metricsFile);
+		metricsFile = NULL;
+	}
+}
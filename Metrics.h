@@ -0,0 +1,86 @@
+/**********************************
+ * FILE NAME: Metrics.h
+ *
+ * DESCRIPTION: Header file of the metrics registry
+ **********************************/
+
+#ifndef METRICS_H_
+#define METRICS_H_
+
+#include "stdincludes.h"
+
+#include <stdint.h>
+#include <atomic>
+
+/*
+ * Macros
+ */
+#define METRICS_FILE_LOCATION "metrics.csv"
+// shards per counter; threads are spread over them round robin
+#define METRICS_SHARDS 8
+#define METRICS_CACHE_LINE 64
+// node of metrics that belong to no node in particular
+#define METRICS_GLOBAL 0
+
+/**
+ * STRUCT NAME: CounterShard
+ *
+ * DESCRIPTION: One shard of a Counter, alone on its cache line
+ */
+struct alignas(METRICS_CACHE_LINE) CounterShard {
+	atomic<uint64_t> value;
+};
+
+/**
+ * CLASS NAME: Counter
+ *
+ * DESCRIPTION: Monotonic count. Every thread adds to its own shard, so
+ * 				threads never contend; reading sums the shards. Over-aligned:
+ * 				only Metrics::counter() creates them, on an aligned allocation.
+ */
+class Counter {
+private:
+	CounterShard shards[METRICS_SHARDS];
+public:
+	Counter();
+	void add(uint64_t n = 1);
+	uint64_t value() const;
+};
+
+/**
+ * CLASS NAME: Gauge
+ *
+ * DESCRIPTION: Current level of something, set by its owner
+ */
+class Gauge {
+private:
+	atomic<int64_t> level;
+public:
+	Gauge(): level(0) {}
+	void set(int64_t value) {
+		level.store(value, memory_order_relaxed);
+	}
+	int64_t value() const {
+		return level.load(memory_order_relaxed);
+	}
+};
+
+/**
+ * CLASS NAME: Metrics
+ *
+ * DESCRIPTION: Registry of named counters and gauges, each either per node or
+ * 				global. Components look their metrics up once, at construction,
+ * 				and keep the pointer; updating one is then a single relaxed
+ * 				atomic operation. snapshot() appends the value of every metric
+ * 				to metrics.csv as "time,node,metric,value" rows.
+ */
+class Metrics {
+public:
+	static Counter *counter(const string& name, int node = METRICS_GLOBAL);
+	static Gauge *gauge(const string& name, int node = METRICS_GLOBAL);
+	static bool open(const char *path);
+	static void snapshot(int time);
+	static void close();
+};
+
+#endif /* METRICS_H_ */
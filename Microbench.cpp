@@ -0,0 +1,386 @@
+/**********************************
+ * FILE NAME: Microbench.cpp
+ *
+ * DESCRIPTION: Microbenchmarks of the hot primitives: the KV message codec, the
+ * 				membership message Pack/unpack, node hashing, replica lookup on
+ * 				the ring and the hash table operations. Each benchmark is sized
+ * 				to run for about MICRO_TARGET_NS per repetition, warmed up, then
+ * 				repeated; the minimum and median time per operation, cycles per
+ * 				operation and heap allocations per operation are reported.
+ *
+ * RUN PROCEDURE:
+ * $ ./Microbench testcases/create.conf [name filter] [repetitions]
+ **********************************/
+
+#include "MP1Node.h"
+#include "MP2Node.h"
+#include "Message.h"
+#include "Node.h"
+#include "HashTable.h"
+#include "AllocProfile.h"
+
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MICRO_HAVE_TSC 1
+#endif
+
+/*
+ * Macros
+ */
+// wall time a repetition is sized to
+#define MICRO_TARGET_NS 20000000ULL
+#define MICRO_WARMUP_REPS 2
+#define MICRO_DEFAULT_REPS 10
+#define MICRO_KEYS 1024
+#define MICRO_TABLE_KEYS 10000
+#define MICRO_VALUE_SIZE 100
+
+// results the benchmarks fold into, so that the compiler keeps their work
+static volatile size_t sink;
+
+/**
+ * STRUCT NAME: MicroFixture
+ *
+ * DESCRIPTION: Inputs of the benchmarks, built once before any of them runs
+ */
+struct MicroFixture {
+	Params *par;
+	EmulNet *en;
+	Log *log;
+	MP2Node *mp2;
+	vector<string> keys;
+	vector<Address> addrs;
+	vector<Node> ring10;
+	vector<Node> ring100;
+	Message *create;
+	string encodedCreate;
+	string encodedReply;
+	MessageMP1 *ping10;
+	MessageMP1 *ping100;
+	pair<char *, size_t> packed10;
+	pair<char *, size_t> packed100;
+	pair<char *, size_t> packedLegacy100;
+	HashTable table;
+	string value;
+};
+
+static MicroFixture fx;
+
+/**
+ * FUNCTION NAME: makeRing
+ *
+ * DESCRIPTION: A sorted ring of the first size addresses, as MP2Node::updateRing builds it
+ */
+static vector<Node> makeRing(size_t size) {
+	vector<Node> ring;
+	for ( size_t i = 0; i < size; i++ ) {
+		ring.push_back(Node(fx.addrs[i]));
+	}
+	sort(ring.begin(), ring.end());
+	return ring;
+}
+
+/**
+ * FUNCTION NAME: makePing
+ *
+ * DESCRIPTION: A heartbeat carrying a membership list of size entries
+ */
+static MessageMP1 *makePing(size_t size) {
+	vector<MemberListEntry> members;
+	for ( size_t i = 0; i < size; i++ ) {
+		members.push_back(MemberListEntry(i + 1, 0, 100 + i, 500));
+	}
+	return new MessageMP1(PINGREQ, fx.addrs[0], 100, members);
+}
+
+/**
+ * FUNCTION NAME: setUp
+ *
+ * DESCRIPTION: Build the fixture
+ */
+static void setUp(char *conf) {
+	fx.par = new Params();
+	fx.par->setparams(conf);
+	// EmulNet is too big for the stack
+	fx.en = new EmulNet(fx.par, "microbench.net");
+	fx.log = new Log(fx.par);
+	for ( int i = 1; i <= 100; i++ ) {
+		fx.addrs.push_back(Address(to_string(i) + ":0"));
+	}
+	fx.mp2 = new MP2Node(new Member, fx.par, fx.en, fx.log, &fx.addrs[0]);
+	for ( int i = 0; i < MICRO_KEYS; i++ ) {
+		fx.keys.push_back("key" + to_string(i));
+	}
+	fx.ring10 = makeRing(10);
+	fx.ring100 = makeRing(100);
+
+	fx.value = string(MICRO_VALUE_SIZE, 'v');
+	fx.create = new Message(42, fx.addrs[0], CREATE, fx.keys[0], fx.value, SECONDARY);
+	fx.encodedCreate = fx.create->toString();
+	fx.encodedReply = Message(42, fx.addrs[1], REPLY, true).toString();
+
+	fx.ping10 = makePing(10);
+	fx.ping100 = makePing(100);
+	fx.packed10 = fx.ping10->Pack(true);
+	fx.packed100 = fx.ping100->Pack(true);
+	fx.packedLegacy100 = fx.ping100->Pack(true, MP1_WIRE_LEGACY);
+
+	for ( int i = 0; i < MICRO_TABLE_KEYS; i++ ) {
+		fx.table.create("key" + to_string(i), fx.value);
+	}
+}
+
+/**
+ * FUNCTION NAME: tearDown
+ *
+ * DESCRIPTION: Free the fixture
+ */
+static void tearDown() {
+	free(fx.packed10.first);
+	free(fx.packed100.first);
+	free(fx.packedLegacy100.first);
+	delete fx.ping10;
+	delete fx.ping100;
+	delete fx.create;
+	// deletes its Member
+	delete fx.mp2;
+	delete fx.log;
+	delete fx.en;
+	delete fx.par;
+}
+
+/*
+ * The benchmarks. Each runs its operation iterations times.
+ */
+static void benchMessageEncode(uint64_t iterations) {
+	for ( uint64_t i = 0; i < iterations; i++ ) {
+		sink += fx.create->toString().size();
+	}
+}
+
+static void benchMessageDecode(uint64_t iterations) {
+	for ( uint64_t i = 0; i < iterations; i++ ) {
+		Message msg(fx.encodedCreate);
+		sink += msg.value.size();
+	}
+}
+
+static void benchReplyDecode(uint64_t iterations) {
+	for ( uint64_t i = 0; i < iterations; i++ ) {
+		Message msg(fx.encodedReply);
+		sink += msg.success;
+	}
+}
+
+static void benchPack(MessageMP1 *msg, uint64_t iterations, int version = MP1_WIRE_VERSION) {
+	for ( uint64_t i = 0; i < iterations; i++ ) {
+		pair<char *, size_t> packed = msg->Pack(true, version);
+		sink += packed.second;
+		free(packed.first);
+	}
+}
+
+static void benchPack10(uint64_t iterations) {
+	benchPack(fx.ping10, iterations);
+}
+
+static void benchPack100(uint64_t iterations) {
+	benchPack(fx.ping100, iterations);
+}
+
+static void benchPackLegacy100(uint64_t iterations) {
+	benchPack(fx.ping100, iterations, MP1_WIRE_LEGACY);
+}
+
+static void benchUnpack(pair<char *, size_t>& packed, uint64_t iterations) {
+	for ( uint64_t i = 0; i < iterations; i++ ) {
+		MessageMP1 msg(packed.first, packed.second);
+		sink += msg.members.size();
+	}
+}
+
+static void benchUnpack10(uint64_t iterations) {
+	benchUnpack(fx.packed10, iterations);
+}
+
+static void benchUnpack100(uint64_t iterations) {
+	benchUnpack(fx.packed100, iterations);
+}
+
+static void benchUnpackLegacy100(uint64_t iterations) {
+	benchUnpack(fx.packedLegacy100, iterations);
+}
+
+static void benchNodeHash(uint64_t iterations) {
+	Node node;
+	for ( uint64_t i = 0; i < iterations; i++ ) {
+		node.nodeAddress = fx.addrs[i % fx.addrs.size()];
+		node.computeHashCode();
+		sink += node.nodeHashCode;
+	}
+}
+
+static void benchFindNodes(vector<Node>& ring, uint64_t iterations) {
+	for ( uint64_t i = 0; i < iterations; i++ ) {
+		sink += fx.mp2->findNodes(fx.keys[i % MICRO_KEYS], ring).size();
+	}
+}
+
+static void benchFindNodes10(uint64_t iterations) {
+	benchFindNodes(fx.ring10, iterations);
+}
+
+static void benchFindNodes100(uint64_t iterations) {
+	benchFindNodes(fx.ring100, iterations);
+}
+
+static void benchTableRead(uint64_t iterations) {
+	for ( uint64_t i = 0; i < iterations; i++ ) {
+		sink += fx.table.read(fx.keys[i % MICRO_KEYS]).size();
+	}
+}
+
+static void benchTableUpdate(uint64_t iterations) {
+	for ( uint64_t i = 0; i < iterations; i++ ) {
+		sink += fx.table.update(fx.keys[i % MICRO_KEYS], fx.value);
+	}
+}
+
+static void benchTableCreateDelete(uint64_t iterations) {
+	for ( uint64_t i = 0; i < iterations; i++ ) {
+		sink += fx.table.create("new", fx.value);
+		sink += fx.table.deleteKey("new");
+	}
+}
+
+/**
+ * STRUCT NAME: MicroBench
+ *
+ * DESCRIPTION: A benchmark and the operation it times
+ */
+struct MicroBench {
+	const char *name;
+	void (*run)(uint64_t iterations);
+};
+
+static const MicroBench benches[] = {
+	{ "message_encode", benchMessageEncode },
+	{ "message_decode", benchMessageDecode },
+	{ "message_decode_reply", benchReplyDecode },
+	{ "mp1_pack/10", benchPack10 },
+	{ "mp1_pack/100", benchPack100 },
+	{ "mp1_pack_legacy/100", benchPackLegacy100 },
+	{ "mp1_unpack/10", benchUnpack10 },
+	{ "mp1_unpack/100", benchUnpack100 },
+	{ "mp1_unpack_legacy/100", benchUnpackLegacy100 },
+	{ "node_hash", benchNodeHash },
+	{ "find_nodes/10", benchFindNodes10 },
+	{ "find_nodes/100", benchFindNodes100 },
+	{ "table_read", benchTableRead },
+	{ "table_update", benchTableUpdate },
+	{ "table_create_delete", benchTableCreateDelete },
+};
+
+/**
+ * STRUCT NAME: MicroSample
+ *
+ * DESCRIPTION: One timed repetition
+ */
+struct MicroSample {
+	double ns;
+	double cycles;
+	bool operator < (const MicroSample& another) const {
+		return ns < another.ns;
+	}
+};
+
+/**
+ * FUNCTION NAME: timeRun
+ *
+ * DESCRIPTION: Run bench for iterations operations and time it
+ */
+static MicroSample timeRun(const MicroBench& bench, uint64_t iterations) {
+	MicroSample sample;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+#ifdef MICRO_HAVE_TSC
+	unsigned long long startCycles = __rdtsc();
+#endif
+	bench.run(iterations);
+#ifdef MICRO_HAVE_TSC
+	sample.cycles = __rdtsc() - startCycles;
+#else
+	sample.cycles = 0;
+#endif
+	sample.ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+	return sample;
+}
+
+/**
+ * FUNCTION NAME: measure
+ *
+ * DESCRIPTION: Size, warm up and time bench, and print its line
+ */
+static void measure(const MicroBench& bench, int repetitions) {
+	// grow the repetition until it takes long enough to time; this warms up too
+	uint64_t iterations = 1;
+	while ( timeRun(bench, iterations).ns < MICRO_TARGET_NS / 10 ) {
+		iterations *= 2;
+	}
+	iterations = max<uint64_t>(iterations * 10, 1);
+	for ( int i = 0; i < MICRO_WARMUP_REPS; i++ ) {
+		timeRun(bench, iterations);
+	}
+
+	vector<MicroSample> samples;
+	samples.reserve(repetitions);
+	unsigned long long allocationsBefore = AllocProfile::allocations();
+	for ( int i = 0; i < repetitions; i++ ) {
+		samples.push_back(timeRun(bench, iterations));
+	}
+	double allocationsPerOp = (double)(AllocProfile::allocations() - allocationsBefore) / (iterations * repetitions);
+
+	sort(samples.begin(), samples.end());
+	const MicroSample& median = samples[samples.size() / 2];
+	printf("%-22s %12llu %5d %12.1f %12.1f %12.1f %10.2f\n", bench.name, (unsigned long long)iterations, repetitions,
+			samples[0].ns / iterations, median.ns / iterations, median.cycles / iterations, allocationsPerOp);
+	fflush(stdout);
+}
+
+/**********************************
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: main function. Run the benchmarks whose name contains the filter
+ **********************************/
+int main(int argc, char *argv[]) {
+	if ( argc < 2 || argc > 4 ) {
+		fprintf(stderr, "Usage: %s <test case .conf> [name filter] [repetitions]\n", argv[0]);
+		return FAILURE;
+	}
+	const char *filter = argc >= 3 ? argv[2] : "";
+	int repetitions = argc == 4 ? atoi(argv[3]) : MICRO_DEFAULT_REPS;
+	if ( repetitions < 1 ) {
+		fprintf(stderr, "Repetitions must be positive\n");
+		return FAILURE;
+	}
+	setUp(argv[1]);
+
+	printf("%-22s %12s %5s %12s %12s %12s %10s\n", "benchmark", "ops/rep", "reps", "min ns/op", "median ns/op",
+#ifdef MICRO_HAVE_TSC
+			"cycles/op",
+#else
+			"(no tsc)",
+#endif
+			"allocs/op");
+	for ( size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++ ) {
+		if ( NULL != strstr(benches[i].name, filter) ) {
+			measure(benches[i], repetitions);
+		}
+	}
+
+	printf("\nmp1 message of 100 members: %zu bytes, %zu in the legacy wire format\n", fx.packed100.second,
+			fx.packedLegacy100.second);
+
+	tearDown();
+	return SUCCESS;
+}
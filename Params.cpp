@@ -5,6 +5,7 @@
  **********************************/
 
 #include "Params.h"
+#include "Random.h"
 
 /**
  * Constructor
@@ -18,29 +19,289 @@ Params::Params(): PORTNUM(8001) {}
  */
 void Params::setparams(char *config_file) {
 	//trace.funcEntry("Params::setparams");
-	char CRUD[10];
+	char line[256];
+	char name[64];
+	char value[128];
 	FILE *fp = fopen(config_file,"r");
+	if ( NULL == fp ) {
+		printf("Unable to open configuration file %s\n", config_file);
+		exit(1);
+	}
 
-	fscanf(fp,"MAX_NNB: %d", &MAX_NNB);
-	fscanf(fp,"\nSINGLE_FAILURE: %d", &SINGLE_FAILURE);
-	fscanf(fp,"\nDROP_MSG: %d", &DROP_MSG);
-	fscanf(fp,"\nMSG_DROP_PROB: %lf", &MSG_DROP_PROB);
-	fscanf(fp,"\nCRUD_TEST: %s", CRUD);
+	// Defaults for keys the test case does not set
+	MAX_NNB = 10;
+	SINGLE_FAILURE = 0;
+	DROP_MSG = 0;
+	MSG_DROP_PROB = 0;
+	CRUDTEST = CREATE_TEST;
+	SNAPSHOT_INTERVAL = 0;
+	SNAPSHOT_RESTORE = 0;
+	STORAGE_ENGINE = MEMORY_STORAGE;
+	LSM_MEMTABLE_KB = 4096;
+	LSM_MAX_RUNS = 4;
+	MEMORY_BUDGET_KB = 0;
+	EVICT_HIGH_WATERMARK = 100;
+	EVICT_LOW_WATERMARK = 90;
+	EVENT_LOG = 0;
+	TRACE = 0;
+	METRICS_INTERVAL = 0;
+	NET_DELAY_MODEL = FIXED_DELAY;
+	NET_DELAY = 0;
+	NET_DELAY_MAX = 0;
+	NET_DELAY_SIGMA = 0;
+	NET_JITTER = 0;
+	NET_BANDWIDTH = 0;
+	PARTITIONS.clear();
+	LINK_FAULTS.clear();
+	SEED = 0;
+	CAPTURE = 0;
+	WORKLOAD_RECORDS = 1000;
+	WORKLOAD_OPS_PER_TICK = 20;
+	WORKLOAD_TICKS = 400;
+	WORKLOAD_READ = 50;
+	WORKLOAD_UPDATE = 50;
+	WORKLOAD_INSERT = 0;
+	WORKLOAD_SCAN = 0;
+	WORKLOAD_SCAN_LENGTH = 10;
+	WORKLOAD_DISTRIBUTION = ZIPFIAN_KEYS;
+	WORKLOAD_ZIPF_THETA = 0.99;
+	WORKLOAD_VALUE_MIN = 100;
+	WORKLOAD_VALUE_MAX = 100;
+	WORKLOAD_FAIL_NODES = 0;
+	WORKLOAD_LEAVE_NODES = 0;
+	MP1_LEGACY_NODES = 0;
+	FAILURE_DETECTOR = HEARTBEAT_DETECTOR;
+	SWIM_PERIOD = 6;
+	SWIM_ACK_TIMEOUT = 2;
+	SWIM_INDIRECT_PROBES = 3;
+	SWIM_SUSPECT_TIMEOUT = 24;
+	SWIM_PIGGYBACK = 6;
+	PHI_THRESHOLD = 8.0;
+	PHI_WINDOW = ARRIVAL_WINDOW_MAX;
+	PHI_MIN_STD_DEV = 2.0;
+	PHI_ACCEPTABLE_PAUSE = 5.0;
 
-	if ( 0 == strcmp(CRUD, "CREATE") ) {
-		this->CRUDTEST = CREATE_TEST;
+	// Every line is "KEY: value", in any order
+	while ( NULL != fgets(line, sizeof(line), fp) ) {
+		if ( 2 != sscanf(line, " %63[^: ] : %127s", name, value) ) {
+			continue;
+		}
+		if ( 0 == strcmp(name, "MAX_NNB") ) {
+			MAX_NNB = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "SINGLE_FAILURE") ) {
+			SINGLE_FAILURE = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "DROP_MSG") ) {
+			DROP_MSG = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "MSG_DROP_PROB") ) {
+			MSG_DROP_PROB = atof(value);
+		}
+		else if ( 0 == strcmp(name, "CRUD_TEST") ) {
+			if ( 0 == strcmp(value, "CREATE") ) {
+				this->CRUDTEST = CREATE_TEST;
+			}
+			else if ( 0 == strcmp(value, "READ") ) {
+				this->CRUDTEST = READ_TEST;
+			}
+			else if ( 0 == strcmp(value, "UPDATE") ) {
+				this->CRUDTEST = UPDATE_TEST;
+			}
+			else if ( 0 == strcmp(value, "DELETE") ) {
+				this->CRUDTEST = DELETE_TEST;
+			}
+			else if ( 0 == strcmp(value, "WORKLOAD") ) {
+				this->CRUDTEST = WORKLOAD_TEST;
+			}
+		}
+		else if ( 0 == strcmp(name, "SNAPSHOT_INTERVAL") ) {
+			SNAPSHOT_INTERVAL = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "SNAPSHOT_RESTORE") ) {
+			SNAPSHOT_RESTORE = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "STORAGE_ENGINE") ) {
+			if ( 0 == strcmp(value, "MEMORY") ) {
+				STORAGE_ENGINE = MEMORY_STORAGE;
+			}
+			else if ( 0 == strcmp(value, "LSM") ) {
+				STORAGE_ENGINE = LSM_STORAGE;
+			}
+		}
+		else if ( 0 == strcmp(name, "LSM_MEMTABLE_KB") ) {
+			LSM_MEMTABLE_KB = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "LSM_MAX_RUNS") ) {
+			LSM_MAX_RUNS = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "MEMORY_BUDGET_KB") ) {
+			MEMORY_BUDGET_KB = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "EVICT_HIGH_WATERMARK") ) {
+			EVICT_HIGH_WATERMARK = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "EVICT_LOW_WATERMARK") ) {
+			EVICT_LOW_WATERMARK = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "EVENT_LOG") ) {
+			EVENT_LOG = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "TRACE") ) {
+			TRACE = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "METRICS_INTERVAL") ) {
+			METRICS_INTERVAL = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "NET_DELAY_MODEL") ) {
+			if ( 0 == strcmp(value, "FIXED") ) {
+				NET_DELAY_MODEL = FIXED_DELAY;
+			}
+			else if ( 0 == strcmp(value, "UNIFORM") ) {
+				NET_DELAY_MODEL = UNIFORM_DELAY;
+			}
+			else if ( 0 == strcmp(value, "LOGNORMAL") ) {
+				NET_DELAY_MODEL = LOGNORMAL_DELAY;
+			}
+		}
+		else if ( 0 == strcmp(name, "NET_DELAY") ) {
+			NET_DELAY = atof(value);
+		}
+		else if ( 0 == strcmp(name, "NET_DELAY_MAX") ) {
+			NET_DELAY_MAX = atof(value);
+		}
+		else if ( 0 == strcmp(name, "NET_DELAY_SIGMA") ) {
+			NET_DELAY_SIGMA = atof(value);
+		}
+		else if ( 0 == strcmp(name, "NET_JITTER") ) {
+			NET_JITTER = atof(value);
+		}
+		else if ( 0 == strcmp(name, "NET_BANDWIDTH") ) {
+			NET_BANDWIDTH = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "PARTITION") ) {
+			PARTITIONS.push_back(value);
+		}
+		else if ( 0 == strcmp(name, "LINK_FAULT") ) {
+			LINK_FAULTS.push_back(value);
+		}
+		else if ( 0 == strcmp(name, "WORKLOAD_RECORDS") ) {
+			WORKLOAD_RECORDS = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "WORKLOAD_OPS_PER_TICK") ) {
+			WORKLOAD_OPS_PER_TICK = atof(value);
+		}
+		else if ( 0 == strcmp(name, "WORKLOAD_TICKS") ) {
+			WORKLOAD_TICKS = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "WORKLOAD_READ") ) {
+			WORKLOAD_READ = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "WORKLOAD_UPDATE") ) {
+			WORKLOAD_UPDATE = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "WORKLOAD_INSERT") ) {
+			WORKLOAD_INSERT = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "WORKLOAD_SCAN") ) {
+			WORKLOAD_SCAN = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "WORKLOAD_SCAN_LENGTH") ) {
+			WORKLOAD_SCAN_LENGTH = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "WORKLOAD_DISTRIBUTION") ) {
+			if ( 0 == strcmp(value, "UNIFORM") ) {
+				WORKLOAD_DISTRIBUTION = UNIFORM_KEYS;
+			}
+			else if ( 0 == strcmp(value, "ZIPFIAN") ) {
+				WORKLOAD_DISTRIBUTION = ZIPFIAN_KEYS;
+			}
+			else if ( 0 == strcmp(value, "LATEST") ) {
+				WORKLOAD_DISTRIBUTION = LATEST_KEYS;
+			}
+		}
+		else if ( 0 == strcmp(name, "WORKLOAD_ZIPF_THETA") ) {
+			WORKLOAD_ZIPF_THETA = atof(value);
+		}
+		else if ( 0 == strcmp(name, "WORKLOAD_VALUE_MIN") ) {
+			WORKLOAD_VALUE_MIN = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "WORKLOAD_VALUE_MAX") ) {
+			WORKLOAD_VALUE_MAX = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "WORKLOAD_FAIL_NODES") ) {
+			WORKLOAD_FAIL_NODES = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "WORKLOAD_LEAVE_NODES") ) {
+			WORKLOAD_LEAVE_NODES = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "MP1_LEGACY_NODES") ) {
+			MP1_LEGACY_NODES = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "FAILURE_DETECTOR") ) {
+			if ( 0 == strcmp(value, "HEARTBEAT") ) {
+				FAILURE_DETECTOR = HEARTBEAT_DETECTOR;
+			}
+			else if ( 0 == strcmp(value, "SWIM") ) {
+				FAILURE_DETECTOR = SWIM_DETECTOR;
+			}
+			else if ( 0 == strcmp(value, "PHI") ) {
+				FAILURE_DETECTOR = PHI_DETECTOR;
+			}
+		}
+		else if ( 0 == strcmp(name, "SWIM_PERIOD") ) {
+			SWIM_PERIOD = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "SWIM_ACK_TIMEOUT") ) {
+			SWIM_ACK_TIMEOUT = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "SWIM_INDIRECT_PROBES") ) {
+			SWIM_INDIRECT_PROBES = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "SWIM_SUSPECT_TIMEOUT") ) {
+			SWIM_SUSPECT_TIMEOUT = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "SWIM_PIGGYBACK") ) {
+			SWIM_PIGGYBACK = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "PHI_THRESHOLD") ) {
+			PHI_THRESHOLD = atof(value);
+		}
+		else if ( 0 == strcmp(name, "PHI_WINDOW") ) {
+			PHI_WINDOW = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "PHI_MIN_STD_DEV") ) {
+			PHI_MIN_STD_DEV = atof(value);
+		}
+		else if ( 0 == strcmp(name, "PHI_ACCEPTABLE_PAUSE") ) {
+			PHI_ACCEPTABLE_PAUSE = atof(value);
+		}
+		else if ( 0 == strcmp(name, "CAPTURE") ) {
+			CAPTURE = atoi(value);
+		}
+		else if ( 0 == strcmp(name, "SEED") ) {
+			SEED = strtoull(value, NULL, 10);
+		}
 	}
-	else if ( 0 == strcmp(CRUD, "READ") ) {
-		this->CRUDTEST = READ_TEST;
+
+	//printf("Parameters of the test case: %d %d %d %lf\n", MAX_NNB, SINGLE_FAILURE, DROP_MSG, MSG_DROP_PROB);
+
+	if ( SWIM_DETECTOR == FAILURE_DETECTOR && MP1_LEGACY_NODES > 0 ) {
+		printf("FAILURE_DETECTOR SWIM needs every node on wire format 4, set MP1_LEGACY_NODES to 0\n");
+		exit(1);
 	}
-	else if ( 0 == strcmp(CRUD, "UPDATE") ) {
-		this->CRUDTEST = UPDATE_TEST;
+	if ( LSM_STORAGE == STORAGE_ENGINE && SNAPSHOT_RESTORE ) {
+		printf("SNAPSHOT_RESTORE is not supported by STORAGE_ENGINE LSM\n");
+		exit(1);
 	}
-	else if ( 0 == strcmp(CRUD, "DELETE") ) {
-		this->CRUDTEST = DELETE_TEST;
+	if ( WORKLOAD_ZIPF_THETA <= 0 || WORKLOAD_ZIPF_THETA >= 1 ) {
+		printf("WORKLOAD_ZIPF_THETA must be between 0 and 1, not %g\n", WORKLOAD_ZIPF_THETA);
+		exit(1);
 	}
 
-	//printf("Parameters of the test case: %d %d %d %lf\n", MAX_NNB, SINGLE_FAILURE, DROP_MSG, MSG_DROP_PROB);
+	if ( 0 == SEED ) {
+		SEED = Random::clockSeed();
+	}
 
 	EN_GPSZ = MAX_NNB;
 	STEP_RATE=.25;
@@ -11,7 +11,11 @@
 #include "Params.h"
 #include "Member.h"
 
-enum testTYPE { CREATE_TEST, READ_TEST, UPDATE_TEST, DELETE_TEST };
+enum testTYPE { CREATE_TEST, READ_TEST, UPDATE_TEST, DELETE_TEST, WORKLOAD_TEST };
+enum storageTYPE { MEMORY_STORAGE, LSM_STORAGE };
+enum delayMODEL { FIXED_DELAY, UNIFORM_DELAY, LOGNORMAL_DELAY };
+enum keyDISTRIBUTION { UNIFORM_KEYS, ZIPFIAN_KEYS, LATEST_KEYS };
+enum detectorTYPE { HEARTBEAT_DETECTOR, SWIM_DETECTOR, PHI_DETECTOR };
 
 /**
  * CLASS NAME: Params
@@ -32,6 +36,52 @@ public:
 	int allNodesJoined;
 	short PORTNUM;
 	int CRUDTEST;
+	int SNAPSHOT_INTERVAL;		// ticks between HashTable snapshots, 0 disables them
+	int SNAPSHOT_RESTORE;		// restore each node's HashTable from its last snapshot at start, MEMORY engine only
+	int STORAGE_ENGINE;			// storageTYPE backing each node's HashTable
+	int LSM_MEMTABLE_KB;		// memtable size at which the LSM engine flushes a run
+	int LSM_MAX_RUNS;			// number of LSM runs above which they are compacted
+	int MEMORY_BUDGET_KB;		// per node HashTable budget, evicting above it; 0 is unlimited
+	int EVICT_HIGH_WATERMARK;	// percent of the budget at which eviction starts
+	int EVICT_LOW_WATERMARK;	// percent of the budget eviction brings usage back down to
+	int EVENT_LOG;				// record Log::log* events in the binary dbg.bin instead of dbg.log
+	int TRACE;					// collect spans and write them to trace.json at the end of the run
+	int METRICS_INTERVAL;		// ticks between rows of metrics.csv, 0 disables it
+	int NET_DELAY_MODEL;		// delayMODEL drawing the latency of each message
+	double NET_DELAY;			// fixed latency, lower bound of uniform, median of log-normal, in ticks
+	double NET_DELAY_MAX;		// upper bound of the uniform latency, in ticks
+	double NET_DELAY_SIGMA;		// shape of the log-normal latency
+	double NET_JITTER;			// extra latency drawn uniformly from [0, NET_JITTER] ticks
+	int NET_BANDWIDTH;			// bytes per tick each link carries, 0 is unlimited
+	vector<string> PARTITIONS;	// PARTITION lines, see LinkFaults
+	vector<string> LINK_FAULTS;	// LINK_FAULT lines, see LinkFaults
+	int WORKLOAD_RECORDS;		// keys the workload loads before its run phase
+	double WORKLOAD_OPS_PER_TICK;	// client operations the workload issues per tick
+	int WORKLOAD_TICKS;			// length of the run phase
+	int WORKLOAD_READ;			// percent of run phase operations that are reads
+	int WORKLOAD_UPDATE;		// ... updates
+	int WORKLOAD_INSERT;		// ... inserts of new keys
+	int WORKLOAD_SCAN;			// ... scans
+	int WORKLOAD_SCAN_LENGTH;	// keys read by a scan
+	int WORKLOAD_DISTRIBUTION;	// keyDISTRIBUTION of the keys operations pick
+	double WORKLOAD_ZIPF_THETA;	// skew of the zipfian and latest distributions, in (0, 1)
+	int WORKLOAD_VALUE_MIN;		// value size in bytes, drawn uniformly from [MIN, MAX]
+	int WORKLOAD_VALUE_MAX;
+	int WORKLOAD_FAIL_NODES;	// nodes failed as the run phase starts; DROP_MSG drops over the run phase
+	int WORKLOAD_LEAVE_NODES;	// nodes that leave gracefully as the run phase starts
+	int CAPTURE;				// write every delivered message to <network>.cap for Replay
+	int MP1_LEGACY_NODES;		// nodes 1 to n only understand MP1 wire format 1, as before an upgrade
+	int FAILURE_DETECTOR;		// detectorTYPE of MP1Node; SWIM needs every node on wire format 4
+	int SWIM_PERIOD;			// ticks between the probes of a node
+	int SWIM_ACK_TIMEOUT;		// ticks without an ack before other members are asked to probe
+	int SWIM_INDIRECT_PROBES;	// members asked to probe on the node's behalf
+	int SWIM_SUSPECT_TIMEOUT;	// ticks a member stays suspected before it is removed
+	int SWIM_PIGGYBACK;			// membership updates carried by each message
+	double PHI_THRESHOLD;		// phi accrual suspicion level a member is removed at
+	int PHI_WINDOW;				// heartbeat inter-arrival times kept per member, up to ARRIVAL_WINDOW_MAX
+	double PHI_MIN_STD_DEV;		// ticks, floor of the inter-arrival standard deviation
+	double PHI_ACCEPTABLE_PAUSE;	// ticks a member may be silent beyond its mean interval
+	unsigned long long SEED;	// seeds every Random stream; 0 or unset picks one from the clock
 	Params();
 	void setparams(char *);
 	int getcurrtime();
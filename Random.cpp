@@ -0,0 +1,61 @@
+/**********************************
+ * FILE NAME: Random.cpp
+ *
+ * DESCRIPTION: Seedable random number streams definition
+ **********************************/
+
+#include "Random.h"
+
+#include <sys/time.h>
+
+/**
+ * FUNCTION NAME: splitmix64
+ *
+ * DESCRIPTION: Next output of a splitmix64 generator at state x
+ */
+static uint64_t splitmix64(uint64_t &x) {
+	uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+/**
+ * Constructor
+ */
+Random::Random(uint64_t seed, const char *subsystem, int node) {
+	this->seed(seed, subsystem, node);
+}
+
+/**
+ * FUNCTION NAME: seed
+ *
+ * DESCRIPTION: Restart as the stream of subsystem on node under seed
+ */
+void Random::seed(uint64_t seed, const char *subsystem, int node) {
+	// FNV-1a of the subsystem name, then the node
+	uint64_t stream = 0xcbf29ce484222325ULL;
+	for ( const char *c = subsystem; *c; c++ ) {
+		stream = (stream ^ (unsigned char)*c) * 0x100000001b3ULL;
+	}
+	stream = (stream ^ (uint64_t)(uint32_t)node) * 0x100000001b3ULL;
+
+	uint64_t x = seed;
+	x = splitmix64(x) ^ stream;
+	for ( int i = 0; i < 4; i++ ) {
+		s[i] = splitmix64(x);
+	}
+}
+
+/**
+ * FUNCTION NAME: clockSeed
+ *
+ * DESCRIPTION: A fresh nonzero seed for runs that do not set one
+ */
+uint64_t Random::clockSeed() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	uint64_t x = ((uint64_t)tv.tv_sec << 20) ^ (uint64_t)tv.tv_usec ^ ((uint64_t)getpid() << 40);
+	uint64_t seed = splitmix64(x);
+	return seed != 0 ? seed : 1;
+}
@@ -0,0 +1,53 @@
+/**********************************
+ * FILE NAME: Random.h
+ *
+ * DESCRIPTION: Header file of the seedable random number streams
+ **********************************/
+
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+#include "stdincludes.h"
+
+#include <stdint.h>
+
+/**
+ * CLASS NAME: Random
+ *
+ * DESCRIPTION: xoshiro256** generator. Every (subsystem, node) pair draws from
+ * 				its own stream, derived from the run's SEED, so what one node or
+ * 				subsystem draws never depends on how often the others drew
+ * 				before it, and a run is reproduced by reusing its seed.
+ */
+class Random {
+private:
+	uint64_t s[4];
+	static uint64_t rotl(uint64_t x, int k) {
+		return (x << k) | (x >> (64 - k));
+	}
+public:
+	Random(uint64_t seed = 0, const char *subsystem = "", int node = 0);
+	void seed(uint64_t seed, const char *subsystem, int node);
+	uint64_t next() {
+		uint64_t result = rotl(s[1] * 5, 7) * 9;
+		uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+	// uniform in [0, n), n > 0
+	uint32_t below(uint32_t n) {
+		return (uint32_t)(((next() >> 32) * n) >> 32);
+	}
+	// uniform in [0, 1)
+	double uniform() {
+		return (next() >> 11) * (1.0 / 9007199254740992.0);
+	}
+	static uint64_t clockSeed();
+};
+
+#endif /* RANDOM_H_ */
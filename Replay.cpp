@@ -0,0 +1,200 @@
+/**********************************
+ * FILE NAME: Replay.cpp
+ *
+ * DESCRIPTION: Feeds a capture written with "CAPTURE: 1" into a single node, as
+ * 				fast as its handlers take it, and reports messages per second.
+ * 				Only MP1Node::checkMessages or MP2Node::checkMessages is timed;
+ * 				queueing the messages and draining what the node sends are not.
+ * 				The node logs to dbg.log as it would in a run.
+ *
+ * RUN PROCEDURE:
+ * $ ./Replay testcases/create.conf mp2.net.cap <node id> [repetitions]
+ **********************************/
+
+#include "MP1Node.h"
+#include "MP2Node.h"
+#include "Capture.h"
+
+#include <chrono>
+
+/**
+ * STRUCT NAME: ReplayResult
+ *
+ * DESCRIPTION: Messages handled and the time the handlers took
+ */
+struct ReplayResult {
+	uint64_t messages;
+	double seconds;
+	ReplayResult(): messages(0), seconds(0) {}
+};
+
+/**
+ * FUNCTION NAME: collect
+ *
+ * DESCRIPTION: EmulNet enqueue function that keeps what the node sent, to be freed
+ */
+static int collect(void *env, char *buff, int size) {
+	((vector<char *> *)env)->push_back(buff);
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: drain
+ *
+ * DESCRIPTION: Throw away every message in flight on en
+ */
+static void drain(EmulNet& en, vector<Address>& addrs) {
+	vector<char *> sent;
+	for ( size_t id = 1; id < addrs.size(); id++ ) {
+		en.ENrecv(&addrs[id], collect, NULL, 1, &sent);
+	}
+	for ( size_t i = 0; i < sent.size(); i++ ) {
+		free(sent[i]);
+	}
+}
+
+/**
+ * FUNCTION NAME: replay
+ *
+ * DESCRIPTION: Replay the messages to node of a capture into a fresh node. Messages
+ * 				delivered at the same tick are handled in one checkMessages call.
+ */
+static ReplayResult replay(Params *par, const CaptureHeader& header, const vector<char>& records, int node) {
+	ReplayResult result;
+	// EmulNet is too big for the stack
+	EmulNet *en = new EmulNet(par, "replay.net");
+	Log log(par);
+	// owned by the MP2Node, if there is one
+	Member *member = new Member;
+	vector<Address> addrs(header.nodes + 1);
+	for ( uint32_t id = 1; id <= header.nodes; id++ ) {
+		en->ENinit(&addrs[id], par->PORTNUM);
+	}
+
+	bool kv = 0 == strcmp(header.protocol, "kv");
+	MP1Node *mp1 = NULL;
+	MP2Node *mp2 = NULL;
+	par->globaltime = 0;
+	if ( kv ) {
+		// the whole cluster is up, as it is by the time the KV store runs
+		mp2 = new MP2Node(member, par, en, &log, &addrs[node]);
+		member->inited = true;
+		member->inGroup = true;
+		for ( uint32_t id = 1; id <= header.nodes; id++ ) {
+			if ( (int)id != node ) {
+				member->memberList.push_back(MemberListEntry(id, 0, 0, 0));
+			}
+		}
+		mp2->updateRing();
+	}
+	else {
+		// the node joins as it did in the run; the capture has the replies
+		mp1 = new MP1Node(member, par, en, &log, &addrs[node]);
+		mp1->nodeStart(NULL, par->PORTNUM);
+	}
+	drain(*en, addrs);
+
+	queue<q_elt> &q = kv ? member->mp2q : member->mp1q;
+	vector<char *> batch;
+	size_t pos = 0;
+	bool truncated = false;
+	while ( !truncated && pos + sizeof(CaptureRecord) <= records.size() ) {
+		CaptureRecord record;
+		memcpy(&record, &records[pos], sizeof(record));
+		uint32_t tick = record.time;
+
+		// queue the messages to node delivered at this tick
+		while ( pos + sizeof(record) <= records.size() ) {
+			memcpy(&record, &records[pos], sizeof(record));
+			if ( record.time != tick ) {
+				break;
+			}
+			if ( pos + sizeof(record) + record.size > records.size() ) {
+				truncated = true;
+				break;
+			}
+			if ( record.to == node ) {
+				char *data = (char *)malloc(record.size);
+				memcpy(data, &records[pos + sizeof(record)], record.size);
+				Queue::enqueue(&q, data, record.size);
+				batch.push_back(data);
+			}
+			pos += sizeof(record) + record.size;
+		}
+		if ( batch.empty() ) {
+			continue;
+		}
+
+		par->globaltime = tick;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		if ( kv ) {
+			mp2->checkMessages();
+		}
+		else {
+			mp1->checkMessages();
+		}
+		result.seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		result.messages += batch.size();
+
+		for ( size_t i = 0; i < batch.size(); i++ ) {
+			free(batch[i]);
+		}
+		batch.clear();
+		drain(*en, addrs);
+	}
+
+	if ( kv ) {
+		delete mp2;
+	}
+	else {
+		delete mp1;
+		delete member;
+	}
+	delete en;
+	return result;
+}
+
+/**********************************
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: main function. Replay the capture named on the command line
+ **********************************/
+int main(int argc, char *argv[]) {
+	if ( argc != 4 && argc != 5 ) {
+		fprintf(stderr, "Usage: %s <test case .conf> <capture%s> <node id> [repetitions]\n", argv[0], CAPTURE_SUFFIX);
+		return FAILURE;
+	}
+	Params *par = new Params();
+	par->setparams(argv[1]);
+
+	CaptureHeader header;
+	vector<char> records;
+	if ( !Capture::load(argv[2], header, records) ) {
+		fprintf(stderr, "Unable to read capture %s\n", argv[2]);
+		return FAILURE;
+	}
+	int node = atoi(argv[3]);
+	int repetitions = argc == 5 ? atoi(argv[4]) : 1;
+	if ( node < 1 || node > (int)header.nodes || repetitions < 1 ) {
+		fprintf(stderr, "Node id must be in [1, %u] and repetitions positive\n", header.nodes);
+		return FAILURE;
+	}
+	// the node gets the same cluster size as the captured run
+	par->EN_GPSZ = header.nodes;
+
+	printf("%s capture of %u nodes, %zu bytes, replayed into node %d\n", header.protocol, header.nodes, records.size(), node);
+	ReplayResult total;
+	for ( int i = 0; i < repetitions; i++ ) {
+		ReplayResult r = replay(par, header, records, node);
+		printf("run %-3d %10llu messages %10.6f s %12.0f messages/s %10.3f us/message\n", i + 1, (unsigned long long)r.messages,
+				r.seconds, r.seconds > 0 ? r.messages / r.seconds : 0.0, r.messages > 0 ? 1e6 * r.seconds / r.messages : 0.0);
+		total.messages += r.messages;
+		total.seconds += r.seconds;
+	}
+	printf("all     %10llu messages %10.6f s %12.0f messages/s %10.3f us/message\n", (unsigned long long)total.messages,
+			total.seconds, total.seconds > 0 ? total.messages / total.seconds : 0.0,
+			total.messages > 0 ? 1e6 * total.seconds / total.messages : 0.0);
+
+	delete par;
+	return SUCCESS;
+}
@@ -0,0 +1,424 @@
+/**********************************
+ * FILE NAME: Snapshot.cpp
+ *
+ * DESCRIPTION: Snapshot writer and memory mapped snapshot reader
+ **********************************/
+
+#include "Snapshot.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Constructor
+ */
+SnapshotWriter::SnapshotWriter(): fp(NULL), keysFp(NULL), ok(false), flags(0), keysSize(0), valuesSize(0) {}
+
+/**
+ * Destructor
+ */
+SnapshotWriter::~SnapshotWriter() {
+	abort();
+}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Start a new snapshot at path
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool SnapshotWriter::open(const string& path) {
+	abort();
+	this->path = path;
+	fp = fopen((path + ".tmp").c_str(), "wb");
+	keysFp = fopen((path + ".keys.tmp").c_str(), "w+b");
+	flags = 0;
+	keysSize = 0;
+	valuesSize = 0;
+	index.clear();
+	ok = NULL != fp && NULL != keysFp;
+	if ( ok ) {
+		// the header is rewritten by finish()
+		SnapshotHeader header;
+		memset(&header, 0, sizeof(header));
+		ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+	}
+	if ( !ok ) {
+		abort();
+	}
+	return ok;
+}
+
+/**
+ * FUNCTION NAME: append
+ *
+ * DESCRIPTION: Add one index entry, its key and its value bytes
+ */
+bool SnapshotWriter::append(const string& key, const char *value, uint32_t valueLength) {
+	if ( !ok ) {
+		return false;
+	}
+	SnapshotIndexEntry entry;
+	entry.keyOffset = keysSize;
+	entry.valueOffset = valuesSize;
+	entry.keyLength = (uint32_t)key.size();
+	entry.valueLength = valueLength;
+	index.push_back(entry);
+	ok = fwrite(key.data(), 1, key.size(), keysFp) == key.size();
+	keysSize += key.size();
+	if ( ok && valueLength != SNAPSHOT_TOMBSTONE ) {
+		ok = fwrite(value, 1, valueLength, fp) == valueLength;
+		valuesSize += valueLength;
+	}
+	return ok;
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Add a (key, value) pair
+ */
+bool SnapshotWriter::add(const string& key, const string& value) {
+	return append(key, value.data(), (uint32_t)value.size());
+}
+
+/**
+ * FUNCTION NAME: addTombstone
+ *
+ * DESCRIPTION: Record that key is deleted, shadowing older snapshots that have it
+ */
+bool SnapshotWriter::addTombstone(const string& key) {
+	flags |= SNAPSHOT_FLAG_TOMBSTONES;
+	return append(key, NULL, SNAPSHOT_TOMBSTONE);
+}
+
+/**
+ * FUNCTION NAME: count
+ *
+ * DESCRIPTION: Number of entries added so far
+ */
+uint64_t SnapshotWriter::count() const {
+	return index.size();
+}
+
+/**
+ * FUNCTION NAME: finish
+ *
+ * DESCRIPTION: Append the keys blob and the index, fill in the header, sync
+ * 				the file and move it into place
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool SnapshotWriter::finish() {
+	char buffer[65536];
+	size_t n;
+
+	if ( !ok ) {
+		abort();
+		return false;
+	}
+
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.flags = flags;
+	header.count = index.size();
+	header.valuesOffset = sizeof(SnapshotHeader);
+	header.keysOffset = header.valuesOffset + valuesSize;
+	// pad so that the index entries are aligned in the mapping
+	header.indexOffset = header.keysOffset + keysSize;
+	uint64_t padding = (alignof(SnapshotIndexEntry) - header.indexOffset % alignof(SnapshotIndexEntry)) % alignof(SnapshotIndexEntry);
+	header.indexOffset += padding;
+	header.fileSize = header.indexOffset + header.count * sizeof(SnapshotIndexEntry);
+
+	rewind(keysFp);
+	while ( ok && (n = fread(buffer, 1, sizeof(buffer), keysFp)) > 0 ) {
+		ok = fwrite(buffer, 1, n, fp) == n;
+	}
+	if ( ok && padding > 0 ) {
+		memset(buffer, 0, padding);
+		ok = fwrite(buffer, 1, padding, fp) == padding;
+	}
+	if ( ok && !index.empty() ) {
+		ok = fwrite(&index.front(), sizeof(SnapshotIndexEntry), index.size(), fp) == index.size();
+	}
+	if ( ok ) {
+		ok = 0 == fseek(fp, 0, SEEK_SET) && fwrite(&header, sizeof(header), 1, fp) == 1;
+	}
+	// the data must be on disk before the rename makes it the snapshot
+	if ( ok ) {
+		ok = 0 == fflush(fp) && 0 == fsync(fileno(fp));
+	}
+	if ( 0 != fclose(fp) ) {
+		ok = false;
+	}
+	fp = NULL;
+	if ( ok ) {
+		ok = 0 == rename((path + ".tmp").c_str(), path.c_str());
+	}
+	if ( !ok ) {
+		// fp is already closed, so abort() would leave the temporary file behind
+		unlink((path + ".tmp").c_str());
+		abort();
+		return false;
+	}
+	abort();
+	return true;
+}
+
+/**
+ * FUNCTION NAME: abort
+ *
+ * DESCRIPTION: Drop the temporary files
+ */
+void SnapshotWriter::abort() {
+	if ( NULL != fp ) {
+		fclose(fp);
+		fp = NULL;
+		unlink((path + ".tmp").c_str());
+	}
+	if ( NULL != keysFp ) {
+		fclose(keysFp);
+		keysFp = NULL;
+		unlink((path + ".keys.tmp").c_str());
+	}
+	index.clear();
+	ok = false;
+}
+
+/**
+ * FUNCTION NAME: write
+ *
+ * DESCRIPTION: Write the whole table to path. Keys come out of the map already sorted,
+ * 				which is what the reader's binary search relies on.
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool SnapshotWriter::write(const string& path, const map<string, string>& table) {
+	SnapshotWriter writer;
+	if ( !writer.open(path) ) {
+		return false;
+	}
+	for ( map<string, string>::const_iterator it = table.begin(); it != table.end(); ++it ) {
+		if ( !writer.add(it->first, it->second) ) {
+			return false;
+		}
+	}
+	return writer.finish();
+}
+
+/**
+ * Constructor
+ */
+SnapshotReader::SnapshotReader(): fd(-1), base(NULL), length(0), header(NULL), index(NULL), keys(NULL), values(NULL) {}
+
+/**
+ * Destructor
+ */
+SnapshotReader::~SnapshotReader() {
+	close();
+}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Map the snapshot file and validate its header and the bounds of
+ * 				every index entry, so that lookups can trust the index
+ *
+ * RETURNS:
+ * true on SUCCESS
+ * false on FAILURE
+ */
+bool SnapshotReader::open(const string& path) {
+	struct stat st;
+
+	close();
+	fd = ::open(path.c_str(), O_RDONLY);
+	if ( fd < 0 ) {
+		return false;
+	}
+	if ( fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader) ) {
+		close();
+		return false;
+	}
+	length = st.st_size;
+	void *mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if ( MAP_FAILED == mapped ) {
+		base = NULL;
+		close();
+		return false;
+	}
+	base = (char *)mapped;
+	header = (const SnapshotHeader *)base;
+
+	// written so that a corrupt offset or count cannot overflow the checks
+	if ( memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+		 header->version != SNAPSHOT_VERSION ||
+		 header->fileSize != length ||
+		 header->indexOffset > header->fileSize ||
+		 header->indexOffset % alignof(SnapshotIndexEntry) != 0 ||
+		 header->count > (header->fileSize - header->indexOffset) / sizeof(SnapshotIndexEntry) ||
+		 header->keysOffset > header->fileSize ||
+		 header->valuesOffset > header->fileSize ) {
+		close();
+		return false;
+	}
+	index = (const SnapshotIndexEntry *)(base + header->indexOffset);
+	keys = base + header->keysOffset;
+	values = base + header->valuesOffset;
+
+	uint64_t keysRoom = header->fileSize - header->keysOffset;
+	uint64_t valuesRoom = header->fileSize - header->valuesOffset;
+	for ( uint64_t i = 0; i < header->count; i++ ) {
+		const SnapshotIndexEntry& entry = index[i];
+		if ( entry.keyOffset > keysRoom || entry.keyLength > keysRoom - entry.keyOffset ||
+			 (entry.valueLength != SNAPSHOT_TOMBSTONE &&
+			  (entry.valueOffset > valuesRoom || entry.valueLength > valuesRoom - entry.valueOffset)) ) {
+			close();
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: close
+ *
+ * DESCRIPTION: Unmap the file
+ */
+void SnapshotReader::close() {
+	if ( NULL != base ) {
+		munmap(base, length);
+	}
+	if ( fd >= 0 ) {
+		::close(fd);
+	}
+	fd = -1;
+	base = NULL;
+	length = 0;
+	header = NULL;
+	index = NULL;
+	keys = NULL;
+	values = NULL;
+}
+
+/**
+ * FUNCTION NAME: isOpen
+ *
+ * DESCRIPTION: Returns if a snapshot is mapped
+ */
+bool SnapshotReader::isOpen() const {
+	return NULL != header;
+}
+
+/**
+ * FUNCTION NAME: size
+ *
+ * DESCRIPTION: Returns the number of keys in the snapshot
+ */
+uint64_t SnapshotReader::size() const {
+	return isOpen() ? header->count : 0;
+}
+
+/**
+ * FUNCTION NAME: compare
+ *
+ * DESCRIPTION: Compare the i-th key of the snapshot with key, strcmp style
+ */
+int SnapshotReader::compare(uint64_t i, const string& key) const {
+	const SnapshotIndexEntry& entry = index[i];
+	size_t n = min((size_t)entry.keyLength, key.size());
+	int rc = memcmp(keys + entry.keyOffset, key.data(), n);
+	if ( rc != 0 ) {
+		return rc;
+	}
+	if ( entry.keyLength == key.size() ) {
+		return 0;
+	}
+	return entry.keyLength < key.size() ? -1 : 1;
+}
+
+/**
+ * FUNCTION NAME: search
+ *
+ * DESCRIPTION: Binary search for key in the index
+ *
+ * RETURNS:
+ * true if the key has an entry, position is set to it
+ * false otherwise
+ */
+bool SnapshotReader::search(const string& key, uint64_t& position) const {
+	uint64_t lo = 0;
+	uint64_t hi = size();
+	while ( lo < hi ) {
+		uint64_t mid = lo + (hi - lo) / 2;
+		int rc = compare(mid, key);
+		if ( rc == 0 ) {
+			position = mid;
+			return true;
+		}
+		if ( rc < 0 ) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: find
+ *
+ * DESCRIPTION: Look up the value of key
+ *
+ * RETURNS:
+ * true if found, value is filled in
+ * false if the key is absent or is a tombstone
+ */
+bool SnapshotReader::find(const string& key, string& value) const {
+	uint64_t i;
+	if ( !search(key, i) || isTombstone(i) ) {
+		return false;
+	}
+	value.assign(values + index[i].valueOffset, index[i].valueLength);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: isTombstone
+ *
+ * DESCRIPTION: Returns if the i-th entry records a deleted key
+ */
+bool SnapshotReader::isTombstone(uint64_t i) const {
+	return index[i].valueLength == SNAPSHOT_TOMBSTONE;
+}
+
+/**
+ * FUNCTION NAME: keyAt
+ *
+ * DESCRIPTION: Returns the i-th key in sorted order
+ */
+string SnapshotReader::keyAt(uint64_t i) const {
+	return string(keys + index[i].keyOffset, index[i].keyLength);
+}
+
+/**
+ * FUNCTION NAME: valueAt
+ *
+ * DESCRIPTION: Returns the value of the i-th key
+ */
+string SnapshotReader::valueAt(uint64_t i) const {
+	if ( isTombstone(i) ) {
+		return "";
+	}
+	return string(values + index[i].valueOffset, index[i].valueLength);
+}
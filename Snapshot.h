@@ -0,0 +1,121 @@
+/**********************************
+ * FILE NAME: Snapshot.h
+ *
+ * DESCRIPTION: Header file of the on-disk HashTable snapshot format
+ **********************************/
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+#include "stdincludes.h"
+
+#include <stdint.h>
+
+/*
+ * Macros
+ */
+#define SNAPSHOT_MAGIC "KVSNAP\0\1"
+// 2: the index is aligned
+#define SNAPSHOT_VERSION 2
+// header flag: some index entries are tombstones
+#define SNAPSHOT_FLAG_TOMBSTONES 0x1
+// valueLength of an index entry recording a deleted key
+#define SNAPSHOT_TOMBSTONE 0xFFFFFFFFu
+
+/*
+ * File layout (all integers in host byte order):
+ *
+ *   SnapshotHeader
+ *   values blob                  value bytes, back to back
+ *   keys blob                    key bytes, back to back, sorted
+ *   padding                      zeros up to the alignment of SnapshotIndexEntry
+ *   SnapshotIndexEntry[count]    fixed stride, sorted by key
+ *
+ * Offsets in the index are relative to the start of the keys blob and the
+ * values blob respectively, so a lookup is a binary search over the index
+ * followed by one memcmp per probe. Readers locate every section through
+ * the header, so the order of the sections is up to the writer.
+ */
+struct SnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint64_t count;
+	uint64_t indexOffset;
+	uint64_t keysOffset;
+	uint64_t valuesOffset;
+	uint64_t fileSize;
+};
+
+struct SnapshotIndexEntry {
+	uint64_t keyOffset;
+	uint64_t valueOffset;
+	uint32_t keyLength;
+	uint32_t valueLength;
+};
+
+/**
+ * CLASS NAME: SnapshotWriter
+ *
+ * DESCRIPTION: Streams sorted (key, value) pairs into a snapshot file.
+ * 				Values go straight to the file, keys to a side file that is
+ * 				appended at the end, so memory use is the index only.
+ * 				The file is written under a temporary name, synced and renamed
+ * 				into place by finish(), so a reader never sees a partial snapshot.
+ */
+class SnapshotWriter {
+private:
+	string path;
+	FILE *fp;
+	FILE *keysFp;
+	bool ok;
+	uint32_t flags;
+	uint64_t keysSize;
+	uint64_t valuesSize;
+	vector<SnapshotIndexEntry> index;
+	bool append(const string& key, const char *value, uint32_t valueLength);
+public:
+	SnapshotWriter();
+	bool open(const string& path);
+	// keys must be added in ascending order
+	bool add(const string& key, const string& value);
+	bool addTombstone(const string& key);
+	uint64_t count() const;
+	bool finish();
+	void abort();
+	virtual ~SnapshotWriter();
+	static bool write(const string& path, const map<string, string>& table);
+};
+
+/**
+ * CLASS NAME: SnapshotReader
+ *
+ * DESCRIPTION: Read-only view of a snapshot file mapped into memory.
+ * 				Opening validates the header and one pass over the index;
+ * 				keys and values are not touched until they are looked up.
+ */
+class SnapshotReader {
+private:
+	int fd;
+	char *base;
+	size_t length;
+	const SnapshotHeader *header;
+	const SnapshotIndexEntry *index;
+	const char *keys;
+	const char *values;
+	int compare(uint64_t i, const string& key) const;
+public:
+	SnapshotReader();
+	bool open(const string& path);
+	void close();
+	bool isOpen() const;
+	uint64_t size() const;
+	bool search(const string& key, uint64_t& position) const;
+	bool find(const string& key, string& value) const;
+	bool isTombstone(uint64_t i) const;
+	string keyAt(uint64_t i) const;
+	string valueAt(uint64_t i) const;
+	virtual ~SnapshotReader();
+};
+
+#endif /* SNAPSHOT_H_ */
@@ -0,0 +1,49 @@
+/**********************************
+ * FILE NAME: StorageEngine.h
+ *
+ * DESCRIPTION: Interface implemented by the storage engines behind HashTable
+ **********************************/
+
+#ifndef STORAGEENGINE_H_
+#define STORAGEENGINE_H_
+
+#include "stdincludes.h"
+
+#include <functional>
+
+typedef function<void(const string&, const string&)> KeyValueVisitor;
+
+/**
+ * CLASS NAME: StorageEngine
+ *
+ * DESCRIPTION: A storage engine keeps the (key, value) pairs of one node.
+ * 				create/update/deleteKey have the same semantics as the
+ * 				HashTable methods of the same name. They take the value by
+ * 				value so that the table can move it in.
+ */
+class StorageEngine {
+public:
+	StorageEngine() {}
+	virtual ~StorageEngine() {}
+	virtual bool get(const string& key, string& value) = 0;
+	// whether key exists, without copying its value out
+	virtual bool contains(const string& key) {
+		string value;
+		return get(key, value);
+	}
+	virtual bool create(const string& key, string value) = 0;
+	virtual bool update(const string& key, string value) = 0;
+	virtual bool deleteKey(const string& key) = 0;
+	virtual unsigned long size() = 0;
+	virtual void clear() = 0;
+	// visit every live pair, in no particular order
+	virtual void forEach(const KeyValueVisitor& visit) = 0;
+	// pick up finished background work; called once per tick
+	virtual void maintain() {}
+	virtual bool snapshot(const string& path) { return false; }
+	virtual bool restore(const string& path) { return false; }
+	// snapshots started by snapshot() that could not be written, so far
+	virtual unsigned long snapshotFailures() { return 0; }
+};
+
+#endif /* STORAGEENGINE_H_ */
@@ -17,6 +17,10 @@
  */
 #include "Trace.h"
 
+#include <chrono>
+#include <mutex>
+#include <atomic>
+
 /*****************************************************************
  * NAME: traceFileCreate
  *
@@ -132,3 +136,103 @@ int Trace::funcExit(char *funcName, int f_rc) {
 
     return rc;
 }
+
+/*
+ * Span buffers. Each thread appends to its own buffer without locking;
+ * the lock is only taken to register a new thread and to write the trace.
+ */
+bool Trace::spansEnabled = false;
+static const int *spanTime = NULL;
+static chrono::steady_clock::time_point spanEpoch;
+static mutex spanBuffersLock;
+static vector<vector<TraceSpan> *> spanBuffers;
+static atomic<unsigned long> spansDropped(0);
+static thread_local vector<TraceSpan> *spanBuffer = NULL;
+
+/*****************************************************************
+ * NAME: startSpans
+ *
+ * DESCRIPTION: Start collecting spans. Every span records the
+ *              simulation time found at time next to its wall clock
+ *              timestamps.
+ *
+ ****************************************************************/
+void Trace::startSpans(const int *time) {
+    spanTime = time;
+    spanEpoch = chrono::steady_clock::now();
+    spansEnabled = true;
+}
+
+/*****************************************************************
+ * NAME: now
+ *
+ * DESCRIPTION: Monotonic time since startSpans
+ *
+ * RETURN:
+ * (uint64_t) nanoseconds
+ *
+ ****************************************************************/
+uint64_t Trace::now() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - spanEpoch).count();
+}
+
+/*****************************************************************
+ * NAME: addSpan
+ *
+ * DESCRIPTION: Append a span to the buffer of the calling thread
+ *
+ ****************************************************************/
+void Trace::addSpan(const char *name, const char *category, int node, uint64_t start, uint64_t end) {
+    if ( NULL == spanBuffer ) {
+        spanBuffer = new vector<TraceSpan>();
+        lock_guard<mutex> guard(spanBuffersLock);
+        spanBuffers.push_back(spanBuffer);
+    }
+    if ( spanBuffer->size() >= TRACE_MAX_SPANS ) {
+        spansDropped++;
+        return;
+    }
+    TraceSpan span = { name, category, node, NULL != spanTime ? *spanTime : 0, start, end };
+    spanBuffer->push_back(span);
+}
+
+/*****************************************************************
+ * NAME: writeChromeTrace
+ *
+ * DESCRIPTION: Write every span collected so far as Chrome trace_event
+ *              JSON. Spans become complete ("X") events; pid is the
+ *              recording thread and tid the node.
+ *
+ * PARAMETERS:
+ *            (const char *) path - output file
+ *
+ * RETURN:
+ * (int) SUCCESS
+ *       FAILURE otherwise
+ *
+ ****************************************************************/
+int Trace::writeChromeTrace(const char *path) {
+
+    lock_guard<mutex> guard(spanBuffersLock);
+
+    FILE *fp = fopen(path, "w");
+    if ( NULL == fp ) {
+        printf("\nUnable to open trace file %s in write mode\n", path);
+        return FAILURE;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":%lu},\"traceEvents\":[", spansDropped.load());
+    const char *separator = "\n";
+    for ( size_t pid = 0; pid < spanBuffers.size(); pid++ ) {
+        const vector<TraceSpan>& spans = *spanBuffers[pid];
+        for ( size_t i = 0; i < spans.size(); i++ ) {
+            const TraceSpan& span = spans[i];
+            fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%zu,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"time\":%d}}",
+                    separator, span.name, span.category, pid, span.node, span.start / 1000.0, (span.end - span.start) / 1000.0, span.time);
+            separator = ",\n";
+        }
+    }
+    fprintf(fp, "\n]}\n");
+
+    return 0 == fclose(fp) ? SUCCESS : FAILURE;
+}
@@ -9,15 +9,28 @@
 
 #include "stdincludes.h"
 
+#include <stdint.h>
+
 /*
  * Macros
  */
 #define LOG_FILE_LOCATION "machine.log"
+#define TRACE_FILE_LOCATION "trace.json"
+// spans kept per thread; later ones are counted as dropped
+#define TRACE_MAX_SPANS (1 << 22)
+
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+// trace the rest of the enclosing block as a span of node
+#define TRACE_SCOPE(name, category, node) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, category, node)
 
 /**
  * CLASS NAME: Trace
  *
- * DESCRIPTION: Creates a trace of function entry, exit and variable values for debugging
+ * DESCRIPTION: Creates a trace of function entry, exit and variable values for debugging.
+ * 				Also collects timed spans, each thread into its own buffer, and
+ * 				writes them out in the Chrome trace_event format for Perfetto
+ * 				or chrome://tracing. Spans of one node share a track.
  */
 class Trace {
 public:
@@ -35,6 +48,49 @@ public:
              char *valueMessage, // Value
              int f_rc = SUCCESS           // Function RC
              );
+
+	// span tracing
+	static bool spansEnabled;
+	static void startSpans(const int *time);
+	static uint64_t now();
+	static void addSpan(const char *name, const char *category, int node, uint64_t start, uint64_t end);
+	static int writeChromeTrace(const char *path);
+};
+
+/**
+ * STRUCT NAME: TraceSpan
+ *
+ * DESCRIPTION: One timed span; name and category are string literals
+ */
+struct TraceSpan {
+	const char *name;
+	const char *category;
+	int node;
+	int time;
+	uint64_t start;
+	uint64_t end;
+};
+
+/**
+ * CLASS NAME: TraceScope
+ *
+ * DESCRIPTION: Records a span from its construction to the end of its scope.
+ * 				Costs a flag test when tracing is off.
+ */
+class TraceScope {
+private:
+	const char *name;
+	const char *category;
+	int node;
+	uint64_t start;
+public:
+	TraceScope(const char *name, const char *category, int node): name(name), category(category), node(node),
+			start(Trace::spansEnabled ? Trace::now() : 0) {}
+	~TraceScope() {
+		if ( Trace::spansEnabled ) {
+			Trace::addSpan(name, category, node, start, Trace::now());
+		}
+	}
 };
 
 #endif
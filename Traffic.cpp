@@ -0,0 +1,215 @@
+/**********************************
+ * FILE NAME: Traffic.cpp
+ *
+ * DESCRIPTION: EmulNet traffic accounting definition
+ **********************************/
+
+#include "Traffic.h"
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Add the counts of other
+ */
+void TrafficCell::add(const TrafficCell& other) {
+	sentMessages += other.sentMessages;
+	sentBytes += other.sentBytes;
+	receivedMessages += other.receivedMessages;
+	receivedBytes += other.receivedBytes;
+}
+
+/**
+ * Constructor
+ */
+Traffic::Traffic(): protocol("unknown"), typeNames(1, "all"), classify(NULL) {}
+
+/**
+ * FUNCTION NAME: setProtocol
+ *
+ * DESCRIPTION: Name the protocol and its message types. Payloads the classifier
+ * 				cannot place are counted as "other".
+ */
+void Traffic::setProtocol(const string& protocol, const char *const *typeNames, int typeCount, MessageClassifier classify) {
+	this->protocol = protocol;
+	this->typeNames.assign(typeNames, typeNames + typeCount);
+	this->typeNames.push_back("other");
+	this->classify = classify;
+	byNode.clear();
+	byTime.clear();
+}
+
+/**
+ * FUNCTION NAME: typeOf
+ *
+ * DESCRIPTION: Index of the message type of a payload
+ */
+int Traffic::typeOf(const char *data, int size) {
+	if ( NULL == classify ) {
+		return 0;
+	}
+	int type = classify(data, size);
+	int other = (int)typeNames.size() - 1;
+	return type >= 0 && type < other ? type : other;
+}
+
+/**
+ * FUNCTION NAME: cell
+ *
+ * DESCRIPTION: The counts of type in the given row of table, growing it as needed
+ */
+TrafficCell& Traffic::cell(vector<vector<TrafficCell> >& table, int row, int type) {
+	if ( row >= (int)table.size() ) {
+		table.resize(row + 1);
+	}
+	if ( table[row].empty() ) {
+		table[row].resize(typeNames.size());
+	}
+	return table[row][type];
+}
+
+/**
+ * FUNCTION NAME: sent
+ *
+ * DESCRIPTION: Account for node sending a payload at time
+ */
+void Traffic::sent(int node, int time, const char *data, int size) {
+	int type = typeOf(data, size);
+	TrafficCell& n = cell(byNode, node, type);
+	n.sentMessages++;
+	n.sentBytes += size;
+	TrafficCell& t = cell(byTime, time, type);
+	t.sentMessages++;
+	t.sentBytes += size;
+}
+
+/**
+ * FUNCTION NAME: received
+ *
+ * DESCRIPTION: Account for node receiving a payload at time
+ */
+void Traffic::received(int node, int time, const char *data, int size) {
+	int type = typeOf(data, size);
+	TrafficCell& n = cell(byNode, node, type);
+	n.receivedMessages++;
+	n.receivedBytes += size;
+	TrafficCell& t = cell(byTime, time, type);
+	t.receivedMessages++;
+	t.receivedBytes += size;
+}
+
+/**
+ * FUNCTION NAME: getProtocol
+ *
+ * DESCRIPTION: Name of the protocol
+ */
+const string& Traffic::getProtocol() const {
+	return protocol;
+}
+
+/**
+ * FUNCTION NAME: total
+ *
+ * DESCRIPTION: Counts over all nodes and types
+ */
+TrafficCell Traffic::total() const {
+	TrafficCell sum;
+	for ( size_t node = 0; node < byNode.size(); node++ ) {
+		for ( size_t type = 0; type < byNode[node].size(); type++ ) {
+			sum.add(byNode[node][type]);
+		}
+	}
+	return sum;
+}
+
+/**
+ * FUNCTION NAME: writeReport
+ *
+ * DESCRIPTION: Write traffic.log, which compares the protocols and breaks each one
+ * 				down by message type and by node, and traffic.csv, which has the
+ * 				traffic of every protocol and type per tick for plotting
+ */
+void Traffic::writeReport(const vector<const Traffic *>& traffic) {
+	FILE *fp = fopen(TRAFFIC_REPORT, "w");
+	FILE *csv = fopen(TRAFFIC_CSV, "w");
+	if ( NULL == fp || NULL == csv ) {
+		printf("Unable to open %s or %s\n", TRAFFIC_REPORT, TRAFFIC_CSV);
+		if ( NULL != fp ) {
+			fclose(fp);
+		}
+		if ( NULL != csv ) {
+			fclose(csv);
+		}
+		return;
+	}
+
+	uint64_t allBytes = 0;
+	for ( size_t p = 0; p < traffic.size(); p++ ) {
+		allBytes += traffic[p]->total().sentBytes;
+	}
+
+	fprintf(fp, "Traffic by protocol (payload bytes sent)\n");
+	fprintf(fp, "%-12s %12s %14s %10s %8s\n", "protocol", "messages", "bytes", "bytes/msg", "share");
+	for ( size_t p = 0; p < traffic.size(); p++ ) {
+		TrafficCell sum = traffic[p]->total();
+		fprintf(fp, "%-12s %12llu %14llu %10.1f %7.2f%%\n", traffic[p]->protocol.c_str(), (unsigned long long)sum.sentMessages,
+				(unsigned long long)sum.sentBytes, sum.sentMessages > 0 ? (double)sum.sentBytes / sum.sentMessages : 0.0,
+				allBytes > 0 ? 100.0 * sum.sentBytes / allBytes : 0.0);
+	}
+
+	fprintf(fp, "\nTraffic by message type\n");
+	fprintf(fp, "%-12s %-14s %12s %14s %12s %14s\n", "protocol", "type", "sent", "sent_bytes", "received", "received_bytes");
+	for ( size_t p = 0; p < traffic.size(); p++ ) {
+		const Traffic& t = *traffic[p];
+		for ( size_t type = 0; type < t.typeNames.size(); type++ ) {
+			TrafficCell sum;
+			for ( size_t node = 0; node < t.byNode.size(); node++ ) {
+				if ( !t.byNode[node].empty() ) {
+					sum.add(t.byNode[node][type]);
+				}
+			}
+			if ( 0 == sum.sentMessages && 0 == sum.receivedMessages ) {
+				continue;
+			}
+			fprintf(fp, "%-12s %-14s %12llu %14llu %12llu %14llu\n", t.protocol.c_str(), t.typeNames[type].c_str(),
+					(unsigned long long)sum.sentMessages, (unsigned long long)sum.sentBytes,
+					(unsigned long long)sum.receivedMessages, (unsigned long long)sum.receivedBytes);
+		}
+	}
+
+	fprintf(fp, "\nTraffic by node\n");
+	fprintf(fp, "%-6s %-12s %12s %14s %12s %14s\n", "node", "protocol", "sent", "sent_bytes", "received", "received_bytes");
+	for ( size_t p = 0; p < traffic.size(); p++ ) {
+		const Traffic& t = *traffic[p];
+		for ( size_t node = 0; node < t.byNode.size(); node++ ) {
+			if ( t.byNode[node].empty() ) {
+				continue;
+			}
+			TrafficCell sum;
+			for ( size_t type = 0; type < t.byNode[node].size(); type++ ) {
+				sum.add(t.byNode[node][type]);
+			}
+			fprintf(fp, "%-6zu %-12s %12llu %14llu %12llu %14llu\n", node, t.protocol.c_str(),
+					(unsigned long long)sum.sentMessages, (unsigned long long)sum.sentBytes,
+					(unsigned long long)sum.receivedMessages, (unsigned long long)sum.receivedBytes);
+		}
+	}
+
+	fprintf(csv, "time,protocol,type,sent,sent_bytes,received,received_bytes\n");
+	for ( size_t p = 0; p < traffic.size(); p++ ) {
+		const Traffic& t = *traffic[p];
+		for ( size_t time = 0; time < t.byTime.size(); time++ ) {
+			for ( size_t type = 0; type < t.byTime[time].size(); type++ ) {
+				const TrafficCell& c = t.byTime[time][type];
+				if ( 0 == c.sentMessages && 0 == c.receivedMessages ) {
+					continue;
+				}
+				fprintf(csv, "%zu,%s,%s,%llu,%llu,%llu,%llu\n", time, t.protocol.c_str(), t.typeNames[type].c_str(),
+						(unsigned long long)c.sentMessages, (unsigned long long)c.sentBytes,
+						(unsigned long long)c.receivedMessages, (unsigned long long)c.receivedBytes);
+			}
+		}
+	}
+
+	fclose(fp);
+	fclose(csv);
+}
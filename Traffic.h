@@ -0,0 +1,65 @@
+/**********************************
+ * FILE NAME: Traffic.h
+ *
+ * DESCRIPTION: Header file of the EmulNet traffic accounting
+ **********************************/
+
+#ifndef TRAFFIC_H_
+#define TRAFFIC_H_
+
+#include "stdincludes.h"
+
+#include <stdint.h>
+
+/*
+ * Macros
+ */
+#define TRAFFIC_REPORT "traffic.log"
+#define TRAFFIC_CSV "traffic.csv"
+
+// returns the message type of a payload, in [0, number of type names)
+typedef int (*MessageClassifier)(const char *data, int size);
+
+/**
+ * STRUCT NAME: TrafficCell
+ *
+ * DESCRIPTION: Messages and payload bytes sent and received
+ */
+struct TrafficCell {
+	uint64_t sentMessages;
+	uint64_t sentBytes;
+	uint64_t receivedMessages;
+	uint64_t receivedBytes;
+	TrafficCell(): sentMessages(0), sentBytes(0), receivedMessages(0), receivedBytes(0) {}
+	void add(const TrafficCell& other);
+};
+
+/**
+ * CLASS NAME: Traffic
+ *
+ * DESCRIPTION: Traffic of one protocol over an EmulNet, broken down by message
+ * 				type, both per node for the whole run and per tick for the
+ * 				whole cluster. The protocol supplies the names of its message
+ * 				types and a classifier that reads the type off a payload.
+ */
+class Traffic {
+private:
+	string protocol;
+	vector<string> typeNames;
+	MessageClassifier classify;
+	// [node][type] and [time][type]; grown on demand
+	vector<vector<TrafficCell> > byNode;
+	vector<vector<TrafficCell> > byTime;
+	TrafficCell& cell(vector<vector<TrafficCell> >& table, int row, int type);
+	int typeOf(const char *data, int size);
+public:
+	Traffic();
+	void setProtocol(const string& protocol, const char *const *typeNames, int typeCount, MessageClassifier classify);
+	void sent(int node, int time, const char *data, int size);
+	void received(int node, int time, const char *data, int size);
+	const string& getProtocol() const;
+	TrafficCell total() const;
+	static void writeReport(const vector<const Traffic *>& traffic);
+};
+
+#endif /* TRAFFIC_H_ */
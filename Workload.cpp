@@ -0,0 +1,362 @@
+/**********************************
+ * FILE NAME: Workload.cpp
+ *
+ * DESCRIPTION: YCSB style workload generator definition
+ **********************************/
+
+#include "Workload.h"
+
+/**
+ * Constructor
+ */
+ZipfianGenerator::ZipfianGenerator(uint64_t items, double theta): items(0), theta(theta), zetan(0) {
+	alpha = 1.0 / (1.0 - theta);
+	zeta2 = 1.0 + pow(0.5, theta);
+	setItems(items);
+}
+
+/**
+ * FUNCTION NAME: setItems
+ *
+ * DESCRIPTION: Draw from [0, items) from now on
+ */
+void ZipfianGenerator::setItems(uint64_t items) {
+	if ( items < this->items ) {
+		this->items = 0;
+		zetan = 0;
+	}
+	for ( uint64_t i = this->items + 1; i <= items; i++ ) {
+		zetan += 1.0 / pow((double)i, theta);
+	}
+	this->items = items;
+	eta = (1.0 - pow(2.0 / items, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+}
+
+/**
+ * FUNCTION NAME: next
+ *
+ * DESCRIPTION: Next value of the distribution
+ */
+uint64_t ZipfianGenerator::next(Random &rng) {
+	if ( items <= 1 ) {
+		return 0;
+	}
+	double u = rng.uniform();
+	double uz = u * zetan;
+	if ( uz < 1.0 ) {
+		return 0;
+	}
+	if ( uz < zeta2 ) {
+		return 1;
+	}
+	uint64_t value = (uint64_t)(items * pow(eta * u - eta + 1.0, alpha));
+	return value < items ? value : items - 1;
+}
+
+/**
+ * Constructor
+ */
+PhaseStats::PhaseStats(): ticks(0), seconds(0) {
+	memset(issued, 0, sizeof(issued));
+	memset(failures, 0, sizeof(failures));
+	memset(timeouts, 0, sizeof(timeouts));
+}
+
+/**
+ * Constructor
+ *
+ * DESCRIPTION: The workload starts at startTime and issues nothing after the
+ * 				last tick that leaves its transactions time to end before endTime
+ */
+Workload::Workload(Params *par, MP2Node **nodes, int startTime, int endTime):
+		par(par), nodes(nodes), rng(par->SEED, "workload", 0), zipf(1, par->WORKLOAD_ZIPF_THETA), records(0), scans(0),
+		credit(0), loadStart(startTime), runStart(-1), runEnd(-1), lastTick(endTime - WORKLOAD_SETTLE_TICKS), started(false),
+		leavesLeft(par->WORKLOAD_LEAVE_NODES), current(&load) {}
+
+/**
+ * FUNCTION NAME: keyOf
+ *
+ * DESCRIPTION: Key of record id
+ */
+string Workload::keyOf(uint64_t id) {
+	char key[32];
+	snprintf(key, sizeof(key), "user%010llu", (unsigned long long)id);
+	return key;
+}
+
+/**
+ * FUNCTION NAME: newValue
+ *
+ * DESCRIPTION: A value of a random size in [WORKLOAD_VALUE_MIN, WORKLOAD_VALUE_MAX]
+ */
+string Workload::newValue() {
+	int size = par->WORKLOAD_VALUE_MIN;
+	if ( par->WORKLOAD_VALUE_MAX > size ) {
+		size += rng.below(par->WORKLOAD_VALUE_MAX - size + 1);
+	}
+	return string(max(size, 1), 'a' + rng.below(26));
+}
+
+/**
+ * FUNCTION NAME: nextKey
+ *
+ * DESCRIPTION: Record an operation goes to, under WORKLOAD_DISTRIBUTION
+ */
+uint64_t Workload::nextKey() {
+	if ( 0 == records ) {
+		return 0;
+	}
+	switch ( par->WORKLOAD_DISTRIBUTION ) {
+		case UNIFORM_KEYS:
+			return rng.below(records);
+		case LATEST_KEYS:
+			return records - 1 - zipf.next(rng);
+		default:
+			return zipf.next(rng);
+	}
+}
+
+/**
+ * FUNCTION NAME: pickNode
+ *
+ * DESCRIPTION: A random live node to coordinate the next operation, -1 if none is left.
+ * 				Leaving nodes do not coordinate.
+ */
+int Workload::pickNode() {
+	for ( int tries = 0; tries < par->EN_GPSZ; tries++ ) {
+		int i = rng.below(par->EN_GPSZ);
+		if ( !nodes[i]->getMemberNode()->bFailed && !nodes[i]->getMemberNode()->bLeaving ) {
+			return i;
+		}
+	}
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		if ( !nodes[i]->getMemberNode()->bFailed && !nodes[i]->getMemberNode()->bLeaving ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * FUNCTION NAME: failNodes
+ *
+ * DESCRIPTION: Fail count random live nodes, for both protocols
+ */
+void Workload::failNodes(int count) {
+	for ( int i = 0; i < count; i++ ) {
+		int node = pickNode();
+		if ( node < 0 ) {
+			return;
+		}
+		// MP1Node and MP2Node of a node share its Member
+		nodes[node]->getMemberNode()->bFailed = true;
+	}
+}
+
+/**
+ * FUNCTION NAME: leaveNodes
+ *
+ * DESCRIPTION: Have a random live node leave gracefully once the one before it
+ * 				has left, so that no node hands its ranges to a leaving one
+ */
+void Workload::leaveNodes() {
+	if ( leavesLeft <= 0 ) {
+		return;
+	}
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		if ( nodes[i]->getMemberNode()->bLeaving && !nodes[i]->getMemberNode()->bFailed ) {
+			return;
+		}
+	}
+	int node = pickNode();
+	if ( node >= 0 ) {
+		nodes[node]->leave();
+		leavesLeft--;
+	}
+}
+
+/**
+ * FUNCTION NAME: issue
+ *
+ * DESCRIPTION: Start one operation of type op
+ */
+void Workload::issue(int op) {
+	int i = pickNode();
+	if ( i < 0 ) {
+		return;
+	}
+	MP2Node *node = nodes[i];
+	switch ( op ) {
+		case WORKLOAD_READ_OP:
+			node->clientRead(keyOf(nextKey()));
+			current->issued[READ]++;
+			break;
+		case WORKLOAD_UPDATE_OP:
+			node->clientUpdate(keyOf(nextKey()), newValue());
+			current->issued[UPDATE]++;
+			break;
+		case WORKLOAD_INSERT_OP:
+			node->clientCreate(keyOf(records), newValue());
+			records++;
+			zipf.setItems(records);
+			current->issued[CREATE]++;
+			break;
+		case WORKLOAD_SCAN_OP: {
+			uint64_t first = nextKey();
+			uint64_t last = min(first + par->WORKLOAD_SCAN_LENGTH, records);
+			for ( uint64_t id = first; id < last; id++ ) {
+				node->clientRead(keyOf(id));
+				current->issued[READ]++;
+			}
+			scans++;
+			break;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: finishPhase
+ *
+ * DESCRIPTION: Collect the outcome of the current phase from the coordinators
+ * 				and clear theirs for the next one
+ */
+void Workload::finishPhase(PhaseStats& stats, int ticks) {
+	stats.ticks = ticks;
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		for ( int type = CREATE; type <= DELETE; type++ ) {
+			stats.latency[type].merge(nodes[i]->getLatency((MessageType)type));
+			stats.failures[type] += nodes[i]->getFailures((MessageType)type);
+			stats.timeouts[type] += nodes[i]->getTimeouts((MessageType)type);
+		}
+		nodes[i]->resetStats();
+	}
+}
+
+/**
+ * FUNCTION NAME: tick
+ *
+ * DESCRIPTION: Issue the operations of this tick
+ */
+void Workload::tick(int time) {
+	if ( time < loadStart ) {
+		return;
+	}
+	// the KV store may start after loadStart, once every node has joined
+	if ( !started ) {
+		started = true;
+		loadStart = time;
+		wallStart = chrono::steady_clock::now();
+	}
+
+	// load phase
+	if ( runStart < 0 ) {
+		credit += par->WORKLOAD_OPS_PER_TICK;
+		while ( credit >= 1 && records < (uint64_t)par->WORKLOAD_RECORDS ) {
+			issue(WORKLOAD_INSERT_OP);
+			credit -= 1;
+		}
+		if ( records >= (uint64_t)par->WORKLOAD_RECORDS ) {
+			load.ticks = time - loadStart + 1;
+			load.seconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+			runStart = time + WORKLOAD_SETTLE_TICKS;
+			runEnd = min(runStart + par->WORKLOAD_TICKS, lastTick);
+			credit = 0;
+		}
+		return;
+	}
+
+	// run phase
+	if ( time == runStart ) {
+		finishPhase(load, load.ticks);
+		current = &run;
+		failNodes(par->WORKLOAD_FAIL_NODES);
+		par->dropmsg = par->DROP_MSG;
+		wallStart = chrono::steady_clock::now();
+	}
+	if ( time == runEnd ) {
+		run.seconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+		// let the last transactions end on a reliable network
+		par->dropmsg = 0;
+	}
+	if ( time >= runStart && time < runEnd ) {
+		leaveNodes();
+	}
+	if ( time < runStart || time >= runEnd ) {
+		return;
+	}
+	int mix[WORKLOAD_OPS] = { par->WORKLOAD_READ, par->WORKLOAD_UPDATE, par->WORKLOAD_INSERT, par->WORKLOAD_SCAN };
+	int total = mix[0] + mix[1] + mix[2] + mix[3];
+	credit += par->WORKLOAD_OPS_PER_TICK;
+	while ( total > 0 && credit >= 1 ) {
+		int pick = rng.below(total);
+		int op = 0;
+		while ( pick >= mix[op] ) {
+			pick -= mix[op++];
+		}
+		issue(op);
+		credit -= 1;
+	}
+}
+
+/**
+ * FUNCTION NAME: writeReport
+ *
+ * DESCRIPTION: Write throughput, latency percentiles and failure rate of each phase
+ * 				to path. Called once the last transactions have ended.
+ */
+void Workload::writeReport(const char *path) {
+	static const char *names[] = { "create", "read", "update", "delete" };
+	static const char *distributions[] = { "uniform", "zipfian", "latest" };
+	FILE *fp = fopen(path, "w");
+	if ( NULL == fp ) {
+		printf("Unable to open %s\n", path);
+		return;
+	}
+	if ( runStart >= 0 && runEnd > runStart ) {
+		finishPhase(run, runEnd - runStart);
+	}
+	else if ( runStart < 0 ) {
+		// the load phase never finished
+		load.seconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+		finishPhase(load, lastTick + WORKLOAD_SETTLE_TICKS - loadStart);
+	}
+
+	fprintf(fp, "seed %llu\n", par->SEED);
+	fprintf(fp, "mix: read %d update %d insert %d scan %d (scan length %d)\n", par->WORKLOAD_READ, par->WORKLOAD_UPDATE,
+			par->WORKLOAD_INSERT, par->WORKLOAD_SCAN, par->WORKLOAD_SCAN_LENGTH);
+	fprintf(fp, "keys: %s, theta %.2f, %d loaded, %llu at the end\n", distributions[par->WORKLOAD_DISTRIBUTION],
+			par->WORKLOAD_ZIPF_THETA, par->WORKLOAD_RECORDS, (unsigned long long)records);
+	fprintf(fp, "values: %d to %d bytes\n", par->WORKLOAD_VALUE_MIN, par->WORKLOAD_VALUE_MAX);
+	fprintf(fp, "target: %.2f ops/tick, run phase of %d ticks, %llu scans\n", par->WORKLOAD_OPS_PER_TICK,
+			run.ticks, (unsigned long long)scans);
+	fprintf(fp, "faults: %d nodes failed and %d leaving from tick %d, drop probability %.2f over the run phase\n\n", par->WORKLOAD_FAIL_NODES,
+			par->WORKLOAD_LEAVE_NODES, runStart, par->DROP_MSG ? par->MSG_DROP_PROB : 0.0);
+
+	fprintf(fp, "%-6s %-7s %9s %9s %8s %8s %7s %6s %6s %6s %6s %8s\n", "phase", "op", "issued", "completed", "failed",
+			"timeouts", "fail%", "p50", "p99", "p999", "max", "mean");
+	PhaseStats *phases[] = { &load, &run };
+	const char *phaseNames[] = { "load", "run" };
+	for ( int p = 0; p < 2; p++ ) {
+		PhaseStats& stats = *phases[p];
+		uint64_t succeeded = 0;
+		for ( int type = CREATE; type <= DELETE; type++ ) {
+			const Histogram& h = stats.latency[type];
+			if ( 0 == stats.issued[type] && 0 == h.count() ) {
+				continue;
+			}
+			uint64_t failed = stats.failures[type] + stats.timeouts[type];
+			succeeded += h.count() - stats.failures[type];
+			fprintf(fp, "%-6s %-7s %9llu %9llu %8llu %8llu %6.2f%% %6llu %6llu %6llu %6llu %8.2f\n", phaseNames[p], names[type],
+					(unsigned long long)stats.issued[type], (unsigned long long)h.count(),
+					(unsigned long long)stats.failures[type], (unsigned long long)stats.timeouts[type],
+					stats.issued[type] > 0 ? 100.0 * failed / stats.issued[type] : 0.0,
+					(unsigned long long)h.percentile(50), (unsigned long long)h.percentile(99),
+					(unsigned long long)h.percentile(99.9), (unsigned long long)h.max(), h.mean());
+		}
+		fprintf(fp, "%-6s throughput %.2f ops/tick, %.0f ops/s over %d ticks and %.3f s\n", phaseNames[p],
+				stats.ticks > 0 ? (double)succeeded / stats.ticks : 0.0, stats.seconds > 0 ? succeeded / stats.seconds : 0.0,
+				stats.ticks, stats.seconds);
+	}
+	fprintf(fp, "\nlatencies are in ticks\n");
+	fclose(fp);
+}
@@ -0,0 +1,117 @@
+/**********************************
+ * FILE NAME: Workload.h
+ *
+ * DESCRIPTION: Header file of the YCSB style workload generator
+ **********************************/
+
+#ifndef WORKLOAD_H_
+#define WORKLOAD_H_
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "MP2Node.h"
+#include "Histogram.h"
+#include "Random.h"
+
+#include <stdint.h>
+#include <chrono>
+
+/*
+ * Macros
+ */
+#define WORKLOAD_REPORT "workload.log"
+// ticks between the phases, long enough for the transactions of the last one to end
+#define WORKLOAD_SETTLE_TICKS 15
+
+enum workloadOP { WORKLOAD_READ_OP, WORKLOAD_UPDATE_OP, WORKLOAD_INSERT_OP, WORKLOAD_SCAN_OP, WORKLOAD_OPS };
+
+/**
+ * CLASS NAME: ZipfianGenerator
+ *
+ * DESCRIPTION: Zipfian distributed integers in [0, items), 0 the most popular, after
+ * 				Gray et al., "Quickly generating billion-record synthetic databases".
+ * 				The item count can grow; the zeta sum is extended, not recomputed. Theta must be
+ * 				in (0, 1): the method divides by 1 - theta.
+ */
+class ZipfianGenerator {
+private:
+	uint64_t items;
+	double theta;
+	double alpha;
+	double zetan;
+	double zeta2;
+	double eta;
+public:
+	ZipfianGenerator(uint64_t items = 1, double theta = 0.99);
+	void setItems(uint64_t items);
+	uint64_t next(Random &rng);
+};
+
+/**
+ * STRUCT NAME: PhaseStats
+ *
+ * DESCRIPTION: Outcome of the transactions of one phase, per MessageType,
+ * 				summed over every coordinator
+ */
+struct PhaseStats {
+	uint64_t issued[DELETE + 1];
+	uint64_t failures[DELETE + 1];
+	uint64_t timeouts[DELETE + 1];
+	Histogram latency[DELETE + 1];
+	int ticks;
+	double seconds;
+	PhaseStats();
+};
+
+/**
+ * CLASS NAME: Workload
+ *
+ * DESCRIPTION: YCSB style load driven through the MP2Node client APIs from random
+ * 				live coordinators. The load phase inserts WORKLOAD_RECORDS keys;
+ * 				the run phase then issues the configured read/update/insert/scan
+ * 				mix for WORKLOAD_TICKS ticks, both at WORKLOAD_OPS_PER_TICK.
+ * 				A scan reads WORKLOAD_SCAN_LENGTH consecutive keys, since the
+ * 				ring hashes keys and has no ordered scan of its own.
+ * 				WORKLOAD_FAIL_NODES nodes fail as the run phase starts and
+ * 				WORKLOAD_LEAVE_NODES nodes leave gracefully, one after the
+ * 				other, from then on, and with
+ * 				DROP_MSG the network drops MSG_DROP_PROB of the messages over it.
+ * 				writeReport() puts throughput, latency percentiles and failure
+ * 				rate of both phases in workload.log.
+ */
+class Workload {
+private:
+	Params *par;
+	MP2Node **nodes;
+	Random rng;
+	ZipfianGenerator zipf;
+	// keys user0 .. user<records - 1> have been inserted
+	uint64_t records;
+	uint64_t scans;
+	double credit;
+	int loadStart;
+	int runStart;
+	int runEnd;
+	int lastTick;
+	bool started;
+	// graceful leaves still to start, one at a time like a rolling restart
+	int leavesLeft;
+	chrono::steady_clock::time_point wallStart;
+	PhaseStats load;
+	PhaseStats run;
+	PhaseStats *current;
+	string keyOf(uint64_t id);
+	string newValue();
+	uint64_t nextKey();
+	int pickNode();
+	void failNodes(int count);
+	void leaveNodes();
+	void issue(int op);
+	void finishPhase(PhaseStats& stats, int ticks);
+public:
+	Workload(Params *par, MP2Node **nodes, int startTime, int endTime);
+	void tick(int time);
+	void writeReport(const char *path);
+};
+
+#endif /* WORKLOAD_H_ */
@@ -7,8 +7,8 @@
 // Transaction Id
 static int g_transID = 0;
 
-// message types, reply is the message from node to coordinator
-enum MessageType {CREATE, READ, UPDATE, DELETE, REPLY, READREPLY};
+// message types, reply is the message from node to coordinator; handoff carries a range of a leaving node
+enum MessageType {CREATE, READ, UPDATE, DELETE, REPLY, READREPLY, HANDOFF};
 // enum of replica types
 enum ReplicaType {PRIMARY, SECONDARY, TERTIARY};
 